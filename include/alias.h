@@ -19,6 +19,7 @@
 
 	extern	int	wind_index;
 	extern	int	last_function_call_level;
+	extern	unsigned long	variable_generation;
 
 /*
  * These are the user commands.  Dont call these directly.
@@ -165,6 +166,7 @@
 	char *	call_function		(char *, Char *);
 	void	init_functions		(void);
 	void	init_expandos		(void);
+	void	unload_regexes		(const char *);
 
 /*
  * These are the two primitives for runtime stacks.
@@ -176,6 +178,7 @@
 	void	unset_current_command 	(void);
 	void	lock_stack_frame	(void);
 	void	unlock_stack_frame	(void);
+	int	local_variables_visible	(void);
 	void	destroy_call_stack	(void);
 	void	dump_call_stack		(void);
 	void	panic_dump_call_stack 	(void);
@@ -0,0 +1,23 @@
+/*
+ * bench.h -- Replay a server transcript and see how fast it goes.
+ * Copyright 2026 EPIC Software Labs
+ */
+
+#ifndef __bench_h__
+#define __bench_h__
+
+enum BenchStage {
+	BENCH_SERVER,		/* do_server(): reading and everything after */
+	BENCH_PARSE,		/* parse_server(): dispatching one line */
+	BENCH_HOOK,		/* do_hook(): running /ONs */
+	BENCH_DISPLAY,		/* add_to_screen(): putting output in windows */
+	NUMBER_OF_BENCH_STAGES
+};
+
+extern	int	benchmarking;
+
+	void	bench_enter		(enum BenchStage);
+	void	bench_leave		(enum BenchStage);
+	int	bench_start		(const char *);
+
+#endif
@@ -32,6 +32,11 @@ extern	int	need_defered_commands;
 
 	int     parse_statement 	(const char *, int, const char *);
 
+typedef struct CompiledBlockT	CompiledBlock;
+	CompiledBlock *	compile_block	(const char *);
+	void	run_compiled_block	(CompiledBlock *, const char *);
+	void	free_compiled_block	(CompiledBlock **);
+
 	BUILT_IN_COMMAND(load);
 	void	send_text	 	(int, const char *, const char *, const char *, int);
 	int	redirect_text		(int, const char *, const char *, char *, int);
@@ -262,7 +262,10 @@
 #define DEFAULT_BEEP_MAX 3
 #define DEFAULT_BLINK_VIDEO 1
 #define	DEFAULT_BOLD_VIDEO 1
+#define DEFAULT_BRACKETED_PASTE 1
 #define DEFAULT_CHANNEL_NAME_WIDTH 0
+#define DEFAULT_CHANNEL_SYNC_BURST 5
+#define DEFAULT_CHANNEL_SYNC_INTERVAL 2000
 #define DEFAULT_CLOCK 1
 #define DEFAULT_CLOCK_24HOUR 0
 #define DEFAULT_CLOCK_FORMAT NULL
@@ -296,6 +299,7 @@
 #define DEFAULT_FLOOD_RATE_PER 10
 #define DEFAULT_FLOOD_USERS 3
 #define DEFAULT_FLOOD_WARNING 0
+#define DEFAULT_FRAME_RATE 0
 #define DEFAULT_HIDE_PRIVATE_CHANNELS 0
 #define DEFAULT_HIGHLIGHT_CHAR "BOLD"
 #define DEFAULT_HIGH_BIT_ESCAPE 2
@@ -306,12 +310,17 @@
 #define DEFAULT_INPUT_PROMPT "> "
 #define DEFAULT_INSERT_MODE 1
 #define DEFAULT_INVERSE_VIDEO 1
+#define DEFAULT_IRCV3_CAPABILITIES "multi-prefix userhost-in-names away-notify extended-join account-notify"
 #define DEFAULT_KEY_INTERVAL 1000
 #define DEFAULT_LASTLOG 256
+#define DEFAULT_LASTLOG_INDEX 0
 #define DEFAULT_LASTLOG_LEVEL "ALL"
 #define DEFAULT_LASTLOG_REWRITE NULL
 #define DEFAULT_LOG 0
 #define DEFAULT_LOGFILE "irc.log"
+#define DEFAULT_LOG_BUFFER_SIZE 16384
+#define DEFAULT_LOG_FLUSH_INTERVAL 0
+#define DEFAULT_LOG_WRITER_THREAD 0
 #define DEFAULT_MAIL 2
 #define DEFAULT_MAIL_INTERVAL 60
 #define DEFAULT_MAIL_TYPE "mbox"
@@ -36,18 +36,24 @@ extern	void	xs_init (void);
 extern	void	perlstartstop (int);
 extern	char *	perlcall (char *, char *, char *, long, char *);
 extern	char *	perleval (char *);
+extern	int	perl_handle (const char *);
+extern	char *	perl_invoke (int, int, char **);
 BUILT_IN_COMMAND(perlcmd);
 #endif
 
 #ifdef HAVE_TCL
 extern	void	tclstartstop (int);
 extern	char *	tcleval (char *);
+extern	int	tcl_handle (const char *);
+extern	char *	tcl_invoke (int, int, char **);
 BUILT_IN_COMMAND(tclcmd);
 #endif
 
 #ifdef HAVE_RUBY
 extern	void	ruby_startstop (int);
 extern	char *	rubyeval (char *);
+extern	int	ruby_handle (const char *);
+extern	char *	ruby_invoke (int, int, char **);
 BUILT_IN_COMMAND(rubycmd);
 #endif
 
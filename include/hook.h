@@ -120,14 +120,18 @@ enum HOOK_TYPES {
 	BUILT_IN_COMMAND(oncmd);
 	BUILT_IN_COMMAND(shookcmd);
 
+typedef	char *	(*hook_callback) (int, const char *);
+
 	int	do_hook 		(int, const char *, ...) __A(2);
 	int	do_hook_with_result	(int, char **, const char *, ...) __A(3);
+	int	hook_is_observed	(int);
 	char *	hookctl			(char *);
 	void	flush_on_hooks 		(void);
 	void	unload_on_hooks		(char *);
 	void	save_hooks 		(FILE *, int);
 	void	do_stack_on		(int, char *);
 	int	hook_find_free_serial	(int, int, int);
+	int	add_callback_hook	(const char *, int, const char *, hook_callback, int, const char *);
 
 	extern int deny_all_hooks;
 
@@ -15,8 +15,10 @@
 	char *	get_input 			(void);
 	char *	get_input_prompt 		(void);
 	void	init_input 			(void);
+	void	input_insert_text		(const char *, int);
 	void	input_move_cursor 		(int, int);
 	char	input_pause 			(char *);
+	int	permit_input_update		(int);
 	void	set_input 			(const char *);
 	void	set_input_prompt 		(void *);
 	void	update_input 			(void *, int);
@@ -36,6 +36,8 @@ typedef int 	comp_func 		(char *, char *);
 #define malloc_strcat_ues(x,y,z) malloc_strcat_ues_c((x),(y),(z),NULL)
 
 extern	int	need_delayed_free;
+extern	unsigned long	new_malloc_count;
+extern	unsigned long	new_malloc_bytes;
 void	fatal_malloc_check	(void *, const char *, const char *, int);
 void *	really_new_malloc 	(size_t, const char *, int);
 void *	really_new_free 	(void **, const char *, int);
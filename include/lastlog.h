@@ -17,6 +17,10 @@
  */
 struct WindowStru;
 
+typedef struct LastlogFilterStru LastlogFilter;
+#define LASTLOG_FILTER_WILD	0
+#define LASTLOG_FILTER_REGEX	1
+
 extern	Mask	current_window_mask;
 extern	Mask *	new_server_lastlog_mask;
 extern	Mask *	old_server_lastlog_mask;
@@ -45,4 +49,9 @@ extern	Mask *	old_server_lastlog_mask;
 
 	void    lastlog_swap_winrefs		(unsigned, unsigned);
 
+	void	set_lastlog_index		(void *);
+	LastlogFilter *	new_lastlog_filter	(unsigned, const char *, int);
+	int	lastlog_filter_maybe		(LastlogFilter *, intmax_t);
+	void	free_lastlog_filter		(LastlogFilter **);
+
 #endif /* __lastlog_h_ */
@@ -15,9 +15,15 @@ extern	int	current_log_refnum;
 	void	logger 		(void *);
 	void	set_log_file 	(void *);
 	void	add_to_log 	(int, FILE *, long, const unsigned char *, int, const char *);
+	void	flush_log_file	(FILE *);
+	void	flush_all_logs	(void);
+	int	get_log_stats	(FILE *, unsigned long *, unsigned long *, unsigned long *, size_t *);
+	void	set_log_flush_interval (void *);
+	void	set_log_writer_thread (void *);
 	BUILT_IN_COMMAND(logcmd);
 	void	add_to_logs	(long, int, const char *, int, const char *);
 	char *	logctl		(char *);
 	void    logfiles_swap_winrefs (int oldref, int newref);
+	void	close_log_segments (void);
 
 #endif /* _LOG_H_ */
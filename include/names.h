@@ -20,6 +20,10 @@
 	int	is_chanop		(Char *, Char *);
 	int	is_chanvoice		(Char *, Char *);
 	int	is_halfop		(Char *, Char *);
+	int	is_nick_away		(Char *, Char *);
+const	char *	get_nick_account	(Char *, Char *);
+	void	set_nick_away		(int, Char *, int);
+	void	set_nick_account	(int, Char *, Char *);
 	int	number_on_channel	(Char *, int);
 	char *	create_nick_list	(Char *, int);
 	char *	create_chops_list	(Char *, int);
@@ -27,6 +31,8 @@
 	int     chanmodetype		(char);
 	int	channel_is_syncing	(Char *, int);
 	void	channel_not_waiting	(Char *, int); 
+	void	schedule_channel_sync	(Char *, int);
+	char *	function_chanctl	(char *);
 	void	update_channel_mode	(Char *, Char *);
 	Char *	get_channel_key		(Char *, int);
 	Char *	get_channel_mode	(Char *, int);
@@ -29,10 +29,13 @@
  *			NEWIO_READ - When Readable, call read().
  *			NEWIO_ACCEPT - When Readable, call accept().
  *			NEWIO_SSL_READ - When Readable, call SSL_read().
+ *				When Writable, if SSL wants it, send any
+ *				data write_ssl() couldn't send yet.
  *			NEWIO_CONNECT - When Writable, call getpeerbyname().
  *			NEWIO_RECV - When Readable, call recv().
  *			NEWIO_NULL - To reversibly cease operations on 'fd'.
- *			NEWIO_SSL_CONNECT - When Readable, call SSL_connect().
+ *			NEWIO_SSL_CONNECT - When Readable (or Writable, if
+ *				SSL wants it), call SSL_connect().
  *		   quiet - When set, errors should not be displayed to screen
  *		   server - Errors should go to this server's windows.
  *	- OUTPUT:  -1 if the file descriptor cannot be watched
@@ -85,6 +88,9 @@
 	int	new_hold_fd		(int);
 	int	new_unhold_fd		(int);
 	int 	new_close 		(int);
+	void	new_want_write		(int, int);
+	void *	get_vfd_ssl		(int);
+	int	set_vfd_ssl		(int, void *);
 
 	int	my_sleep		(double);
 	int	my_isreadable		(int, double);
@@ -20,8 +20,15 @@ typedef struct notify_alist
 	alist_func 		func;
 	hash_type		hash;
 	char *			ison;
+	int			monitor;	/* NOTIFY_MONITOR, etc */
 } NotifyList;
 
+/* How the server tells us about the notify list (NotifyList.monitor) */
+#define NOTIFY_ISON		0	/* We ask with ISON every so often */
+#define NOTIFY_MONITOR		1	/* It tells us (ircv3 MONITOR) */
+#define NOTIFY_WATCH		2	/* It tells us (WATCH) */
+#define NOTIFY_ISON_ONLY	-1	/* MONITOR/WATCH didn't work out */
+
 extern	char	notify_timeref[];
 
 	BUILT_IN_COMMAND(notify);
@@ -32,6 +39,9 @@ extern	char	notify_timeref[];
 	void	make_notify_list 	(int);
 	char *	get_notify_nicks 	(int, int);
 	void	destroy_notify_list	(int);
+	void	notify_monitor_start	(int);
+	void	notify_monitor_reset	(int);
+	int	notify_monitor_returned	(int, int, const char **);
 
 	void	notify_systimer		(void);
 	void	set_notify_interval	(void *);
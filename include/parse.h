@@ -9,13 +9,14 @@
 #ifndef __parse_h__
 #define __parse_h__
 
-typedef struct {
+typedef struct protocol_command_stru {
 	const char	*command;
 	void 		(*inbound_handler) (const char *, const char *, const char **);
 	int		flags;
+	char		*alias;		/* Set by $protocolctl(ADD) */
+	struct protocol_command_stru *next;
 } protocol_command;
 extern 	protocol_command rfc1459[];
-extern	int		 num_protocol_cmds;
 
 #define PROTO_QUOTEBAD 	1 << 0
 
@@ -24,6 +25,9 @@ extern	int		 num_protocol_cmds;
 const 	char	*PasteArgs 	(const char **, int);
 	void	parse_server 	(const char *, size_t);
 	int	is_channel	(const char *);
+	int	register_protocol_command (const char *, void (*) (const char *, const char *, const char **), int, const char *);
+	int	unregister_protocol_command (const char *);
+	char *	function_protocolctl	(char *);
 
 extern	const char	*FromUserHost;
 
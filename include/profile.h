@@ -0,0 +1,25 @@
+/*
+ * profile.h -- Where does all the script time go?
+ * Copyright 2026 EPIC Software Labs
+ */
+
+#ifndef __profile_h__
+#define __profile_h__
+
+enum ProfileKind {
+	PROFILE_ALIAS,		/* /ALIAS run as a command */
+	PROFILE_FUNCTION,	/* /ALIAS run as a $function() */
+	PROFILE_BUILTIN,	/* Built in $function() */
+	PROFILE_HOOK,		/* /ON, by type and serial number */
+	PROFILE_TIMER		/* /TIMER, by refnum */
+};
+
+extern	int	profiling;
+
+	int	profile_enter		(enum ProfileKind, const char *, int);
+	void	profile_leave		(int);
+
+	BUILT_IN_COMMAND(profilecmd);
+	char *	function_profilectl	(char *);
+
+#endif
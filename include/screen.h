@@ -76,6 +76,11 @@ struct	ScreenStru *next;		/* Previous screen in list */
 
 	/* Key qualifier stuff */
 	int	quote_hit;		/* True after QUOTE_CHARACTER hit */
+	int	pasting;		/* True inside a bracketed paste */
+	int	paste_match;		/* How much of ESC[200~ we've seen */
+	char *	paste_buffer;		/* What has been pasted so far */
+	size_t	paste_len;
+	size_t	paste_size;
 	Timeval last_press;		/* The last time a key was pressed.
 					   Used to determine
 					   key-independence. */
@@ -98,6 +103,8 @@ struct	ScreenStru *next;		/* Previous screen in list */
 	void	edit_char		(unsigned char);
 	int	is_cursor_in_display	(struct ScreenStru *);
 	void	repaint_window_body	(Window *);
+	void	forget_window_rows	(Window *);
+	void	set_frame_rate		(void *);
 	void	create_new_screen	(void);
 	Window	*create_additional_screen (void);
 	void	kill_screen		(struct ScreenStru *);
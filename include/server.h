@@ -100,6 +100,14 @@ const	AI	*next_addr;		/* The next one to try upon failure */
 	int	closing;		/* True if close_server called */
 	char	*quit_message;		/* Where we stash a quit message */
 	A005	a005;			/* 005 settings kept kere. */
+	char *	cap_offered;		/* CAPs the server has to offer */
+	char *	cap_enabled;		/* CAPs the server has ACKed */
+	int	cap_negotiating;	/* True until we send CAP END */
+	double	sync_tokens;		/* Channel syncs we can start now */
+	Timeval	sync_last;		/* When sync_tokens was figured */
+	char *	join_keyed;		/* JOINs not sent yet, with keys */
+	char *	join_keys;		/* The keys for join_keyed */
+	char *	join_plain;		/* JOINs not sent yet, no keys */
 	int	stricmp_table;		/* Which case insensitive map to use */
 	int	autoclose;		/* Whether the server is closed when
 					   there are no windows on it */
@@ -221,6 +229,7 @@ extern	const char *server_states[13];
 	void	send_to_aserver_raw		(int, size_t len, const char *buffer);
 	int	grab_server_address		(int);
 	int	connect_to_server		(int);
+	int	attach_to_server		(int, int, void (*) (int));
 	int	close_all_servers		(const char *);
 	void	close_server			(int, const char *);
 
@@ -304,6 +313,14 @@ const	char *	get_server_redirect		(int);
 
 	void	make_005			(int);
 	void	destroy_005			(int);
+	int	get_server_cap			(int, const char *);
+	int	get_server_targmax		(int, const char *);
+	double	take_server_sync_token		(int);
+	void	server_queue_join		(int, const char *, const char *);
+	void	send_server_joins		(int);
+	void	send_deferred_joins		(void);
+extern	int	need_deferred_joins;
+	void	server_cap			(int, const char *, const char *, int);
 const	char*	get_server_005			(int, const char *);
 	void	set_server_005			(int, char*, const char*);
 
@@ -20,5 +20,6 @@
 	int	is_ssl_enabled (int nfd);
 	int	client_ssl_enabled (void);
 	int	ssl_connected (int nfd);
+	int	get_ssl_session_stats (const char *, int, int *, int *, double *);
 
 #endif
@@ -13,12 +13,36 @@ struct 	WindowStru;
 
 #define MAX_FUNCTIONS 40
 
+/*
+ * What a status expando's value depends on.  When something changes, the
+ * code that changed it calls update_all_status_for() with the appropriate
+ * flag, and only those expandos that depend on it are re-run.  Anything
+ * that is not one of these is STATUS_DEP_OTHER, and anybody who calls
+ * update_all_status() is assumed to have changed everything.
+ */
+#define STATUS_DEP_CLOCK	0x0001
+#define STATUS_DEP_MAIL		0x0002
+#define STATUS_DEP_CPU_SAVER	0x0004
+#define STATUS_DEP_ACTIVITY	0x0008
+#define STATUS_DEP_HOLD		0x0010
+#define STATUS_DEP_NICK		0x0020
+#define STATUS_DEP_CHANNEL	0x0040
+#define STATUS_DEP_MODE		0x0080
+#define STATUS_DEP_AWAY		0x0100
+#define STATUS_DEP_DCC		0x0200
+#define STATUS_DEP_OTHER	0x4000
+#define STATUS_DEP_ALL		0x7FFF
+
 typedef struct  status_line {
         char *		raw;
         char *		format;
         const char *	(*func[MAX_FUNCTIONS]) (struct WindowStru *, short, char);
 	short		map[MAX_FUNCTIONS];
 	char		key[MAX_FUNCTIONS];
+	int		deps[MAX_FUNCTIONS];
+	char *		value[MAX_FUNCTIONS];	/* Last value of each func */
+	int		cached;			/* value[] is up to date */
+	int		width;			/* Screen width for result */
         int   		count;
         char *		result;
 } Status_line;
@@ -28,6 +52,7 @@ typedef struct  status_stuff {
         short           double_status;
         short           number;
         char *		special;
+	int		changes;		/* STATUS_DEP_* pending */
 } Status;
 
 extern	Status	main_status;
@@ -37,5 +62,6 @@ extern	Status	main_status;
 	void	build_status 	(void *);
 	int	permit_status_update	(int);
 	void	rebuild_a_status (struct WindowStru *);		/* Don't call */
+	void	destroy_status_cache (Status *);
 
 #endif /* _STATUS_H_ */
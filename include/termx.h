@@ -650,6 +650,8 @@ int	tputs_x(char *);
 	int		term_eight_bit		(void);
 	void		set_term_eight_bit	(int);
 	void		set_meta_8bit		(void *);
+	void		set_bracketed_paste	(void *);
+	void		term_bracketed_paste	(int);
 	const char *	term_getsgr		(int, int, int);
 	const char *	get_term_capability	(const char *, int, int);
 
@@ -22,7 +22,10 @@ int	ALLOW_C1_CHARS_VAR,
 	BANNER_VAR,
 	BANNER_EXPAND_VAR,
 	BEEP_VAR,
+	BRACKETED_PASTE_VAR,
 	CHANNEL_NAME_WIDTH_VAR,
+	CHANNEL_SYNC_BURST_VAR,
+	CHANNEL_SYNC_INTERVAL_VAR,
 	CLIENT_INFORMATION_VAR,
 	CLOCK_VAR,
 	CLOCK_24HOUR_VAR,
@@ -56,6 +59,7 @@ int	ALLOW_C1_CHARS_VAR,
 	FLOOD_RATE_PER_VAR,
 	FLOOD_USERS_VAR,
 	FLOOD_WARNING_VAR,
+	FRAME_RATE_VAR,
 	HIDE_PRIVATE_CHANNELS_VAR,
 	HIGHLIGHT_CHAR_VAR,
 	HIGH_BIT_ESCAPE_VAR,
@@ -65,14 +69,19 @@ int	ALLOW_C1_CHARS_VAR,
         INPUT_INDICATOR_RIGHT_VAR,
 	INPUT_PROMPT_VAR,
 	INSERT_MODE_VAR,
+	IRCV3_CAPABILITIES_VAR,
 	KEY_INTERVAL_VAR,
 	LASTLOG_VAR,
+	LASTLOG_INDEX_VAR,
 	LASTLOG_LEVEL_VAR,
 	LASTLOG_REWRITE_VAR,
 	LOAD_PATH_VAR,
 	LOG_VAR,
 	LOGFILE_VAR,
+	LOG_BUFFER_SIZE_VAR,
+	LOG_FLUSH_INTERVAL_VAR,
 	LOG_REWRITE_VAR,
+	LOG_WRITER_THREAD_VAR,
 	MAIL_VAR,
 	MAIL_INTERVAL_VAR,
 	MAIL_TYPE_VAR,
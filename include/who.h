@@ -20,6 +20,8 @@ typedef struct WhoEntryT
 	char *undernet_extended_args;
 	int  dalnet_extended;
 	char *dalnet_extended_args;
+	int  whox_token;	/* The %t in a WHOX request, 0 if not one */
+	int  deferred;		/* Not sent yet (see whoxbase()) */
         int  who_mask;
 	char *who_target;
         char *who_name;
@@ -43,6 +45,11 @@ typedef struct WhoEntryT
 		   void (*)(int, const char *, const char *, const char **));
 	void 	whoreply (int, const char *, const char *, const char **);
 	void 	xwhoreply (int, const char *, const char *, const char **);
+	void	whoxbase (int, const char *,
+		   void (*)(int, const char *, const char *, const char **), 
+		   void (*)(int, const char *, const char *, const char **));
+	void	send_deferred_whos (void);
+extern	int	need_deferred_whos;
 	void 	who_end (int, const char *, const char *, const char **);
 	int 	fake_who_end (int, const char *, const char *, const char *);
 
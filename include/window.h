@@ -72,6 +72,9 @@ typedef	struct	WindowStru
 	short	change_line;		/* True if this is a scratch window */
 	short	update;			/* True if window display is dirty */
 	short	rebuild_scrollback;	/* True if scrollback needs rebuild */
+	short	frame_dirty;		/* True if output waits for a frame */
+	short	shown_rows;		/* How many rows are in "shown" */
+	unsigned char **shown;		/* What each row of the body shows */
 
 	/* User-settable flags */
 	short	notify_when_hidden;	/* True to notify for hidden output */
@@ -233,6 +236,7 @@ extern	unsigned current_window_priority;
 	int	is_window_visible		(char *);
 	char	*get_status_by_refnum		(unsigned, int);
 	void	update_all_status		(void);
+	void	update_all_status_for		(int);
 	void	set_prompt_by_refnum		(unsigned, const char *);
 const	char 	*get_prompt_by_refnum		(unsigned);
 const	char	*get_target_by_refnum		(unsigned);
@@ -184,6 +184,13 @@ static 	RuntimeStack *call_stack = NULL;
  */
 	int	last_function_call_level = -1;
 
+/*
+ * This is bumped every time the value of any variable (global, local, 
+ * or /SET) might have changed.  Anyone who caches the expansion of a
+ * string that only refers to variables can hang onto it until this moves.
+ */
+	unsigned long	variable_generation = 0;
+
 /*
  * The following actions are supported:  add, delete, find, list
  * On the following types of data:	 var_alias, cmd_alias, local_alias
@@ -244,6 +251,7 @@ void	flush_all_symbols (void)
 	int	i;
 	Symbol *s;
 
+	variable_generation++;
 	for (i = 0; i < globals.max; i++)
 	{
 		s = globals.list[i];
@@ -656,6 +664,8 @@ BUILT_IN_COMMAND(unloadcmd)
 		unload_on_hooks(filename);
 		say("Removing keybinds from %s ...", filename);
 		unload_bindings(filename);
+		say("Removing regexes from %s ...", filename);
+		unload_regexes(filename);
 		say("Done.");
 	}
 }
@@ -1075,6 +1085,7 @@ void	add_var_alias	(const char *orig_name, const char *stuff, int noisy)
 	int	local = 0;
 	char	*save, *name;
 
+	variable_generation++;
 	save = name = remove_brackets(orig_name, NULL);
 	if (*name == ':')
 	{
@@ -1149,6 +1160,7 @@ void	add_var_stub_alias  (const char *orig_name, const char *stuff)
 	const char *ptr;
 	char *name;
 
+	variable_generation++;
 	name = remove_brackets(orig_name, NULL);
 
 	ptr = after_expando(name, 1, NULL);
@@ -1195,6 +1207,7 @@ void	add_local_alias	(const char *orig_name, const char *stuff, int noisy)
 	SymbolSet *list = NULL;
 	char *	name;
 
+	variable_generation++;
 	name = remove_brackets(orig_name, NULL);
 
 	/*
@@ -1580,6 +1593,25 @@ static Symbol *	find_local_alias (const char *orig_name, SymbolSet **list)
 }
 
 
+/*
+ * local_variables_visible: Returns 1 if there are any local variables
+ * that a $variable reference could see from here.  When there aren't,
+ * every $variable refers to a global, no matter how deep the call stack.
+ */
+int	local_variables_visible (void)
+{
+	int	c;
+
+	for (c = wind_index; c >= 0; c = call_stack[c].parent)
+	{
+		if (call_stack[c].alias.max)
+			return 1;
+		if (*call_stack[c].name || call_stack[c].parent == -1)
+			break;
+	}
+	return 0;
+}
+
 /* * */
 static void	delete_var_alias (const char *orig_name, int noisy)
 {
@@ -1587,6 +1619,7 @@ static void	delete_var_alias (const char *orig_name, int noisy)
 	char *	name;
 	int	cnt, loc;
 
+	variable_generation++;
 	name = remove_brackets(orig_name, NULL);
 	upper(name);
 	item = (Symbol *)find_array_item((array *)&globals, name, &cnt, &loc);
@@ -2830,6 +2863,7 @@ int	stack_pop_var_alias (const char *name)
 	Symbol *item, *sym, *s, *ss;
 	int	cnt = 0, loc = 0;
 
+	variable_generation++;
 	item = (Symbol *)find_array_item((array *)&globals, name, &cnt, &loc);
 	if (!item || cnt >= 0)
 		return -1;
@@ -0,0 +1,263 @@
+/* $EPIC: bench.c,v 1.1 2026/10/19 00:00:00 jnelson Exp $ */
+/*
+ * bench.c -- Replay a server transcript and see how fast it goes.
+ *
+ * Copyright 2026 EPIC Software Labs
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notices, the above paragraph (the one permitting redistribution),
+ *    this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The names of the author(s) may not be used to endorse or promote
+ *    products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/*
+ * "epic5 -R <file>" runs the client headless (on a 24x80 vt100, with the
+ * output thrown away) and feeds it <file> as though a server had sent it.  The
+ * lines take the same path as the real thing -- newio, do_server(), 
+ * parse_server(), the /ONs and the display -- and when the file runs out
+ * the client reports how fast it went and exits.  Load your scripts with
+ * -l as usual to see what they cost, or use -q to leave them out.
+ *
+ * The file is a transcript of what a server sent, one line per line,
+ * starting with the 001.  A child process writes it into one end of a 
+ * socketpair (and ignores whatever the client says back), so the file is
+ * read the same way every time.
+ *
+ * The time spent in each stage is inclusive: hooks run from the parser 
+ * are counted in both "parse" and "hooks".
+ */
+#include "irc.h"
+#include "ircaux.h"
+#include "server.h"
+#include "newio.h"
+#include "window.h"
+#include "bench.h"
+#include <sys/socket.h>
+
+	int	benchmarking = 0;
+
+typedef struct {
+	const char *	name;
+	int		depth;
+	long		calls;
+	double		seconds;
+	Timeval		started;
+} BenchStageInfo;
+
+static	BenchStageInfo	stages[NUMBER_OF_BENCH_STAGES] = {
+	{ "server",	0, 0, 0, { 0, 0 } },
+	{ "parse",	0, 0, 0, { 0, 0 } },
+	{ "hooks",	0, 0, 0, { 0, 0 } },
+	{ "display",	0, 0, 0, { 0, 0 } }
+};
+
+static	char *		replay_file = NULL;
+static	int		replay_server = NOSERV;
+static	long		replay_lines = 0;
+static	long		replay_bytes = 0;
+static	Timeval		replay_started;
+static	unsigned long	replay_mallocs = 0;
+static	unsigned long	replay_malloc_bytes = 0;
+
+void	bench_enter (enum BenchStage stage)
+{
+	if (!benchmarking)
+		return;
+
+	stages[stage].calls++;
+	if (stages[stage].depth++ == 0)
+		get_time(&stages[stage].started);
+}
+
+void	bench_leave (enum BenchStage stage)
+{
+	if (!benchmarking || stages[stage].depth == 0)
+		return;
+
+	if (--stages[stage].depth == 0)
+		stages[stage].seconds += time_diff(stages[stage].started, 
+							get_time(NULL));
+}
+
+static void	bench_report (void)
+{
+	double	elapsed;
+	int	i;
+
+	elapsed = time_diff(replay_started, get_time(NULL));
+	if (elapsed <= 0)
+		elapsed = 0.000001;
+	if (replay_lines == 0)
+		replay_lines = 1;
+
+	fprintf(stderr, "Replayed %ld lines (%ld bytes) of %s in %.3f secs\n",
+			replay_lines, replay_bytes, replay_file, elapsed);
+	fprintf(stderr, "    %.0f lines/sec\n", replay_lines / elapsed);
+	fprintf(stderr, "    %-8s %10s %6s %12s %10s\n", 
+			"stage", "secs", "%", "usecs/line", "calls");
+	for (i = 0; i < NUMBER_OF_BENCH_STAGES; i++)
+		fprintf(stderr, "    %-8s %10.3f %6.1f %12.2f %10ld\n",
+			stages[i].name, stages[i].seconds, 
+			stages[i].seconds * 100 / elapsed,
+			stages[i].seconds * 1000000 / replay_lines,
+			stages[i].calls);
+	fprintf(stderr, "    %lu allocations (%lu bytes), %.1f per line\n",
+			new_malloc_count - replay_mallocs,
+			new_malloc_bytes - replay_malloc_bytes,
+			(double)(new_malloc_count - replay_mallocs) / replay_lines);
+}
+
+/*
+ * The replay "server" -- write the file, throw away what comes back,
+ * and hang up when the file is done.
+ */
+static void	replay_writer (int fd, int des)
+{
+	char	buffer[IO_BUFFER_SIZE];
+	char	junk[IO_BUFFER_SIZE];
+	ssize_t	len = 0, off = 0, c;
+	int	eof = 0;
+	fd_set	rd, wr;
+
+	for (;;)
+	{
+		if (!eof && off == len)
+		{
+			if ((len = read(fd, buffer, sizeof buffer)) <= 0)
+			{
+				eof = 1;
+				shutdown(des, SHUT_WR);
+			}
+			off = 0;
+		}
+
+		FD_ZERO(&rd);
+		FD_ZERO(&wr);
+		FD_SET(des, &rd);
+		if (!eof)
+			FD_SET(des, &wr);
+		if (select(des + 1, &rd, &wr, NULL, NULL) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		if (FD_ISSET(des, &rd))
+			if (read(des, junk, sizeof junk) <= 0)
+				break;		/* Client went away */
+
+		if (!eof && FD_ISSET(des, &wr))
+		{
+			if ((c = write(des, buffer + off, len - off)) < 0)
+				break;
+			off += c;
+		}
+	}
+	_exit(0);
+}
+
+/*
+ * newio calls this instead of do_server() for the replay server, so the
+ * reading gets counted, and so we know when the file runs out.
+ */
+static void	replay_read (int des)
+{
+	bench_enter(BENCH_SERVER);
+	do_server(des);
+	bench_leave(BENCH_SERVER);
+
+	if (!is_server_open(replay_server))
+	{
+		benchmarking = 0;
+		bench_report();
+		irc_exit(1, NULL);
+	}
+}
+
+/*
+ * bench_start: Start replaying 'filename' to a new server, which becomes
+ * the current window's server.
+ */
+int	bench_start (const char *filename)
+{
+	char	buffer[IO_BUFFER_SIZE];
+	char *	p;
+	ssize_t	len;
+	int	fd, pair[2];
+	pid_t	pid;
+
+	if ((fd = open(filename, O_RDONLY)) < 0)
+	{
+		fprintf(stderr, "Cannot open %s: %s\n", filename, strerror(errno));
+		return -1;
+	}
+
+	/* Count the lines, so we can tell you the rate */
+	while ((len = read(fd, buffer, sizeof buffer)) > 0)
+	{
+		replay_bytes += len;
+		for (p = buffer; (p = memchr(p, '\n', len - (p - buffer))); p++)
+			replay_lines++;
+	}
+	lseek(fd, 0, SEEK_SET);
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) < 0)
+	{
+		fprintf(stderr, "socketpair: %s\n", strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	if ((pid = fork()) < 0)
+	{
+		fprintf(stderr, "fork: %s\n", strerror(errno));
+		close(fd);
+		close(pair[0]);
+		close(pair[1]);
+		return -1;
+	}
+	else if (pid == 0)
+	{
+		close(pair[0]);
+		replay_writer(fd, pair[1]);
+	}
+
+	close(fd);
+	close(pair[1]);
+
+	malloc_strcpy(&replay_file, filename);
+	if ((replay_server = str_to_newserv("replay.invalid")) == NOSERV)
+	{
+		close(pair[0]);
+		return -1;
+	}
+
+	current_window->server = replay_server;
+	replay_mallocs = new_malloc_count;
+	replay_malloc_bytes = new_malloc_bytes;
+	get_time(&replay_started);
+	benchmarking = 1;
+
+	return attach_to_server(replay_server, pair[0], replay_read);
+}
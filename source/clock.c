@@ -154,7 +154,7 @@ void	reset_clock (void *stuff)
 
 	sclock = get_string_var(STATUS_CLOCK_VAR);
 	if (sclock && *sclock)
-		update_all_status();
+		update_all_status_for(STATUS_DEP_CLOCK);
 }
 
 /* update_clock: figures out the current time and returns it in a nice format */
@@ -199,7 +199,7 @@ void	my_set_clock (void *stuff)
 BUILT_IN_KEYBINDING(cpu_saver_on)
 {
         cpu_saver = 1;
-        update_all_status(); 
+        update_all_status_for(STATUS_DEP_CPU_SAVER);
 }
 
 static const char cpu_saver_timeref[] = "CPUTIM";
@@ -74,6 +74,7 @@
 #include "reg.h"
 #include "extlang.h"
 #include "elf.h"
+#include "profile.h"
 
 /* used with input_move_cursor */
 #define RIGHT 1
@@ -273,6 +274,7 @@ static	IrcCommand irc_command[] =
 	{ "PING",	pingcmd		},
 	{ "POP",	pop_cmd		},
 	{ "PRETEND",	pretend_cmd	},
+	{ "PROFILE",	profilecmd	}, /* profile.c */
 	{ "PUSH",	push_cmd	},
 	{ "QUERY",	query		},
         { "QUEUE",      queuecmd        }, /* queue.c */
@@ -409,7 +411,7 @@ BUILT_IN_COMMAND(away)
 	else
 		set_server_away(from_server, args);
 
-	update_all_status();
+	update_all_status_for(STATUS_DEP_AWAY);
 }
 
 BUILT_IN_COMMAND(blesscmd)
@@ -2900,13 +2902,8 @@ BUILT_IN_COMMAND(xtypecmd)
 		if ((arg = next_arg(args, &args)) != NULL)
 		{
 			if (!my_strnicmp(arg, "LITERAL", 1))
-			{
-				for (; *args; args++)
-				{
-					es[0] = 0;
-					input_add_character(*args, es);
-				}
-			}
+				input_insert_text(args, 
+					get_int_var(INSERT_MODE_VAR));
 			else
 				say("Unknown flag -%s to XTYPE", arg);
 			return;
@@ -3524,6 +3521,96 @@ void    runcmds_with_arglist (const char *what, char *args, char *subargs)
 	destroy_arglist(&arglist);
 }
 
+/*
+ * A CompiledBlock is a block of ircII statements that has already been
+ * split up into statements, so it can be run over and over (the body of
+ * a loop) without calling next_statement() on it every time through.
+ * Each statement is still $-expanded every time it is run, since that
+ * depends on the values of variables at that time.
+ */
+struct CompiledBlockT
+{
+	char *	text;		/* Copy of the block, with nuls for ;s */
+	char **	stmts;		/* Start of each statement in 'text' */
+	int	count;		/* How many statements there are */
+};
+
+/*
+ * compile_block: Split 'what' into statements the same way parse_block()
+ * does.  You must free_compiled_block() the return value when done.
+ */
+CompiledBlock *	compile_block (const char *what)
+{
+	CompiledBlock *	block;
+	char *	line;
+	ssize_t	span;
+	int	size = 0;
+
+	block = (CompiledBlock *)new_malloc(sizeof(CompiledBlock));
+	block->text = malloc_strdup(what ? what : empty_string);
+	block->stmts = NULL;
+	block->count = 0;
+
+	line = block->text;
+	while (line && *line)
+	{
+		if ((span = next_statement(line)) < 0)
+			break;
+
+		if (line[span] == ';')
+			line[span++] = 0;
+
+		if (*line)
+		{
+			if (block->count >= size)
+			{
+				size = size ? size * 2 : 8;
+				RESIZE(block->stmts, char *, size);
+			}
+			block->stmts[block->count++] = line;
+		}
+
+		line += span;
+		while (line && *line && isspace(*line))
+			line++;
+	}
+
+	return block;
+}
+
+/*
+ * run_compiled_block: Run each statement in 'block' as parse_block() would,
+ * stopping when any exception that someone is waiting for is thrown.
+ */
+void	run_compiled_block (CompiledBlock *block, const char *subargs)
+{
+	int	i;
+
+	if (!subargs)
+		subargs = empty_string;
+
+	for (i = 0; i < block->count; i++)
+	{
+		parse_statement(block->stmts[i], 0, subargs);
+
+		if ((will_catch_break_exceptions && break_exception) ||
+		    (will_catch_return_exceptions && return_exception) ||
+		    (will_catch_continue_exceptions && continue_exception) ||
+		     system_exception)
+			break;
+	}
+}
+
+void	free_compiled_block (CompiledBlock **block)
+{
+	if (!*block)
+		return;
+
+	new_free(&(*block)->stmts);
+	new_free(&(*block)->text);
+	new_free((char **)block);
+}
+
 /*
  * parse_block: execute a block of ircII statements (in a C string)
  *
@@ -3778,7 +3865,10 @@ static	unsigned 	level = 0;
 			current_command = cmd;
 		}
 		if (alias) {
+			int	prof = profile_enter(PROFILE_ALIAS, cmd, 0);
+
 			call_user_command(cmd, alias, args, arglist);
+			profile_leave(prof);
 		}
 		else if (builtin)
 			builtin(cmd, args, subargs);
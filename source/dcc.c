@@ -4030,7 +4030,7 @@ static void 	update_transfer_buffer (DCC_list *dcc, const char *format, ...)
 		*DCC_current_transfer_buffer = 0;
 
 	if (do_hook(DCC_ACTIVITY_LIST, "%ld", dcc ? dcc->refnum : -1))
-		update_all_status();
+		update_all_status_for(STATUS_DEP_DCC);
 }
 
 
@@ -35,6 +35,7 @@
 #include "ircaux.h"
 #include "files.h"
 #include "window.h"
+#include "log.h"
 #include "output.h"
 #include "elf.h"
 
@@ -220,6 +221,7 @@ static File 			retval = {0 , &elf, NULL};
 	else
 		return NULL;
 
+	flush_log_file(x);		/* So our line goes after its lines */
 	retval.elf->fp = x;		/* XXX Should be a file */
 	retval.next = NULL;
 	return &retval;
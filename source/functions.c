@@ -81,6 +81,7 @@
 #include "levels.h"
 #include "extlang.h"
 #include "ctcp.h"
+#include "profile.h"
 
 #ifdef NEED_GLOB
 # include "glob.h"
@@ -209,6 +210,7 @@ static	char
 	*function_center 	(char *),
 	*function_cexist	(char *),
 	*function_channel	(char *),
+	*function_chanaccount	(char *),
 	*function_channellimit	(char *),
 	*function_channelmode	(char *),
 	*function_check_code	(char *),
@@ -286,6 +288,7 @@ static	char
 	*function_is8bit 	(char *),
 	*function_isalpha 	(char *),
 	*function_isaway	(char *),
+	*function_ischanaway	(char *),
 	*function_ischanvoice	(char *),
 	*function_isconnected	(char *),
 	*function_iscurchan	(char *),
@@ -336,6 +339,8 @@ static	char
 #ifdef HAVE_PERL
 	*function_perl		(char *),
 	*function_perlcall	(char *),
+	*function_perlhandle	(char *),
+	*function_perlinvoke	(char *),
 	*function_perlxcall	(char *),
 #endif
 	*function_prefix	(char *),
@@ -367,6 +372,8 @@ static	char
 	*function_rsubstr	(char *),
 #ifdef HAVE_RUBY
 	*function_ruby		(char *),
+	*function_rubyhandle	(char *),
+	*function_rubyinvoke	(char *),
 #endif
 	*function_sar 		(char *),
 	*function_seek		(char *),
@@ -400,6 +407,8 @@ static	char
 	*function_timerctl	(char *),
 #ifdef HAVE_TCL
 	*function_tcl		(char *),
+	*function_tclhandle	(char *),
+	*function_tclinvoke	(char *),
 #endif
 	*function_tobase	(char *),
         *function_tow		(char *),
@@ -469,6 +478,8 @@ static BuiltInFunctions	built_in_functions[] =
 	{ "CEIL",		function_ceil	 	},
 	{ "CENTER",		function_center 	},
 	{ "CEXIST",		function_cexist		},
+	{ "CHANACCOUNT",	function_chanaccount	},
+	{ "CHANCTL",		function_chanctl	}, /* names.h */
 	{ "CHANLIMIT",		function_channellimit	},
 	{ "CHANMODE",		function_channelmode	},
 	{ "CHANNEL",		function_channel	},
@@ -574,6 +585,7 @@ static BuiltInFunctions	built_in_functions[] =
 	{ "IS8BIT",		function_is8bit 	},
 	{ "ISALPHA",		function_isalpha 	},
 	{ "ISAWAY",		function_isaway		},
+	{ "ISCHANAWAY",		function_ischanaway	},
 	{ "ISCHANNEL",		function_ischannel 	},
 	{ "ISCHANOP",		function_ischanop 	},
 	{ "ISCHANVOICE",	function_ischanvoice	},
@@ -639,6 +651,8 @@ static BuiltInFunctions	built_in_functions[] =
 #ifdef HAVE_PERL
 	{ "PERL",		function_perl		},
 	{ "PERLCALL",		function_perlcall	},
+	{ "PERLHANDLE",		function_perlhandle	},
+	{ "PERLINVOKE",		function_perlinvoke	},
 	{ "PERLXCALL",		function_perlxcall	},
 #endif
 	{ "PID",		function_pid 		},
@@ -646,6 +660,8 @@ static BuiltInFunctions	built_in_functions[] =
 	{ "PPID",		function_ppid 		},
 	{ "PREFIX",		function_prefix		},
 	{ "PRINTLEN",		function_printlen	},
+	{ "PROFILECTL",		function_profilectl	}, /* profile.h */
+	{ "PROTOCOLCTL",	function_protocolctl	}, /* parse.h */
 	{ "PUSH",		function_push 		},
 	{ "QUERYWIN",		function_querywin	},
 	{ "QWORD",		function_qword		},
@@ -678,6 +694,8 @@ static BuiltInFunctions	built_in_functions[] =
 	{ "RSUBSTR",		function_rsubstr	},
 #ifdef HAVE_RUBY
 	{ "RUBY",		function_ruby		},
+	{ "RUBYHANDLE",		function_rubyhandle	},
+	{ "RUBYINVOKE",		function_rubyinvoke	},
 #endif
 	{ "SAR",		function_sar 		},
 	{ "SERVERCTL",		function_serverctl	},
@@ -714,6 +732,8 @@ static BuiltInFunctions	built_in_functions[] =
 	{ "TANH",		function_tanh		},
 #ifdef HAVE_TCL
 	{ "TCL",		function_tcl		},
+	{ "TCLHANDLE",		function_tclhandle	},
+	{ "TCLINVOKE",		function_tclinvoke	},
 #endif
 	{ "TDIFF",		function_tdiff 		},
 	{ "TDIFF2",		function_tdiff2 	},
@@ -829,9 +849,19 @@ char	*call_function (char *name, const char *args)
 	debug_copy = LOCAL_COPY(tmp);
 
 	if (func && type != 1)
+	{
+		int	prof = profile_enter(PROFILE_BUILTIN, str, 0);
+
 		result = func(tmp);
+		profile_leave(prof);
+	}
 	else if (alias && type != 2)
+	{
+		int	prof = profile_enter(PROFILE_FUNCTION, str, 0);
+
 		result = call_user_function(str, alias, tmp, arglist);
+		profile_leave(prof);
+	}
 
 	size = strlen(str) + strlen(debug_copy) + 15;
 	buf = (char *)alloca(size);
@@ -1928,6 +1958,66 @@ BUILT_IN_FUNCTION(function_chngw, word)
 }
 
 
+/*
+ * A throwaway set of words, for the functions that compare one list of
+ * words against another.  Comparing every word in one list to every word
+ * in the other gets slow when the lists are long (two 10,000 word lists
+ * is 100,000,000 compares).  Looking words up in one of these doesn't.
+ * Words are compared the same way as my_stricmp() does it.
+ */
+typedef struct {
+	const char *	word;
+	int		count;
+} WordSetItem;
+
+typedef struct {
+	WordSetItem *	items;
+	size_t		mask;
+} WordSet;
+
+#define WORDSET_FOLD(c)		(((c) >= 'a' && (c) <= 'z') ? (c) - 32 : (c))
+
+static void	init_word_set (WordSet *set, int nwords)
+{
+	size_t	size = 16;
+
+	while (size < (size_t)nwords * 2)
+		size <<= 1;
+	set->items = (WordSetItem *)new_malloc(sizeof(WordSetItem) * size);
+	memset(set->items, 0, sizeof(WordSetItem) * size);
+	set->mask = size - 1;
+}
+
+static void	free_word_set (WordSet *set)
+{
+	new_free((char **)&set->items);
+}
+
+/*
+ * Find 'word' in the set.  If it isn't there and 'add' is set, it is put
+ * there (with a count of 0).  Otherwise, returns NULL if it isn't there.
+ * The set doesn't copy 'word', so don't free it before the set.
+ */
+static WordSetItem *	word_set_find (WordSet *set, const char *word, int add)
+{
+	const unsigned char *p;
+	u_32int_t	h = 2166136261U;
+	size_t		i;
+
+	for (p = (const unsigned char *)word; *p; p++)
+		h = (h ^ WORDSET_FOLD(*p)) * 16777619U;
+
+	for (i = h & set->mask; set->items[i].word; i = (i + 1) & set->mask)
+		if (!my_stricmp(set->items[i].word, word))
+			return &set->items[i];
+
+	if (!add)
+		return NULL;
+	set->items[i].word = word;
+	set->items[i].count = 0;
+	return &set->items[i];
+}
+
 /* $common (string of text / string of text)
  * Given two sets of words seperated by a forward-slash '/', returns
  * all words that are found in both sets.
@@ -1947,6 +2037,8 @@ BUILT_IN_FUNCTION(function_common, word)
 	int	leftc, lefti,
 		rightc, righti;
 	size_t	rvclue=0;
+	WordSet	set;
+	WordSetItem *item;
 
 	left = word;
 	if (!(right = strchr(word,'/')))
@@ -1956,18 +2048,24 @@ BUILT_IN_FUNCTION(function_common, word)
 	leftc = splitw(left, &leftw, DWORD_DWORDS);
 	rightc = splitw(right, &rightw, DWORD_DWORDS);
 
+	/* Count how many times each word is on the right */
+	init_word_set(&set, rightc);
+	for (righti = 0; righti < rightc; righti++)
+		word_set_find(&set, rightw[righti], 1)->count++;
+
+	/* 
+	 * A word on the left matches (and uses up) every copy of it on 
+	 * the right, and is returned once for each of them.
+	 */
 	for (lefti = 0; lefti < leftc; lefti++)
 	{
-		for (righti = 0; righti < rightc; righti++)
-		{
-			if (rightw[righti] && !my_stricmp(leftw[lefti], rightw[righti]))
-			{
-				malloc_strcat_word_c(&booya, space, leftw[lefti], DWORD_DWORDS, &rvclue);
-				rightw[righti] = NULL;
-			}
-		}
+		if (!(item = word_set_find(&set, leftw[lefti], 0)))
+			continue;
+		for (; item->count > 0; item->count--)
+			malloc_strcat_word_c(&booya, space, leftw[lefti], DWORD_DWORDS, &rvclue);
 	}
 
+	free_word_set(&set);
 	new_free((char **)&leftw);
 	new_free((char **)&rightw);
 
@@ -1990,8 +2088,9 @@ BUILT_IN_FUNCTION(function_diff, word)
 		   **leftw = NULL;
 	int 	lefti, leftc,
 	    	righti, rightc;
-	int 	found;
 	size_t	rvclue=0;
+	WordSet	set;
+	WordSetItem *item;
 
 	left = word;
 	if ((right = strchr(word, '/')) == (char *) 0)
@@ -2001,27 +2100,29 @@ BUILT_IN_FUNCTION(function_diff, word)
 	leftc = splitw(left, &leftw, DWORD_DWORDS);
 	rightc = splitw(right, &rightw, DWORD_DWORDS);
 
+	init_word_set(&set, rightc);
+	for (righti = 0; righti < rightc; righti++)
+		word_set_find(&set, rightw[righti], 1)->count = 1;
+
+	/*
+	 * A word on the left uses up every copy of it on the right.
+	 * Once they're used up, any more copies on the left don't match.
+	 */
 	for (rvclue = lefti = 0; lefti < leftc; lefti++)
 	{
-		found = 0;
-		for (righti = 0; righti < rightc; righti++)
-		{
-			if (rightw[righti] && !my_stricmp(leftw[lefti], rightw[righti]))
-			{
-				found = 1;
-				rightw[righti] = NULL;
-			}
-		}
-		if (!found)
+		if ((item = word_set_find(&set, leftw[lefti], 0)) && item->count)
+			item->count = 0;
+		else
 			malloc_strcat_word_c(&booya, space, leftw[lefti], DWORD_DWORDS, &rvclue);
 	}
 
-	for (rvclue = righti = 0; righti < rightc; righti++)
+	for (righti = 0; righti < rightc; righti++)
 	{
-		if (rightw[righti])
+		if (word_set_find(&set, rightw[righti], 0)->count)
 			malloc_strcat_word_c(&booya, space, rightw[righti], DWORD_DWORDS, &rvclue);
 	}
 
+	free_word_set(&set);
 	new_free((char **)&leftw);
 	new_free((char **)&rightw);
 
@@ -3914,12 +4015,6 @@ BUILT_IN_FUNCTION(function_twiddle, words)
 	RETURN_STR(retval);
 }
 
-
-static int unsort_it (const void *v1, const void *v2)
-{
-	/* This just makes me itch. ;-) */
-	return (int)(*(const char * const *)v1 - *(const char * const *)v2);
-}
 /* 
  * Date: Sun, 29 Sep 1996 19:17:25 -0700
  * Author: Thomas Morgan <tmorgan@pobox.com>
@@ -3934,7 +4029,7 @@ BUILT_IN_FUNCTION(function_uniq, word)
 {
         char    **list = NULL;
 	char *booya = NULL;
-        int     listc, listi, listo;
+        int     listc, listi;
 
 	RETURN_IF_EMPTY(word);
         listc = splitw(word, &list, DWORD_DWORDS);
@@ -3945,37 +4040,23 @@ BUILT_IN_FUNCTION(function_uniq, word)
 
 #if 1
 	/*
-	 * This was originally conceved by wd, although his code
-	 * never made it into the distribution.
-	 *
-	 * Sort followed up with a remove duplicates.  Standard stuff,
-	 * only, the whacky way we go about it is due to compatibility.
-	 *
-	 * The major assumption here is that the pointers in list[] are
-	 * in ascending order.  Since splitw() works by inserting nuls
-	 * into the original string, we can be somewhat secure here.
+	 * Keep the first copy of each word, and blank out the rest.
+	 * unsplitw() skips the blanked words for us.
 	 */
-	qsort((void *)list, listc, sizeof(char *), sort_it);
+    {
+	WordSet	set;
+	WordSetItem *item;
 
-	/* Remove _subsequent_ duplicate values wrt the original list
-	 * This means, kill the higher valued pointers value.
-	 */
-	for (listo = 0, listi = 1; listi < listc; listi++) {
-		if (sort_it(&list[listi],&list[listo])) {
-			listo = listi;
-		} else {
-			if (list[listi]<list[listo]) {
-				*(char *)list[listo] = 0;
-				listo = listi;
-			} else {
-				*(char *)list[listi] = 0;
-			}
-		}
+	init_word_set(&set, listc);
+	for (listi = 0; listi < listc; listi++)
+	{
+		item = word_set_find(&set, list[listi], 1);
+		if (item->count++)
+			*list[listi] = 0;
 	}
-
-	/* We want the remaining words to appear in their original order */
-	qsort((void *)list, listc, sizeof(char *), unsort_it);
+	free_word_set(&set);
 	booya = unsplitw(&list, listc, DWORD_DWORDS);
+    }
 
 #else
     { /* Oh hush.  It is #ifdef'd out, after all. */
@@ -4325,73 +4406,240 @@ BUILT_IN_FUNCTION(function_cexist, input)
  * These are used as an interface to regex support.  Here's the plan:
  *
  * $regcomp(<pattern>) 
- *	will return an $encode()d string that is suitable for
+ *	will return a handle (like "regex.5") that is suitable for
  * 		assigning to a variable.  The return value of this
- *		function must at some point be passed to $regfree()!
+ *		function should at some point be passed to $regfree()!
+ *		If you $regcomp() the same pattern more than once, you
+ *		get the same handle back, and it takes as many $regfree()s
+ *		to get rid of it.  /UNLOAD gets rid of any handles that 
+ *		were made while the package was being loaded.
  *
  * $regexec(<compiled> <string>)
  *	Will return "0" or "1" depending on whether or not the given string
- *		was matched by the previously compiled string.  The value
- *		for <compiled> must be a value previously returned by $regex().
- *		Failure to do this will result in undefined chaos.
+ *		was matched by the previously compiled string.  <compiled>
+ *		can be a handle from $regcomp(), or it can just be the 
+ *		pattern itself, which will be compiled the first time and
+ *		then kept around for a while in case you use it again.
+ *
+ * $regmatches(<compiled> <nmatch> <string>)
+ *	Like $regexec(), but returns the offset and length of each match.
  *
  * $regerror(<compiled>)
  *	Will return the error string for why the previous $regexec() or 
  *		$regex() call failed.
  *
  * $regfree(<compiled>)
- *	Will free off any of the data that might be contained in <compiled>
- *		You MUST call $regfree() on any value that was previously
- *		returned by $regex(), or you will leak memory.  This is not
- *		my problem (tm).  It returns the FALSE value.
+ *	Lets go of a handle returned by $regcomp().  It returns the FALSE 
+ *		value.
  */
 
 #ifdef HAVE_REGEX_H
 static int last_regex_error = 0; 		/* XXX */
 
-BUILT_IN_FUNCTION(function_regcomp_cs, input)
+/*
+ * The compiled regexes live here, most recently used first.  A regex with
+ * a refcount is a handle that someone is holding.  When the refcount goes
+ * to 0 the regex stays around (but the handle is no good any more) so that
+ * the next $regcomp() or $regexec() of the same pattern doesn't have to 
+ * compile it again.  Only the REGEX_CACHE_SIZE most recently used of those
+ * are kept.
+ */
+#define REGEX_CACHE_SIZE	64
+
+typedef struct	RegexHandleStru
 {
-	char *	dest;
-	regex_t preg;
+	struct RegexHandleStru *next;
+	int		refnum;
+	char *		pattern;
+	int		flags;
+	char *		package;	/* Who $regcomp()d it */
+	int		error;		/* What regcomp() said about it */
+	int		refcount;	/* $regcomp()s not yet $regfree()d */
+	regex_t		preg;
+}	RegexHandle;
 
-	memset(&preg, 0, sizeof(preg)); 	/* make valgrind happy */
-	last_regex_error = regcomp(&preg, input, REG_EXTENDED);
+static	RegexHandle *	regex_handles = NULL;
+static	int		next_regex_refnum = 1;
 
-	dest = transform_string_dyn("+ENC", (char *)&preg, 
-					sizeof(regex_t), NULL);
-	RETURN_MSTR(dest);
+static void	free_regex_handle (RegexHandle *r)
+{
+	if (!r->error)
+		regfree(&r->preg);
+	new_free(&r->pattern);
+	new_free(&r->package);
+	new_free((char **)&r);
 }
 
-BUILT_IN_FUNCTION(function_regcomp, input)
+/* Throw out the least recently used unheld regexes, if there are too many */
+static void	trim_regex_cache (void)
 {
-	char *	dest;
-	regex_t preg;
+	RegexHandle *r, **prev, **last;
+	int	unheld;
+
+	for (;;)
+	{
+		unheld = 0;
+		last = NULL;
+		for (prev = &regex_handles; (r = *prev); prev = &r->next)
+		{
+			if (r->refcount == 0)
+			{
+				unheld++;
+				last = prev;
+			}
+		}
+		if (unheld <= REGEX_CACHE_SIZE)
+			return;
 
-	memset(&preg, 0, sizeof(preg)); 	/* make valgrind happy */
-	last_regex_error = regcomp(&preg, input, REG_EXTENDED | REG_ICASE);
+		r = *last;
+		*last = r->next;
+		free_regex_handle(r);
+	}
+}
+
+/* Move 'r' to the front of the list (it was at *prev) */
+static RegexHandle *	touch_regex (RegexHandle **prev)
+{
+	RegexHandle *r = *prev;
+
+	if (r != regex_handles)
+	{
+		*prev = r->next;
+		r->next = regex_handles;
+		regex_handles = r;
+	}
+	return r;
+}
+
+/*
+ * Get the compiled version of 'pattern', compiling it if we don't have it.
+ * If 'package' isn't NULL, you want a handle: you get a regex that nobody
+ * else is holding, or that 'package' is holding already.
+ */
+static RegexHandle *	get_regex (const char *pattern, int flags, const char *package, int want_handle)
+{
+	RegexHandle *r, **prev;
+
+	for (prev = &regex_handles; (r = *prev); prev = &r->next)
+	{
+		if (r->flags != flags || strcmp(r->pattern, pattern))
+			continue;
+		if (want_handle && r->refcount && 
+			(!r->package != !package ||
+			 (package && strcmp(r->package, package))))
+			continue;
+
+		touch_regex(prev);
+		break;
+	}
+
+	if (!r)
+	{
+		r = (RegexHandle *)new_malloc(sizeof(RegexHandle));
+		r->refnum = next_regex_refnum++;
+		r->pattern = malloc_strdup(pattern);
+		r->flags = flags;
+		r->package = NULL;
+		r->refcount = 0;
+		memset(&r->preg, 0, sizeof(r->preg));	/* make valgrind happy */
+		r->error = regcomp(&r->preg, pattern, flags);
+		r->next = regex_handles;
+		regex_handles = r;
+	}
+
+	if (want_handle)
+	{
+		if (r->refcount++ == 0)
+			malloc_strcpy(&r->package, package);
+	}
+	else
+		trim_regex_cache();
 
-	dest = transform_string_dyn("+ENC", (char *)&preg, 
-					sizeof(regex_t), NULL);
-	RETURN_MSTR(dest);
+	last_regex_error = r->error;
+	return r;
+}
+
+/*
+ * Figure out what regex the first argument to $regexec() and friends is.
+ * It's either a handle from $regcomp() or a pattern.
+ */
+static RegexHandle *	lookup_regex (const char *arg, const char *func)
+{
+	RegexHandle *r, **prev;
+	char *	after;
+	long	refnum;
+
+	if (strncmp(arg, "regex.", 6))
+		return get_regex(arg, REG_EXTENDED | REG_ICASE, NULL, 0);
+
+	refnum = strtol(arg + 6, &after, 10);
+	if (after == arg + 6 || *after)
+		return get_regex(arg, REG_EXTENDED | REG_ICASE, NULL, 0);
+
+	for (prev = &regex_handles; (r = *prev); prev = &r->next)
+		if (r->refnum == refnum && r->refcount > 0)
+			return touch_regex(prev);
+
+	yell("%s: %s isn't a $regcomp() handle (was it $regfree()d?)", 
+			func, arg);
+	return NULL;
+}
+
+/*
+ * /UNLOAD <package> lets go of all of the handles that were made while
+ * the package was loading.
+ */
+void	unload_regexes (const char *package)
+{
+	RegexHandle *r;
+
+	for (r = regex_handles; r; r = r->next)
+	{
+		if (r->refcount && r->package && !strcmp(r->package, package))
+		{
+			r->refcount = 0;
+			new_free(&r->package);
+		}
+	}
+	trim_regex_cache();
+}
+
+static char *	regcomp_handle (const char *pattern, int flags)
+{
+	RegexHandle *r;
+	const char *package;
+
+	/* Handles made outside of /LOAD don't belong to anyone */
+	if ((package = current_package()) && !*package)
+		package = NULL;
+
+	r = get_regex(pattern, flags, package, 1);
+	return malloc_sprintf(NULL, "regex.%d", r->refnum);
+}
+
+BUILT_IN_FUNCTION(function_regcomp_cs, input)
+{
+	return regcomp_handle(input, REG_EXTENDED);
+}
+
+BUILT_IN_FUNCTION(function_regcomp, input)
+{
+	return regcomp_handle(input, REG_EXTENDED | REG_ICASE);
 }
 
 BUILT_IN_FUNCTION(function_regexec, input)
 {
 	char *	unsaved;
-	regex_t preg;
+	RegexHandle *r;
 
-	GET_FUNC_ARG(unsaved, input);
-	if (strlen(unsaved) != sizeof(regex_t) * 2)
-	{
-		yell("First argument to $regexec() isn't proper length");
+	GET_DWORD_ARG(unsaved, input);
+	if (!(r = lookup_regex(unsaved, "$regexec()")))
 		RETURN_EMPTY;
-	}
 
-	/* XXX - What if this fails? */
-	transform_string(ENC_xform, XFORM_DECODE, NULL,
-			 unsaved, strlen(unsaved),
-			 (char *)&preg, sizeof(preg));
-	last_regex_error = regexec(&preg, input, 0, NULL, 0);
+	if (r->error)
+		last_regex_error = r->error;
+	else
+		last_regex_error = regexec(&r->preg, input, 0, NULL, 0);
 	RETURN_INT(last_regex_error);	/* DONT PASS FUNC CALL TO RETURN_INT */
 }
 
@@ -4400,25 +4648,19 @@ BUILT_IN_FUNCTION(function_regmatches, input)
 	char *	unsaved;
 	size_t	nmatch;
 	char *	ret = NULL;
-	regex_t preg;
+	RegexHandle *r;
 	regmatch_t *pmatch = NULL;
 
-	GET_FUNC_ARG(unsaved, input);
+	GET_DWORD_ARG(unsaved, input);
 	GET_INT_ARG(nmatch, input);
 
-	if (strlen(unsaved) != sizeof(regex_t) * 2)
-	{
-		yell("First argument to $regmatches() isn't proper length");
+	if (!(r = lookup_regex(unsaved, "$regmatches()")))
+		RETURN_EMPTY;
+	if ((last_regex_error = r->error))
 		RETURN_EMPTY;
-	}
-
-	/* XXX - What if this fails? */
-	transform_string(ENC_xform, XFORM_DECODE, NULL,
-			 unsaved, strlen(unsaved),
-			 (char *)&preg, sizeof(preg));
 
 	RESIZE(pmatch, regmatch_t, nmatch);
-	if (!(last_regex_error = regexec(&preg, input, nmatch, pmatch, 0)))
+	if (!(last_regex_error = regexec(&r->preg, input, nmatch, pmatch, 0)))
 	{
 	    size_t	n, clue = 0;
 
@@ -4446,52 +4688,45 @@ BUILT_IN_FUNCTION(function_regerror, input)
 {
 	char *	unsaved;
 	char	error_buf[1024];
-	regex_t	preg;
-	regmatch_t *pmatch = NULL;
+	RegexHandle *r;
 
-	GET_FUNC_ARG(unsaved, input);
-	if (strlen(unsaved) != sizeof(regex_t) * 2)
-	{
-		yell("First argument to $regmatches() isn't proper length");
+	GET_DWORD_ARG(unsaved, input);
+	if (!(r = lookup_regex(unsaved, "$regerror()")))
 		RETURN_EMPTY;
-	}
-
-	/* XXX - What if this fails? */
-	transform_string(ENC_xform, XFORM_DECODE, NULL,
-			 unsaved, strlen(unsaved),
-			 (char *)&preg, sizeof(preg));
 
 	*error_buf = 0;
 	if (last_regex_error)
-		regerror(last_regex_error, &preg, error_buf, sizeof(error_buf));
+		regerror(last_regex_error, &r->preg, error_buf, sizeof(error_buf));
 	RETURN_STR(error_buf);
 }
 
 BUILT_IN_FUNCTION(function_regfree, input)
 {
 	char *unsaved;
-	regex_t	preg;
-	regmatch_t *pmatch = NULL;
+	RegexHandle *r;
 
-	GET_FUNC_ARG(unsaved, input);
-	if (strlen(unsaved) != sizeof(regex_t) * 2)
-	{
-		yell("First argument to $regmatches() isn't proper length");
-		RETURN_EMPTY;
-	}
+	GET_DWORD_ARG(unsaved, input);
 
-	/* XXX - What if this fails? */
-	transform_string(ENC_xform, XFORM_DECODE, NULL,
-			 unsaved, strlen(unsaved),
-			 (char *)&preg, sizeof(preg));
+	/* Freeing a pattern (instead of a handle) doesn't do anything */
+	if (strncmp(unsaved, "regex.", 6))
+		RETURN_EMPTY;
+	if (!(r = lookup_regex(unsaved, "$regfree()")))
+		RETURN_EMPTY;
 
-	regfree(&preg);
+	if (--r->refcount == 0)
+	{
+		new_free(&r->package);
+		trim_regex_cache();
+	}
 	RETURN_EMPTY;
 }
 
 #else
+void	unload_regexes (const char *package) { }
 BUILT_IN_FUNCTION(function_regexec, input)  { RETURN_EMPTY; }
 BUILT_IN_FUNCTION(function_regcomp, input)  { RETURN_EMPTY; }
+BUILT_IN_FUNCTION(function_regcomp_cs, input)  { RETURN_EMPTY; }
+BUILT_IN_FUNCTION(function_regmatches, input)  { RETURN_EMPTY; }
 BUILT_IN_FUNCTION(function_regerror, input) { RETURN_STR("no regex support"); }
 BUILT_IN_FUNCTION(function_regfree, input)  { RETURN_EMPTY; }
 #endif
@@ -5117,6 +5352,23 @@ BUILT_IN_FUNCTION(function_ishalfop, input)
 	RETURN_INT(is_halfop(input, nick));
 }
 
+/* 1 if they're away, 0 if not, -1 if we don't know (yet) */
+BUILT_IN_FUNCTION(function_ischanaway, input)
+{
+	char	*nick;
+
+	GET_FUNC_ARG(nick, input);
+	RETURN_INT(is_nick_away(input, nick));
+}
+
+BUILT_IN_FUNCTION(function_chanaccount, input)
+{
+	char	*nick;
+
+	GET_FUNC_ARG(nick, input);
+	RETURN_STR(get_nick_account(input, nick));
+}
+
 BUILT_IN_FUNCTION(function_servports, input)
 {
 	int	servnum = from_server;
@@ -5239,9 +5491,11 @@ BUILT_IN_FUNCTION(function_remws, word)
 	char	**lhs = NULL,
 		**rhs = NULL;
 	int	leftc,
+		lefti,
 		rightc,
 		righti;
 	size_t	rvclue=0;
+	WordSet	set;
 
 	left = word;
 	if (!(right = strchr(word,'/')))
@@ -5249,16 +5503,18 @@ BUILT_IN_FUNCTION(function_remws, word)
 
 	*right++ = 0;
 	leftc = splitw(left, &lhs, DWORD_DWORDS);
-	if (leftc > 0)
-		qsort((void *)lhs, leftc, sizeof(char *), sort_it);
+	init_word_set(&set, leftc);
+	for (lefti = 0; lefti < leftc; lefti++)
+		word_set_find(&set, lhs[lefti], 1);
 	rightc = splitw(right, &rhs, DWORD_DWORDS);
 
 	for (righti = 0; righti < rightc; righti++)
 	{
-		if (leftc <= 0 || !bsearch(&rhs[righti], lhs, leftc, sizeof(char *), sort_it))
+		if (!word_set_find(&set, rhs[righti], 0))
 			malloc_strcat_word_c(&booya, space, rhs[righti], DWORD_DWORDS, &rvclue);
 	}
 
+	free_word_set(&set);
 	new_free((char **)&lhs);
 	new_free((char **)&rhs);
 
@@ -6233,6 +6489,28 @@ BUILT_IN_FUNCTION(function_atan, word)
 	MATH_RETVAL(num)
 }
 
+#if defined(HAVE_PERL) || defined(HAVE_TCL) || defined(HAVE_RUBY)
+/*
+ * $perlinvoke(), $tclinvoke(), $rubyinvoke():  "handle word word ..." 
+ * Each word (double quoted words are one word) is its own argument.
+ */
+static char *	extlang_invoke (char *(*invoke) (int, int, char **), char *input)
+{
+	int	handle, argc;
+	char **	argv = NULL;
+	char *	retval;
+
+	GET_INT_ARG(handle, input);
+	if (input && *input)
+		argc = splitw(input, &argv, DWORD_YES);
+	else
+		argc = 0;
+	retval = invoke(handle, argc, argv);
+	new_free((char **)&argv);
+	return retval;
+}
+#endif
+
 #ifdef HAVE_PERL
 
 BUILT_IN_FUNCTION(function_perl, input)
@@ -6260,6 +6538,19 @@ BUILT_IN_FUNCTION(function_perlxcall, input)
 	return perlcall ( sub, in, out, item, input );
 }
 
+BUILT_IN_FUNCTION(function_perlhandle, input)
+{
+	char *sub;
+
+	GET_DWORD_ARG(sub, input);
+	RETURN_INT(perl_handle(sub));
+}
+
+BUILT_IN_FUNCTION(function_perlinvoke, input)
+{
+	return extlang_invoke(perl_invoke, input);
+}
+
 #endif
 
 #ifdef HAVE_TCL
@@ -6269,6 +6560,19 @@ BUILT_IN_FUNCTION(function_tcl, input)
 	return tcleval ( input );
 }
 
+BUILT_IN_FUNCTION(function_tclhandle, input)
+{
+	char *proc;
+
+	GET_DWORD_ARG(proc, input);
+	RETURN_INT(tcl_handle(proc));
+}
+
+BUILT_IN_FUNCTION(function_tclinvoke, input)
+{
+	return extlang_invoke(tcl_invoke, input);
+}
+
 #endif
 
 BUILT_IN_FUNCTION(function_unsplit, input)
@@ -6885,6 +7189,19 @@ BUILT_IN_FUNCTION(function_ruby, input)
 	return rubyeval ( input );
 }
 
+BUILT_IN_FUNCTION(function_rubyhandle, input)
+{
+	char *method;
+
+	GET_DWORD_ARG(method, input);
+	RETURN_INT(ruby_handle(method));
+}
+
+BUILT_IN_FUNCTION(function_rubyinvoke, input)
+{
+	return extlang_invoke(ruby_invoke, input);
+}
+
 #endif
 
 BUILT_IN_FUNCTION(function_curcmd, unused) {
@@ -46,6 +46,9 @@
 #include "stack.h"
 #include "reg.h"
 #include "functions.h"
+#include "alist.h"
+#include "profile.h"
+#include "bench.h"
 
 /*
  * The various ON levels: SILENT means the DISPLAY will be OFF and it will
@@ -98,8 +101,55 @@ typedef struct	hook_stru
 	int	userial;	/* Unique serial for this hook */
 	int	skip;		/* hook will be treated like it doesn't exist */
 	char *	filename;	/* Where it was loaded */
+
+	/* Set by add_callback_hook() -- run this instead of STUFF */
+	hook_callback	callback;
+	int	callback_data;
+
+	/* These are maintained by build_hook_index() */
+	int	order;		/* Position within its serial number */
+	char *	key;		/* Literal first word of nick, if it has one */
+	int	cacheable;	/* Flexible nick only refers to variables */
+	char *	expanded;	/* Last expansion of a cacheable flexible nick */
+	unsigned long expanded_gen;	/* variable_generation of 'expanded' */
 }	Hook;
 
+/*
+ * A HookKey holds all of the hooks at one serial number whose nick
+ * starts with the same literal word (ie, "NICK *" or "#CHANNEL").  Such
+ * a hook can only ever match an event whose first word is that word, so
+ * there is no point in wild_match()ing it against anything else.
+ */
+typedef struct	HookKeyStru
+{
+	char *		name;		/* The literal first word */
+	u_32int_t	hash;		/* Filled in by the alist */
+	Hook **		hooks;		/* The hooks, in list order */
+	int		count;
+}	HookKey;
+
+typedef struct	HookKeyListStru
+{
+	HookKey **	list;
+	int		max;
+	int		max_alloc;
+	alist_func	func;
+	hash_type	hash;
+}	HookKeyList;
+
+/*
+ * A HookSerial is the index of every (non-skipped) hook at one serial
+ * number.  Hooks with a literal first word live in 'keys', and everything
+ * else (wildcards, flexible nicks) must be tried one by one in 'wild'.
+ */
+typedef struct	HookSerialStru
+{
+	int		sernum;
+	HookKeyList	keys;
+	Hook **		wild;
+	int		wild_count;
+}	HookSerial;
+
 /* 
  * Current executing hook, yay! 
  * Silly name, but that can be fixed, can't it? :P
@@ -140,109 +190,117 @@ typedef struct Hookables
 	unsigned flags;			/* Anything else needed */
 	char *	implied;		/* Implied output if unhooked */
 	int	implied_protect;	/* Do not re-expand implied hook */
+
+	HookSerial *serials;		/* 'list' indexed by serial number */
+	int	serials_count;
+	int	dirty;			/* 'serials' must be rebuilt */
+
+	unsigned long calls;		/* Times this event was asserted */
+	unsigned long formats;		/* Times its $* had to be built */
+	unsigned long runs;		/* Times an /ON was run for it */
 } Hookables;
 
 Hookables hook_function_templates[] =
 {
-	{ "ACTION",		NULL,	3,	0,	0,	NULL, 0 },
-	{ "CHANNEL_LOST", 	NULL, 	2,  	0,  	0,  	NULL, 0 },
-	{ "CHANNEL_NICK",	NULL,	3,	0,	0,	NULL, 0 },
-	{ "CHANNEL_SIGNOFF",	NULL,	3,	0,	0,	NULL, 0 },
-	{ "CHANNEL_SYNC",	NULL,	3,	0,	0,	NULL, 0 },
-	{ "CONNECT",		NULL,	2,	0,	0,	NULL, 0 },
-	{ "CTCP",		NULL,	4,	0,	0,	NULL, 0 },
-	{ "CTCP_REPLY",		NULL,	4,	0,	0,	NULL, 0 },
-	{ "CTCP_REQUEST",	NULL,	4,	0,	0,	NULL, 0 },
-	{ "DCC_ACTIVITY",	NULL,	1,	0,	0,	NULL, 0 },
-	{ "DCC_CHAT",		NULL,	2,	0,	0,	NULL, 0 },
-        { "DCC_CONNECT",        NULL,   2,      0,      0,	NULL, 0 },
-	{ "DCC_LIST",		NULL,	8,	0,	0,	NULL, 0 },
-        { "DCC_LOST",           NULL,   2,      0,      0,	NULL, 0 },
-	{ "DCC_OFFER", 		NULL,	2,	0,	0,	NULL, 0 },
-	{ "DCC_RAW",		NULL,	3,	0,	0,	NULL, 0 },
-        { "DCC_REQUEST",        NULL,   4,      0,      0,	NULL, 0 },
-	{ "DISCONNECT",		NULL,	1,	0,	0,	NULL, 0 },
-        { "ENCRYPTED_NOTICE",   NULL,   3,      0,      0,	NULL, 0 },
-        { "ENCRYPTED_PRIVMSG",  NULL,   3,      0,      0,	NULL, 0 },
-	{ "ERROR",		NULL,	1,	0,	0,	NULL, 0 },
-	{ "EXEC",		NULL,	2,	0,	0,	NULL, 0 },
-	{ "EXEC_ERRORS",	NULL,	2,	0,	0,	NULL, 0 },
-	{ "EXEC_EXIT",		NULL,	3,	0,	0,	NULL, 0 },
-	{ "EXEC_PROMPT",	NULL,	2,	0,	0,	NULL, 0 },
-        { "EXIT",               NULL,   1,      0,      0,	NULL, 0 },
-	{ "FLOOD",		NULL,	5,	0,	0,	NULL, 0 },
-	{ "GENERAL_NOTICE",	NULL,	3,	0,	0,	NULL, 0 },
-	{ "GENERAL_PRIVMSG",	NULL,	3,	0,	0,	NULL, 0 },
-	{ "HELP",		NULL,	2,	0,	0,	NULL, 0 },
-	{ "HOOK",		NULL,	1,	0,	0,	NULL, 0 },
-	{ "IDLE",		NULL,	1,	0,	0,	NULL, 0 },
-	{ "INPUT",		NULL,	1,	0,	HF_NORECURSE,	NULL, 0 },
-	{ "INVITE",		NULL,	3,	0,	0,	NULL, 0 },
-	{ "JOIN",		NULL,	4,	0,	0,	NULL, 0 },
-	{ "KEYBINDING",		NULL,	3,	0,	0,	NULL, 0 },
-	{ "KICK",		NULL,	3,	0,	0,	NULL, 0 },
-	{ "KILL",		NULL,	5,	0,	0,	NULL, 0 },
-	{ "LIST",		NULL,	3,	0,	0,	NULL, 0 },
-	{ "MAIL",		NULL,	2,	0,	0,	NULL, 0 },
-	{ "MODE",		NULL,	3,	0,	0,	NULL, 0 },
-	{ "MODE_STRIPPED",	NULL,	3,	0,	0,	NULL, 0 },
-	{ "MSG",		NULL,	2,	0,	0,	NULL, 0 },
-	{ "MSG_GROUP",		NULL,	3,	0,	0,	NULL, 0 },
-	{ "NAMES",		NULL,	2,	0,	0,	NULL, 0 },
-	{ "NEW_NICKNAME",	NULL,	2,	0,	HF_NORECURSE,	NULL, 0 },
-	{ "NICKNAME",		NULL,	2,	0,	0,	NULL, 0 },
-	{ "NOTE",		NULL,	3,	0,	0,	NULL, 0 },
-	{ "NOTICE",		NULL,	2,	0,	0,	NULL, 0 },
-	{ "NOTIFY_SIGNOFF",	NULL,	1,	0,	0,	NULL, 0 },
-	{ "NOTIFY_SIGNON",	NULL,	2,	0,	0,	NULL, 0 },
-	{ "NUMERIC",		NULL,	3,	0,	0,	NULL, 0 },
-	{ "ODD_SERVER_STUFF",	NULL,	3,	0,	0,	NULL, 0 },
-	{ "OPERWALL",		NULL,	2,	0,	0,	NULL, 0 },
-	{ "OPER_NOTICE",	NULL,	2,	0,	0,	NULL, 0 },
-	{ "PART",		NULL,	2,	0,	0,	NULL, 0 },
-	{ "PONG",		NULL,	2,	0,	0,	NULL, 0 },
-	{ "PUBLIC",		NULL,	3,	0,	0,	NULL, 0 },
-	{ "PUBLIC_MSG",		NULL,	3,	0,	0,	NULL, 0 },
-	{ "PUBLIC_NOTICE",	NULL,	3,	0,	0,	NULL, 0 },
-	{ "PUBLIC_OTHER",	NULL,	3,	0,	0,	NULL, 0 },
-	{ "RAW_IRC",		NULL,	1,	0,	0,	NULL, 0 },
-	{ "REDIRECT",		NULL,	2,	0,	HF_NORECURSE,	NULL, 0 },
-	{ "SEND_ACTION",	NULL,	2,	0,	HF_NORECURSE,	NULL, 0 },
-	{ "SEND_CTCP",		NULL,	3,	0,	HF_NORECURSE,	NULL, 0 },
-	{ "SEND_DCC_CHAT",	NULL,	2,	0,	HF_NORECURSE,	NULL, 0 },
-	{ "SEND_MSG",		NULL,	2,	0,	HF_NORECURSE,	NULL, 0 },
-	{ "SEND_NOTICE",	NULL,	2,	0,	HF_NORECURSE,	NULL, 0 },
-	{ "SEND_PUBLIC",	NULL,	2,	0,	HF_NORECURSE,	NULL, 0 },
-	{ "SEND_TO_SERVER",	NULL,	3,	0,	HF_NORECURSE,	NULL, 0 },
-	{ "SERVER_ESTABLISHED",	NULL,	2,	0,	0,	NULL, 0 },
-	{ "SERVER_LOST",	NULL,	2,	0,	0,	NULL, 0 },
-	{ "SERVER_NOTICE",	NULL,	1,	0,	0,	NULL, 0 },
-	{ "SERVER_STATUS",	NULL,	3,	0,	0,	NULL, 0 },
-	{ "SET",		NULL,	2,	0,	0,	NULL, 0 },
-	{ "SIGNAL",		NULL,	1,	0,	0,	NULL, 0 },
-	{ "SIGNOFF",		NULL,	1,	0,	0,	NULL, 0 },
-	{ "SILENCE",		NULL,	2,	0,	0,	NULL, 0 },
-	{ "SSL_SERVER_CERT",	NULL,	3,	0,	0,	NULL, 0 },
-	{ "STATUS_UPDATE",	NULL,	3,	0,	0,	NULL, 0 },
-	{ "SWITCH_CHANNELS",	NULL,	3,	0,	0,	NULL, 0 },
-	{ "SWITCH_QUERY",	NULL,	3,	0,	0,	NULL, 0 },
-	{ "SWITCH_WINDOWS",	NULL,	4,	0,	0,	NULL, 0 },
-	{ "TIMER",		NULL,	1,	0,	0,	NULL, 0 },
-	{ "TOPIC",		NULL,	2,	0,	0,	NULL, 0 },
-	{ "UNKNOWN_COMMAND",	NULL,	2,	0,	HF_NORECURSE, 	NULL, 0},
-	{ "UNKNOWN_SET",	NULL,	2,	0,	HF_NORECURSE,	NULL, 0},
-	{ "UNLOAD",		NULL,	1,	0,	0,	NULL, 0 },
-	{ "WALL",		NULL,	2,	0,	0,	NULL, 0 },
-	{ "WALLOP",		NULL,	3,	0,	0,	NULL, 0 },
-	{ "WHO",		NULL,	6,	0,	0,	NULL, 0 },
-	{ "WINDOW",		NULL,	2,	0,	HF_NORECURSE,	NULL, 0 },
-	{ "WINDOW_COMMAND",	NULL,	1, 	0,	0,	NULL, 0 },
-	{ "WINDOW_CREATE",	NULL,	1, 	0,	0,	NULL, 0 },
-	{ "WINDOW_BEFOREKILL",	NULL,	1,	0,	0,	NULL, 0 },
-	{ "WINDOW_KILL",	NULL,	2,	0,	0,	NULL, 0 },
-	{ "WINDOW_NOTIFIED",	NULL,	2,	0,	HF_NORECURSE,	NULL, 0 },
-	{ "WINDOW_SERVER",	NULL,	3,	0,	0,	NULL, 0 },
-	{ "YELL",		NULL,	1,	0,	0,	NULL, 0 },
+	{ "ACTION",		NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "CHANNEL_LOST", 	NULL, 	2,  	0,  	0,  	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "CHANNEL_NICK",	NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "CHANNEL_SIGNOFF",	NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "CHANNEL_SYNC",	NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "CONNECT",		NULL,	2,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "CTCP",		NULL,	4,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "CTCP_REPLY",		NULL,	4,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "CTCP_REQUEST",	NULL,	4,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "DCC_ACTIVITY",	NULL,	1,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "DCC_CHAT",		NULL,	2,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+        { "DCC_CONNECT",        NULL,   2,      0,      0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "DCC_LIST",		NULL,	8,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+        { "DCC_LOST",           NULL,   2,      0,      0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "DCC_OFFER", 		NULL,	2,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "DCC_RAW",		NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+        { "DCC_REQUEST",        NULL,   4,      0,      0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "DISCONNECT",		NULL,	1,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+        { "ENCRYPTED_NOTICE",   NULL,   3,      0,      0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+        { "ENCRYPTED_PRIVMSG",  NULL,   3,      0,      0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "ERROR",		NULL,	1,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "EXEC",		NULL,	2,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "EXEC_ERRORS",	NULL,	2,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "EXEC_EXIT",		NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "EXEC_PROMPT",	NULL,	2,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+        { "EXIT",               NULL,   1,      0,      0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "FLOOD",		NULL,	5,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "GENERAL_NOTICE",	NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "GENERAL_PRIVMSG",	NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "HELP",		NULL,	2,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "HOOK",		NULL,	1,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "IDLE",		NULL,	1,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "INPUT",		NULL,	1,	0,	HF_NORECURSE,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "INVITE",		NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "JOIN",		NULL,	4,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "KEYBINDING",		NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "KICK",		NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "KILL",		NULL,	5,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "LIST",		NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "MAIL",		NULL,	2,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "MODE",		NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "MODE_STRIPPED",	NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "MSG",		NULL,	2,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "MSG_GROUP",		NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "NAMES",		NULL,	2,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "NEW_NICKNAME",	NULL,	2,	0,	HF_NORECURSE,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "NICKNAME",		NULL,	2,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "NOTE",		NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "NOTICE",		NULL,	2,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "NOTIFY_SIGNOFF",	NULL,	1,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "NOTIFY_SIGNON",	NULL,	2,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "NUMERIC",		NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "ODD_SERVER_STUFF",	NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "OPERWALL",		NULL,	2,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "OPER_NOTICE",	NULL,	2,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "PART",		NULL,	2,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "PONG",		NULL,	2,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "PUBLIC",		NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "PUBLIC_MSG",		NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "PUBLIC_NOTICE",	NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "PUBLIC_OTHER",	NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "RAW_IRC",		NULL,	1,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "REDIRECT",		NULL,	2,	0,	HF_NORECURSE,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "SEND_ACTION",	NULL,	2,	0,	HF_NORECURSE,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "SEND_CTCP",		NULL,	3,	0,	HF_NORECURSE,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "SEND_DCC_CHAT",	NULL,	2,	0,	HF_NORECURSE,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "SEND_MSG",		NULL,	2,	0,	HF_NORECURSE,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "SEND_NOTICE",	NULL,	2,	0,	HF_NORECURSE,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "SEND_PUBLIC",	NULL,	2,	0,	HF_NORECURSE,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "SEND_TO_SERVER",	NULL,	3,	0,	HF_NORECURSE,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "SERVER_ESTABLISHED",	NULL,	2,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "SERVER_LOST",	NULL,	2,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "SERVER_NOTICE",	NULL,	1,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "SERVER_STATUS",	NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "SET",		NULL,	2,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "SIGNAL",		NULL,	1,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "SIGNOFF",		NULL,	1,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "SILENCE",		NULL,	2,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "SSL_SERVER_CERT",	NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "STATUS_UPDATE",	NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "SWITCH_CHANNELS",	NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "SWITCH_QUERY",	NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "SWITCH_WINDOWS",	NULL,	4,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "TIMER",		NULL,	1,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "TOPIC",		NULL,	2,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "UNKNOWN_COMMAND",	NULL,	2,	0,	HF_NORECURSE, 	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "UNKNOWN_SET",	NULL,	2,	0,	HF_NORECURSE,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "UNLOAD",		NULL,	1,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "WALL",		NULL,	2,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "WALLOP",		NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "WHO",		NULL,	6,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "WINDOW",		NULL,	2,	0,	HF_NORECURSE,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "WINDOW_COMMAND",	NULL,	1, 	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "WINDOW_CREATE",	NULL,	1, 	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "WINDOW_BEFOREKILL",	NULL,	1,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "WINDOW_KILL",	NULL,	2,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "WINDOW_NOTIFIED",	NULL,	2,	0,	HF_NORECURSE,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "WINDOW_SERVER",	NULL,	3,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
+	{ "YELL",		NULL,	1,	0,	0,	NULL, 0, NULL, 0, 0, 0, 0, 0 },
 };
 
 static Hookables *hook_functions = NULL;
@@ -284,6 +342,12 @@ static void	initialize_hook_functions (void)
 		hook_functions[i].flags = 0;
 		hook_functions[i].implied = NULL;
 		hook_functions[i].implied_protect = 0;
+		hook_functions[i].serials = NULL;
+		hook_functions[i].serials_count = 0;
+		hook_functions[i].dirty = 0;
+		hook_functions[i].calls = 0;
+		hook_functions[i].formats = 0;
+		hook_functions[i].runs = 0;
 	}
 
 	for (b = 0, i = FIRST_NAMED_HOOK; i < NUMBER_OF_LISTS; b++, i++)
@@ -295,6 +359,12 @@ static void	initialize_hook_functions (void)
 		hook_functions[i].flags = hook_function_templates[b].flags;
 		hook_functions[i].implied = NULL;
 		hook_functions[i].implied_protect = 0;
+		hook_functions[i].serials = NULL;
+		hook_functions[i].serials_count = 0;
+		hook_functions[i].dirty = 0;
+		hook_functions[i].calls = 0;
+		hook_functions[i].formats = 0;
+		hook_functions[i].runs = 0;
 	}
 
 	if (noise_info == NULL)
@@ -470,6 +540,8 @@ static int	add_hook (int which, char *nick, ArgList *arglist, char *stuff, int n
 		new_h->nick = NULL;
 		new_h->stuff = NULL;
 		new_h->filename = NULL;
+		new_h->key = NULL;
+		new_h->expanded = NULL;
 	
 		if ((new_h->userial = next_empty_hookslot()) == hooklist_size)
 			inc_hooklist(3);
@@ -484,6 +556,8 @@ static int	add_hook (int which, char *nick, ArgList *arglist, char *stuff, int n
 	new_h->flexible = flexible;
 	new_h->skip = 0;
 	new_h->arglist = arglist;
+	new_h->callback = NULL;
+	new_h->callback_data = -1;
 	if (current_package())
 	    malloc_strcpy(&new_h->filename, current_package());
 	new_h->next = NULL;
@@ -492,12 +566,53 @@ static int	add_hook (int which, char *nick, ArgList *arglist, char *stuff, int n
 
 	hooklist[new_h->userial] = new_h;
 	add_to_list(&hook_functions[which].list, new_h);
+	hook_functions[which].dirty = 1;
 
 	last_created_hook = new_h->userial;
 
 	return new_h->userial;
 }
 
+/*
+ * add_callback_hook: This is for perl, tcl and ruby, so a handler 
+ * written in those languages can be an /ON all by itself.  When the 
+ * hook goes off, 'callback' is called with 'data' and $* of the event,
+ * instead of running ircII code, so nothing goes through the parser.  
+ * For hooks that want a return value, a "true" return value suppresses
+ * the default action, just like $hookctl(SET ... RETVAL) would.
+ *
+ * 'desc' is what /ON shows you instead of the code.
+ * Returns the hook's unique serial number, or -1 if 'type' is not an /ON.
+ */
+int	add_callback_hook (const char *type, int sernum, const char *nick, hook_callback callback, int data, const char *desc)
+{
+	char *	hookname;
+	char *	nickname;
+	int	which, noisy = default_noise, i, userial;
+
+	hookname = LOCAL_COPY(type);
+	for (i = 0; i < noise_level_num; i++)
+	{
+		if (noise_info[i]->identifier != 0 &&
+				noise_info[i]->identifier == *hookname)
+		{
+			noisy = noise_info[i]->value;
+			hookname++;
+			break;
+		}
+	}
+
+	if ((which = find_hook(hookname, NULL, 1)) == INVALID_HOOKNUM)
+		return -1;
+
+	nickname = LOCAL_COPY(nick);
+	userial = add_hook(which, nickname, NULL, (char *)desc, noisy, 0, 
+				sernum, 0);
+	hooklist[userial]->callback = callback;
+	hooklist[userial]->callback_data = data;
+	return userial;
+}
+
 
 
 
@@ -513,6 +628,7 @@ static void remove_hook (int which, char *nick, int sernum, int quiet)
 	{
 		if ((tmp = remove_from_list(&hook_functions[which].list, nick, sernum)))
 		{
+			hook_functions[which].dirty = 1;
 			if (!quiet)
 				say("%c%s%c removed from %s list", 
 					(tmp->flexible?'\'':'"'), nick,
@@ -522,6 +638,8 @@ static void remove_hook (int which, char *nick, int sernum, int quiet)
 			new_free(&(tmp->nick));
 			new_free(&(tmp->stuff));
 			new_free(&(tmp->filename));
+			new_free(&(tmp->key));
+			new_free(&(tmp->expanded));
 			if (tmp->arglist != NULL)
                     destroy_arglist(&(tmp->arglist));
 					
@@ -563,11 +681,14 @@ static void remove_hook (int which, char *nick, int sernum, int quiet)
 		new_free(&(tmp->nick));
 		new_free(&(tmp->stuff));
 		new_free(&(tmp->filename));
+		new_free(&(tmp->key));
+		new_free(&(tmp->expanded));
 		tmp->next = NULL;
 		
 		new_free((char **)&tmp);
 	}
 	hook_functions[which].list = top;
+	hook_functions[which].dirty = 1;
 	if (!quiet)
 	{
 		if (sernum)
@@ -679,6 +800,303 @@ static int show_all_numerics (int numeric)
 
 
 
+/* * * * * * * * INDEXING THE HOOKS * * * * * * */
+/*
+ * hook_literal_key: If every character of the first word of 'nick' is
+ * literal (no wildcards, no quoting), then any event this nick matches 
+ * must start with that exact word, so we can look the hook up by it.
+ * Returns the (malloced) first word, or NULL if 'nick' must be wild_match()ed
+ * against every event.
+ */
+static char *	hook_literal_key (const char *nick)
+{
+	size_t	len;
+
+	len = strcspn(nick, " *%?\\");
+	if (nick[len] && nick[len] != ' ')
+		return NULL;
+	if (len == 0)
+		return NULL;
+	return malloc_strndup(nick, len);
+}
+
+/*
+ * flexible_nick_cacheable: A flexible nick that only refers to plain 
+ * variables ($foo, $foo.bar) gives the same expansion for every event 
+ * until one of those variables changes, so we can remember its expansion
+ * until variable_generation moves.  Anything that depends on $*, calls
+ * a function, or uses a built in expando (which can change at any time)
+ * has to be expanded every time.
+ */
+static int	flexible_nick_cacheable (const char *nick)
+{
+	const char *	p;
+	char *		name;
+	size_t		len;
+	char *		(*efunc) (void) = NULL;
+	IrcVariable *	var = NULL;
+
+	for (p = nick; (p = strchr(p, '$')); )
+	{
+		p++;
+		if (*p == '$')
+		{
+			p++;
+			continue;
+		}
+		if (!isalpha(*p) && *p != '_')
+			return 0;
+
+		for (len = 0; isalnum(p[len]) || p[len] == '_' || p[len] == '.'; len++)
+			;
+		if (p[len] == '(' || p[len] == '[')
+			return 0;
+
+		name = LOCAL_COPY(p);
+		name[len] = 0;
+		upper(name);
+		efunc = NULL;
+		get_var_alias(name, &efunc, &var);
+		if (efunc)
+			return 0;
+		p += len;
+	}
+	return 1;
+}
+
+static void	destroy_hook_index (Hookables *h)
+{
+	HookSerial *	s;
+	int		i, j;
+
+	for (i = 0; i < h->serials_count; i++)
+	{
+		s = &h->serials[i];
+		for (j = 0; j < s->keys.max; j++)
+		{
+			new_free(&s->keys.list[j]->name);
+			new_free((char **)&s->keys.list[j]->hooks);
+			new_free((char **)&s->keys.list[j]);
+		}
+		new_free((char **)&s->keys.list);
+		new_free((char **)&s->wild);
+	}
+	new_free((char **)&h->serials);
+	h->serials_count = 0;
+}
+
+/*
+ * build_hook_index: Sort every hook in h->list into HookSerials.  This is
+ * done lazily the first time the list is used after it has been changed,
+ * so a script that adds 500 hooks only pays for the index once.
+ */
+static void	build_hook_index (Hookables *h)
+{
+	Hook *		tmp;
+	HookSerial *	s = NULL;
+	HookKey *	k;
+	int		count = 0;
+	int		order = 0;
+	int		last = 0;
+	int		cnt, loc;
+
+	destroy_hook_index(h);
+	h->dirty = 0;
+
+	for (tmp = h->list; tmp; tmp = tmp->next)
+	{
+		if (tmp == h->list || tmp->sernum != last)
+			count++;
+		last = tmp->sernum;
+	}
+	if (count == 0)
+		return;
+
+	h->serials = new_malloc(sizeof(HookSerial) * count);
+
+	for (tmp = h->list; tmp; tmp = tmp->next)
+	{
+		if (!s || tmp->sernum != s->sernum)
+		{
+			s = &h->serials[h->serials_count++];
+			s->sernum = tmp->sernum;
+			s->keys.list = NULL;
+			s->keys.max = s->keys.max_alloc = 0;
+			s->keys.func = (alist_func) my_strnicmp;
+			s->keys.hash = HASH_INSENSITIVE;
+			s->wild = NULL;
+			s->wild_count = 0;
+			order = 0;
+		}
+
+		new_free(&tmp->key);
+		new_free(&tmp->expanded);
+		tmp->order = order++;
+		tmp->cacheable = 0;
+
+		if (tmp->skip)
+			continue;
+
+		if (tmp->flexible)
+			tmp->cacheable = flexible_nick_cacheable(tmp->nick);
+		else
+			tmp->key = hook_literal_key(tmp->nick);
+
+		if (tmp->key)
+		{
+			k = (HookKey *)find_array_item((array *)&s->keys, 
+							tmp->key, &cnt, &loc);
+			if (!k || cnt >= 0)
+			{
+				k = new_malloc(sizeof(HookKey));
+				k->name = malloc_strdup(tmp->key);
+				k->hooks = NULL;
+				k->count = 0;
+				add_to_array((array *)&s->keys, (array_item *)k);
+			}
+			RESIZE(k->hooks, Hook *, k->count + 1);
+			k->hooks[k->count++] = tmp;
+		}
+		else
+		{
+			RESIZE(s->wild, Hook *, s->wild_count + 1);
+			s->wild[s->wild_count++] = tmp;
+		}
+	}
+}
+
+/*
+ * find_hook_serial: Return the lowest serial number in use for this hook
+ * type that is at least 'sernum', or NULL if there aren't any more.
+ */
+static HookSerial *	find_hook_serial (Hookables *h, int sernum)
+{
+	int	lo, hi, mid;
+
+	if (h->dirty)
+		build_hook_index(h);
+
+	lo = 0;
+	hi = h->serials_count;
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		if (h->serials[mid].sernum < sernum)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo >= h->serials_count)
+		return NULL;
+	return &h->serials[lo];
+}
+
+/*
+ * hook_matches: wild_match() 'buffer' against the nick of 'hook', expanding
+ * it first if it is flexible.  If the expansion ran some code that changed 
+ * the hooks of this type, then 'hook' may no longer exist, and *changed is
+ * set so the caller can start over.
+ */
+static int	hook_matches (Hookables *h, Hook *hook, const char *buffer, const char *args, int *changed)
+{
+	char *		tmpnick;
+	unsigned long	gen;
+	int		cache;
+	int		retval;
+
+	if (!hook->flexible)
+		return wild_match(hook->nick, buffer);
+
+	/* XXX What about context? */
+	cache = hook->cacheable && !local_variables_visible();
+	if (cache && hook->expanded && hook->expanded_gen == variable_generation)
+		return wild_match(hook->expanded, buffer);
+
+	gen = variable_generation;
+	tmpnick = expand_alias(hook->nick, args);
+	if (h->dirty)
+	{
+		new_free(&tmpnick);
+		*changed = 1;
+		return 0;
+	}
+
+	retval = wild_match(tmpnick, buffer);
+	if (cache)
+	{
+		new_free(&hook->expanded);
+		hook->expanded = tmpnick;
+		hook->expanded_gen = gen;
+	}
+	else
+		new_free(&tmpnick);
+	return retval;
+}
+
+/*
+ * find_best_hook: Of all the hooks at the serial number 's', return the one
+ * that best matches 'buffer', or NULL if none of them match.  Only the hooks
+ * filed under the first word of 'buffer', and the ones that couldn't be 
+ * filed under any word, are considered.  Ties go to the hook that comes 
+ * first in the list, just as they always have.
+ *
+ * If a flexible nick's expansion changes the hooks out from under us,
+ * *changed is set, and the caller must look up the serial number again.
+ */
+static Hook *	find_best_hook (Hookables *h, HookSerial *s, const char *buffer, const char *args, int *changed)
+{
+	Hook *		besthook = NULL;
+	int		bestmatch = 0;
+	int		currmatch;
+	HookKey *	k;
+	char *		word;
+	size_t		len;
+	int		i, cnt, loc;
+
+	*changed = 0;
+
+	if (s->keys.max && (len = strcspn(buffer, space)))
+	{
+		word = alloca(len + 1);
+		strlcpy(word, buffer, len + 1);
+
+		k = (HookKey *)find_array_item((array *)&s->keys, word, &cnt, &loc);
+		if (k && cnt < 0)
+		{
+			for (i = 0; i < k->count; i++)
+			{
+				currmatch = wild_match(k->hooks[i]->nick, buffer);
+				if (currmatch > bestmatch)
+				{
+					besthook = k->hooks[i];
+					bestmatch = currmatch;
+				}
+			}
+		}
+	}
+
+	for (i = 0; i < s->wild_count; i++)
+	{
+		Hook *	tmp = s->wild[i];
+
+		currmatch = hook_matches(h, tmp, buffer, args, changed);
+		if (*changed)
+			return NULL;
+
+		if (currmatch > bestmatch || 
+		    (currmatch && currmatch == bestmatch && 
+				tmp->order < besthook->order))
+		{
+			besthook = tmp;
+			bestmatch = currmatch;
+		}
+	}
+
+	return besthook;
+}
+
+
 /* * * * * * * * EXECUTING A HOOK * * * * * * */
 #define NO_ACTION_TAKEN		-1
 #define SUPPRESS_DEFAULT	 0
@@ -686,6 +1104,28 @@ static int show_all_numerics (int numeric)
 #define RESULT_PENDING		 2
 static int 	do_hook_internal (int which, char **result, const char *format, va_list args);
 
+/*
+ * hook_is_observed: Returns 1 if asserting an event of type 'which' right 
+ * now could do anything at all -- that is, there is an /ON or an implied
+ * hook for it, hooks aren't turned off, and it isn't a forbidden recursion.
+ * This is just a few flag checks, so anyone who has to go to any trouble
+ * to build the arguments for an event should ask this first.
+ */
+int	hook_is_observed (int which)
+{
+	Hookables *	h;
+
+	if (!hook_functions_initialized)
+		initialize_hook_functions();
+	h = &hook_functions[which];
+
+	if (deny_all_hooks || 
+	    (!h->list && !h->implied) ||
+	    (h->mark && h->flags & HF_NORECURSE))
+		return 0;
+	return 1;
+}
+
 /*
  * do_hook: This is what gets called whenever a MSG, INVITES, WALL, (you get
  * the idea) occurs.  The nick is looked up in the appropriate list. If a
@@ -702,8 +1142,20 @@ int	do_hook (int which, const char *format, ...)
 	int	retval;
 	va_list	args;
 
+	/*
+	 * Nobody is going to see $*, so if nobody is listening there's
+	 * no reason to build it.
+	 */
+	if (!hook_is_observed(which))
+	{
+		hook_functions[which].calls++;
+		return NO_ACTION_TAKEN;
+	}
+
 	va_start(args, format);
+	bench_enter(BENCH_HOOK);
 	retval = do_hook_internal(which, &result, format, args);
+	bench_leave(BENCH_HOOK);
 	new_free(&result);
 	va_end(args);
 	return retval;
@@ -715,7 +1167,9 @@ int	do_hook_with_result (int which, char **result, const char *format, ...)
 	va_list	args;
 
 	va_start(args, format);
+	bench_enter(BENCH_HOOK);
 	retval = do_hook_internal(which, result, format, args);
+	bench_leave(BENCH_HOOK);
 	va_end(args);
 	return retval;
 }
@@ -728,9 +1182,13 @@ static int 	do_hook_internal (int which, char **result, const char *format, va_l
 	char *		buffer		= NULL;
 	unsigned	display		= window_display;
 	char *		stuff_copy;
+	hook_callback	callback;
+	int		callback_data;
 	int		noise, old;
+	int		prof;
 	char		quote;
 	int		serial_number;
+	int		restarts = 0;
 	struct Current_hook *hook;
 	Hookables *	h;
 	va_list		orig_args;
@@ -752,7 +1210,8 @@ static int 	do_hook_internal (int which, char **result, const char *format, va_l
 
 	va_copy(args, orig_args);
 	malloc_vsprintf(&buffer, format, args);
-
+	h->calls++;
+	h->formats++;
 
 	/*
 	 * Decide whether to post this event.  Events are suppressed if:
@@ -760,9 +1219,7 @@ static int 	do_hook_internal (int which, char **result, const char *format, va_l
 	 *   2) There are no /on's and no implied hooks
 	 *   3) The /on has recursed and that is forbidden.
 	 */
-	if (deny_all_hooks || 
-	    (!h->list && !h->implied) ||
-	    (h->mark && h->flags & HF_NORECURSE))
+	if (!hook_is_observed(which))
 	{
 		retval = NO_ACTION_TAKEN;
 		*result = buffer;
@@ -800,68 +1257,56 @@ static int 	do_hook_internal (int which, char **result, const char *format, va_l
 	if (which >= 0)
 		h->mark++;
 
-        serial_number = INT_MIN;
-        for (;!hook->halt;serial_number++)
+	serial_number = INT_MIN;
+	while (!hook->halt)
 	{
-	    for (tmp = h->list; !hook->halt && tmp; tmp = tmp->next)
-            {
-		Hook *besthook = NULL;
+		HookSerial *s;
 		ArgList *tmp_arglist;
 		char *buffer_copy;
-		int bestmatch = 0;
-		int currmatch;
+		int changed;
 
-		if (tmp->sernum < serial_number)
-		    continue;
+		/* Find the next serial number that has any hooks. */
+		if (!(s = find_hook_serial(h, serial_number)))
+			break;
+		serial_number = s->sernum;
 
-		if (tmp->sernum > serial_number)
-		    serial_number = tmp->sernum;
+		tmp = find_best_hook(h, s, hook->buffer, hook->buffer, &changed);
 
-		for (; 
-			!hook->halt && tmp && tmp->sernum == serial_number && !tmp->skip;
-			tmp = tmp->next)
+		/*
+		 * If expanding a flexible nick added or removed hooks, then
+		 * the index we were looking at is gone.  Look at this serial
+		 * number again -- but not forever, in case the nick does
+		 * that every time it is expanded.
+		 */
+		if (changed)
 		{
-		    if (tmp->flexible)
-		    {
-			/* XXX What about context? */
-			char *tmpnick;
-			tmpnick = expand_alias(tmp->nick, hook->buffer);
-		        currmatch = wild_match(tmpnick, hook->buffer);
-			new_free(&tmpnick);
-		    }
-		    else
-		        currmatch = wild_match(tmp->nick, hook->buffer);
-
-		    if (currmatch > bestmatch)
-		    {
-			besthook = tmp;
-			bestmatch = currmatch;
-		    }
+			if (restarts++ < 3)
+				continue;
+			yell("ON %s hooks at serial %d keep changing while "
+				"being matched -- skipping them", 
+					h->name, serial_number);
 		}
+		restarts = 0;
 
-		/* If nothing matched, then run the next serial number. */
-		if (!besthook)
-			break;
-
-		/* Run the hook */
-		tmp = besthook;
-
-		/*
-		 * If the winning event is a "excepting" event, then move 
-		 * on to the next serial number.
+		/* 
+		 * If nothing matched, or if the winning event is an 
+		 * "excepting" event, then move on to the next serial number.
 		 */
-		if (tmp->not)
-			break;
+		if (!tmp || tmp->not)
+			goto next_serial;
 
 		/* Copy off everything important from 'tmp'. */
 		noise = tmp->noisy;
 		if (!name)
 			name = LOCAL_COPY(h->name);
 		stuff_copy = LOCAL_COPY(tmp->stuff);
+		callback = tmp->callback;
+		callback_data = tmp->callback_data;
 		quote = tmp->flexible ? '\'' : '"';
 
 		hook->userial = tmp->userial;
 		tmp_arglist = clone_arglist(tmp->arglist);
+		h->runs++;
 
 		/*
 		 * YOU CAN'T TOUCH ``tmp'' AFTER THIS POINT!!!
@@ -895,8 +1340,25 @@ static int 	do_hook_internal (int which, char **result, const char *format, va_l
 		old = system_exception;
 
 		buffer_copy = LOCAL_COPY(hook->buffer);
+		prof = profile_enter(PROFILE_HOOK, name, serial_number);
+
+		if (callback)
+		{
+			char *xresult;
 
-		if (hook->retval == RESULT_PENDING)
+			xresult = callback(callback_data, buffer_copy);
+			if (hook->retval == RESULT_PENDING)
+			{
+				if (xresult && atol(xresult))
+					hook->retval = SUPPRESS_DEFAULT;
+				else
+					hook->retval = DONT_SUPPRESS_DEFAULT;
+			}
+			if (tmp_arglist)
+				destroy_arglist(&tmp_arglist);
+			new_free(&xresult);
+		}
+		else if (hook->retval == RESULT_PENDING)
 		{
 			char *xresult;
 
@@ -925,6 +1387,7 @@ static int 	do_hook_internal (int which, char **result, const char *format, va_l
 			if (tmp_arglist)
 				destroy_arglist(&tmp_arglist);
 		}
+		profile_leave(prof);
 
 		/*
 		 * Clean up the stuff that may have been mangled by the
@@ -934,12 +1397,10 @@ static int 	do_hook_internal (int which, char **result, const char *format, va_l
 		window_display = display;
 
 		/* Move onto the next serial number. */
-		break;
-	    }
-
-	    /* If 'tmp' is null here, we've processed all of them. */
-	    if (!tmp)
-		break;
+	    next_serial:
+		if (serial_number == INT_MAX)
+			break;
+		serial_number++;
 	}
 
 	/*
@@ -1467,6 +1928,7 @@ void	do_stack_on (int type, char *args)
 		new_os->next = on_stack;
 		on_stack = new_os;
 		hook_functions[which].list = NULL;
+		hook_functions[which].dirty = 1;
 		return;
 	}
 
@@ -1492,6 +1954,7 @@ void	do_stack_on (int type, char *args)
 		}
 
 		hook_functions[which].list = p->list;
+		hook_functions[which].dirty = 1;
 
 		new_free((char **)&p);
 		return;
@@ -1616,6 +2079,19 @@ int hook_find_free_serial(int dir, int from, int which) {
     return ser;
 }
 
+/* Used by $hookctl(STATISTICS) to put the busiest events first */
+static int	compare_hook_calls (const void *p1, const void *p2)
+{
+	const Hookables *h1 = &hook_functions[*(const int *)p1];
+	const Hookables *h2 = &hook_functions[*(const int *)p2];
+
+	if (h1->calls > h2->calls)
+		return -1;
+	if (h1->calls < h2->calls)
+		return 1;
+	return 0;
+}
+
 /* get_noise_id() returns identifer for noise chr */
 static int	get_noise_id (char *chr)
 {
@@ -1665,6 +2141,7 @@ enum
 	HOOKCTL_RETVAL,
 	HOOKCTL_SERIAL,
 	HOOKCTL_SET,
+	HOOKCTL_STATISTICS,
 	HOOKCTL_USERINFO
 };
 
@@ -1733,6 +2210,12 @@ enum
  *         set it.
  *   SERIAL <serial> [<list>]
  *       - Works exactly like PACKAGE.
+ *   STATISTICS [<pattern>]
+ *       - Returns "<list> <calls> <formats> <runs>" for every list that
+ *         has been asserted (or only the matching ones), busiest first.
+ *         <calls> is how many times the event happened, <formats> how
+ *         many of those needed $* built because someone was listening,
+ *         and <runs> how many /ON's were executed for it.
  *
  *   GET <type> <arg>
  *       - See GET/SET
@@ -1816,6 +2299,11 @@ enum
  *       PARAMETERS
  *       PARAMS
  *           - Returns value of params
+ *       CALLS
+ *       FORMATS
+ *       RUNS
+ *           - Returns the statistics for the list (see STATISTICS).
+ *             These can be SET, usually back to 0.
  *
  *
  * 
@@ -1878,9 +2366,8 @@ char *hookctl (char *input)
 	int set_not = 0;
 	int serial = 0;
 	int set_flex = 0;
-	int bestmatch = 0;
-	int currmatch;
 	int sernum;
+	int restarts;
 	int halt = 0;
 	int id;
 	size_t retlen;
@@ -1934,6 +2421,7 @@ char *hookctl (char *input)
 		"RETVAL",
 		"SERIAL",
 		"SET",
+		"STATISTICS",
 		"USERINFO",
 		NULL);
 
@@ -2318,6 +2806,7 @@ char *hookctl (char *input)
 					&hook_functions[hook->type].list,
 					hook
 				);
+				hook_functions[hook->type].dirty = 1;
 				RETURN_INT(1);
 				break;
 				
@@ -2327,6 +2816,7 @@ char *hookctl (char *input)
 					RETURN_STR(hook->stuff);
 				new_free (&(hook->stuff));
 				hook->stuff = malloc_strdup(str);
+				hook->callback = NULL;
 				RETURN_INT(1);
 				break;
 			
@@ -2342,6 +2832,7 @@ char *hookctl (char *input)
 				if (!set)
 					RETURN_INT(hook->skip);
 				hook->skip = atol(str) ? 1 : 0;
+				hook_functions[hook->type].dirty = 1;
 				RETURN_INT(1);
 				break;
 				
@@ -2385,6 +2876,7 @@ char *hookctl (char *input)
 					&hook_functions[hook->type].list,
 					hook
 				);
+				hook_functions[hook->type].dirty = 1;
 				RETURN_INT(1);
 				break;	
 	
@@ -2393,6 +2885,7 @@ char *hookctl (char *input)
 				if (!set)
 					RETURN_INT(hook->flexible);
 				hook->flexible = atol(str) ? 1 : 0;
+				hook_functions[hook->type].dirty = 1;
 				RETURN_INT(1);
 				break;
 
@@ -2564,7 +3057,8 @@ char *hookctl (char *input)
 				prop = vmy_strnicmp(strlen(str), str,
 					"FLAGS",		"MARK", 		"NAME",
 					"PARAMETRES", 	"PARAMETERS",	"PARAMS",
-					"IMPLIED",		NULL);
+					"IMPLIED",		"CALLS",		"FORMATS",
+					"RUNS",			NULL);
 			}
 
 			switch (prop)
@@ -2595,6 +3089,15 @@ char *hookctl (char *input)
 							} else
 								RETURN_STR(hooks->implied);
 #endif
+				case 8:		if (set)
+								hooks->calls = my_atol(input);
+							RETURN_INT(hooks->calls);
+				case 9:		if (set)
+								hooks->formats = my_atol(input);
+							RETURN_INT(hooks->formats);
+				case 10:	if (set)
+								hooks->runs = my_atol(input);
+							RETURN_INT(hooks->runs);
 			}
 			RETURN_EMPTY;
 			break;
@@ -2719,6 +3222,43 @@ char *hookctl (char *input)
 		RETURN_INT(1);
 		break;
 
+	/* go-switch */
+	case HOOKCTL_STATISTICS:
+	{
+		int *	order;
+		int	count = 0;
+
+		if (input && *input)
+		{
+			GET_FUNC_ARG(str, input);
+		}
+		else
+			str = NULL;
+
+		order = new_malloc(sizeof(int) * NUMBER_OF_LISTS);
+		for (tmp_int = 0; tmp_int < NUMBER_OF_LISTS; tmp_int++)
+		{
+			if (!hook_functions[tmp_int].calls)
+				continue;
+			if (str && !wild_match(str, hook_functions[tmp_int].name))
+				continue;
+			order[count++] = tmp_int;
+		}
+		qsort(order, count, sizeof(int), compare_hook_calls);
+
+		for (tmp_int = 0; tmp_int < count; tmp_int++)
+		{
+			char	stat[BIG_BUFFER_SIZE];
+
+			hooks = &hook_functions[order[tmp_int]];
+			snprintf(stat, sizeof stat, "%s %lu %lu %lu", hooks->name,
+				hooks->calls, hooks->formats, hooks->runs);
+			ADD_STR_TO_LIST(ret, space, stat, retlen);
+		}
+		new_free((char **)&order);
+		RETURN_MSTR(ret);
+	}
+
 	/* go-switch */
 	case HOOKCTL_USERINFO:
 		if (input && *input)
@@ -2752,44 +3292,44 @@ char *hookctl (char *input)
 				&& hook_functions[hooknum].flags & HF_NORECURSE))
 			RETURN_EMPTY;
 		buffer = malloc_strdup(!input || !*input ? "" : input);
-		for (sernum = INT_MIN;sernum < INT_MAX;sernum++)
+		hooks = &hook_functions[hooknum];
+		restarts = 0;
+		sernum = INT_MIN;
+		for (;;)
 		{
-			for (hook = hook_functions[hooknum].list; hook; hook = hook->next)
+			HookSerial *s;
+			int	changed;
+
+			if (!(s = find_hook_serial(hooks, sernum)))
+				break;
+			sernum = s->sernum;
+
+			hook = find_best_hook(hooks, s, buffer, empty_string, &changed);
+
+			/*
+			 * Just like do_hook_internal(): if expanding a flexible
+			 * nick added or removed hooks, 'hook' may be stale, so
+			 * look at this serial number again (but not forever).
+			 */
+			if (changed)
 			{
-				Hook *besthook = NULL;
-				if (hook->sernum < sernum)
+				if (restarts++ < 3)
 					continue;
-				
-				if (hook->sernum > sernum)
-					sernum = hook->sernum;
-				
-				for (; hook && hook->sernum == sernum; hook = hook->next)
-				{
-					if (hook->flexible)
-					{
-						char *tmpnick;
-						tmpnick = expand_alias(hook->nick, empty_string);
-						currmatch = wild_match(tmpnick, buffer);
-						new_free(&tmpnick);
-					}
-					else
-						currmatch = wild_match(hook->nick, buffer);
-		
-					if (currmatch > bestmatch)
-					{
-						besthook = hook;
-						bestmatch = currmatch;
-					}
-				}
-				
-				if (!besthook || besthook->not)
-					break;
-				
-				ADD_STR_TO_LIST(ret, space, ltoa(besthook->userial), retlen);
-				break;
+				yell("ON %s hooks at serial %d keep changing while "
+					"being matched -- skipping them",
+						hooks->name, sernum);
+				hook = NULL;
 			}
-			if (!hook)
+			restarts = 0;
+
+			if (hook && !hook->not)
+			{
+				ADD_STR_TO_LIST(ret, space, ltoa(hook->userial), retlen);
+			}
+
+			if (sernum == INT_MAX)
 				break;
+			sernum++;
 		}
 		new_free (&buffer);
 		RETURN_MSTR(ret);
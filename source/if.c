@@ -300,8 +300,9 @@ BUILT_IN_COMMAND(whilecmd)
 {
 	char	*exp = NULL,
 		*ptr,
-		*body = NULL,
 		*newexp = NULL;
+	CompiledBlock *body;
+	size_t	explen;
 	int 	whileval = !strcmp(command, "WHILE");
 
 	if (!subargs)
@@ -313,24 +314,26 @@ BUILT_IN_COMMAND(whilecmd)
 		return;
 	}
 	exp = LOCAL_COPY(ptr);
+	explen = strlen(exp) + 1;
 
 	if (!(ptr = next_expr_failok(&args, '{')))
 		ptr = args;
-	body = LOCAL_COPY(ptr);
+	body = compile_block(ptr);
 
 	will_catch_break_exceptions++;
 	will_catch_continue_exceptions++;
-	newexp = alloca(strlen(exp) + 2);
+	newexp = alloca(explen + 1);
 	while (1)
 	{
-		strlcpy(newexp, exp, strlen(exp) + 1);
+		/* parse_inline() mangles its argument */
+		memcpy(newexp, exp, explen);
 		ptr = parse_inline(newexp, subargs);
 		if (check_val(ptr) != whileval)
 			break;
 
 		new_free(&ptr);
 
-		runcmds(body, subargs);
+		run_compiled_block(body, subargs);
 		if (continue_exception)
 		{
 			continue_exception = 0;
@@ -349,6 +352,7 @@ BUILT_IN_COMMAND(whilecmd)
 	will_catch_break_exceptions--;
 	will_catch_continue_exceptions--;
 	new_free(&ptr);
+	free_compiled_block(&body);
 }
 
 BUILT_IN_COMMAND(foreach)
@@ -357,6 +361,7 @@ BUILT_IN_COMMAND(foreach)
 		*ptr,
 		*body = NULL,
 		*var = NULL;
+	CompiledBlock *todo;
 	char	**sublist;
 	int	total;
 	int	i;
@@ -405,6 +410,7 @@ BUILT_IN_COMMAND(foreach)
 
 	slen = strlen(struc);
 	old_display = window_display;
+	todo = compile_block(body);
 
 	will_catch_break_exceptions++;
 	will_catch_continue_exceptions++;
@@ -413,7 +419,7 @@ BUILT_IN_COMMAND(foreach)
 		add_local_alias(var, sublist[i] + slen + 1, 0);
 		new_free(&sublist[i]);
 
-		runcmds(body, subargs);
+		run_compiled_block(todo, subargs);
 	
 		if (continue_exception)
 		{
@@ -437,6 +443,7 @@ BUILT_IN_COMMAND(foreach)
 
 	new_free((char **)&sublist);
 	new_free(&struc);
+	free_compiled_block(&todo);
 }
 
 /*
@@ -452,6 +459,7 @@ BUILT_IN_COMMAND(fe)
 		*word = NULL,
 		*todo = NULL,
 		fec_buffer[2];
+	CompiledBlock *body;
 	unsigned	ind, x, y;
 	int     old_display;
 	int	doing_fe = !strcmp(command, "FE");
@@ -517,6 +525,7 @@ BUILT_IN_COMMAND(fe)
 		{ word = fec_buffer; word[1] = 0; }
 
 	placeholder = templist;
+	body = compile_block(todo);
 
 	will_catch_break_exceptions++;
 	will_catch_continue_exceptions++;
@@ -536,7 +545,7 @@ BUILT_IN_COMMAND(fe)
 			add_local_alias(var[y], word, 0);
 		}
 		x += ind;
-		runcmds(todo, subargs);
+		run_compiled_block(body, subargs);
 
 		if (mapvar)
 			for ( y = 0 ; y < ind ; y++ ) {
@@ -569,6 +578,7 @@ BUILT_IN_COMMAND(fe)
 	window_display = 0;
 	window_display = old_display;
 	new_free(&placeholder);
+	free_compiled_block(&body);
 }
 
 
@@ -577,6 +587,7 @@ static void	for_next_cmd (int argc, char **argv, const char *subargs)
 	char 	*var, *cmds;
 	char	istr[256];
 	int	start, end, step = 1, i;
+	CompiledBlock *body;
 
 	if (!subargs)
 		subargs = empty_string;
@@ -604,13 +615,14 @@ static void	for_next_cmd (int argc, char **argv, const char *subargs)
 
 	if (*cmds == '{')
 		cmds++;
+	body = compile_block(cmds);
 	will_catch_break_exceptions++;
 	will_catch_continue_exceptions++;
 	for (i = start; step > 0 ? i <= end : i >= end; i += step)
 	{
 		snprintf(istr, 255, "%d", i);
 		add_local_alias(var, istr, 0);
-		runcmds(cmds, subargs);
+		run_compiled_block(body, subargs);
 
 		if (break_exception)
 		{
@@ -626,12 +638,14 @@ static void	for_next_cmd (int argc, char **argv, const char *subargs)
 	}
 	will_catch_break_exceptions--;
 	will_catch_continue_exceptions--;
+	free_compiled_block(&body);
 }
 
 static void	for_fe_cmd (int argc, char **argv, const char *subargs)
 {
 	char 	*var, *list, *cmds;
 	char	*next, *real_list, *x;
+	CompiledBlock *body;
 
 	if (!subargs)
 		subargs = empty_string;
@@ -650,13 +664,14 @@ static void	for_fe_cmd (int argc, char **argv, const char *subargs)
 	if (*list == '(')
 		list++;
 	x = real_list = expand_alias(list, subargs);
+	body = compile_block(cmds);
 	will_catch_break_exceptions++;
 	will_catch_continue_exceptions++;
 	while (real_list && *real_list)
 	{
 		next = next_func_arg(real_list, &real_list);
 		add_local_alias(var, next, 0);
-		runcmds(cmds, subargs);
+		run_compiled_block(body, subargs);
 
 		if (break_exception) {
 			break_exception = 0;
@@ -672,6 +687,7 @@ static void	for_fe_cmd (int argc, char **argv, const char *subargs)
 	will_catch_break_exceptions--;
 	will_catch_continue_exceptions--;
 	new_free(&x);
+	free_compiled_block(&body);
 }
 
 static void	for_pattern_cmd (int argc, char **argv, const char *subargs)
@@ -727,6 +743,8 @@ BUILT_IN_COMMAND(forcmd)
 	char        *iteration      = NULL;
 	char        *blah           = NULL;
 	char        *commands       = NULL;
+	CompiledBlock *body, *step;
+	size_t	evallen;
 
 	if (!subargs)
 		subargs = empty_string;
@@ -772,13 +790,16 @@ BUILT_IN_COMMAND(forcmd)
 	commands = LOCAL_COPY(working);
 
 	runcmds(commence, subargs);
+	body = compile_block(commands);
+	step = compile_block(iteration);
 
 	will_catch_break_exceptions++;
 	will_catch_continue_exceptions++;
-	lameeval = alloca(strlen(evaluation) + 2);
+	evallen = strlen(evaluation) + 1;
+	lameeval = alloca(evallen + 1);
 	while (1)
 	{
-		strlcpy(lameeval, evaluation, strlen(evaluation) + 1);
+		memcpy(lameeval, evaluation, evallen);
 		blah = parse_inline(lameeval, subargs);
 		if (!check_val(blah))
 		{
@@ -787,7 +808,7 @@ BUILT_IN_COMMAND(forcmd)
 		}
 
 		new_free(&blah);
-		runcmds(commands, subargs);
+		run_compiled_block(body, subargs);
 		if (break_exception)
 		{
 			break_exception = 0;
@@ -800,12 +821,14 @@ BUILT_IN_COMMAND(forcmd)
 		if (system_exception)
 			break;
 
-		runcmds(iteration, subargs);
+		run_compiled_block(step, subargs);
 	}
 	will_catch_break_exceptions--;
 	will_catch_continue_exceptions--;
 
 	new_free(&blah);
+	free_compiled_block(&body);
+	free_compiled_block(&step);
 }
 
 /*
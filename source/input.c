@@ -515,6 +515,20 @@ void 	cursor_to_input (void)
  *  UPDATE_JUST_CURSOR: I changed the logical cursor, update physical cursor.
  *
  */
+static	int	input_updates_permitted = 1;
+
+/*
+ * permit_input_update: Like permit_status_update(), turns drawing the
+ * input line off (0) or on (1) and returns what it was before.
+ */
+int	permit_input_update (int flag)
+{
+	int	old_flag = input_updates_permitted;
+
+	input_updates_permitted = flag;
+	return old_flag;
+}
+
 void	update_input (void *which_screen, int update)
 {
 	int	old_zone;
@@ -531,7 +545,7 @@ void	update_input (void *which_screen, int update)
 	/*
 	 * No input line in dumb or bg mode.
 	 */
-	if (dumb_mode || !foreground)
+	if (dumb_mode || !foreground || !input_updates_permitted)
 		return;
 
 	original_update = update;
@@ -878,6 +892,46 @@ void	set_input (const char *str)
 
 }
 
+/*
+ * input_insert_text: Put 'str' into the input buffer at the cursor, either
+ * pushing the rest of the line over ('insert' is 1) or writing over it
+ * ('insert' is 0), and leave the cursor after it.  This moves the tail of
+ * the input line once and redraws it once, no matter how long 'str' is,
+ * so use this instead of calling input_add_character() for each byte when
+ * you have a whole string (pastes, /XTYPE -LITERAL, TYPE_TEXT, yanks).
+ */
+void	input_insert_text (const char *str, int insert)
+{
+	size_t	len, tail, room;
+
+	if (!str || !*str || LOGICAL_CURSOR >= INPUT_BUFFER_SIZE)
+		return;
+
+	len = strlen(str);
+	tail = strlen(&THIS_CHAR);
+
+	if (insert)
+	{
+		room = INPUT_BUFFER_SIZE - LOGICAL_CURSOR - tail;
+		if (len > room)
+			len = room;
+		memmove(&INPUT_BUFFER[LOGICAL_CURSOR + len], &THIS_CHAR, 
+				tail + 1);
+	}
+	else
+	{
+		room = INPUT_BUFFER_SIZE - LOGICAL_CURSOR;
+		if (len > room)
+			len = room;
+		if (len >= tail)
+			INPUT_BUFFER[LOGICAL_CURSOR + len] = 0;
+	}
+	memcpy(&THIS_CHAR, str, len);
+
+	input_move_cursor(len, 0);
+	update_input(last_input_screen, UPDATE_ALL);
+}
+
 /*
  * get_input: returns a pointer to the input buffer.  Changing this will
  * actually change the input buffer.  This is a bad way to change the input
@@ -1329,21 +1383,10 @@ BUILT_IN_KEYBINDING(refresh_inputline)
  */
 BUILT_IN_KEYBINDING(input_yank_cut_buffer)
 {
-	char	*ptr = NULL;
-
 	if (!CUT_BUFFER)
 		return;
 
-	ptr = LOCAL_COPY(&THIS_CHAR);
-	THIS_CHAR = 0;
-	ADD_TO_INPUT(CUT_BUFFER);
-	ADD_TO_INPUT(ptr);
-	update_input(last_input_screen, UPDATE_FROM_CURSOR);
-
-	input_move_cursor(strlen(cut_buffer), 1);
-	if (LOGICAL_CURSOR > INPUT_BUFFER_SIZE)
-		LOGICAL_CURSOR = INPUT_BUFFER_SIZE;
-	update_input(last_input_screen, UPDATE_JUST_CURSOR);
+	input_insert_text(CUT_BUFFER, 1);
 }
 
 
@@ -1505,8 +1548,7 @@ BUILT_IN_KEYBINDING(insert_altcharset)
 /* type_text: the BIND function TYPE_TEXT */
 BUILT_IN_KEYBINDING(type_text)
 {
-	for (; string && *string; string++)
-		input_add_character(*string, NULL);
+	input_insert_text(string, get_int_var(INSERT_MODE_VAR));
 }
 
 /* parse_text: the bindable function that executes its string */
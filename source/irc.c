@@ -83,12 +83,14 @@ const char ridiculous_version_name[] = "Trencherman";
 #include "window.h"
 #include "exec.h"
 #include "notify.h"
+#include "who.h"
 #include "mail.h"
 #include "timer.h"
 #include "newio.h"
 #include "parse.h"
 #include "levels.h"
 #include "extlang.h"
+#include "bench.h"
 #include <pwd.h>
 
 
@@ -127,6 +129,9 @@ int		quick_startup = 0;
 /* Set if user does not want to auto-connect to a server upon startup */
 int		dont_connect = 0;
 
+/* Set to a server transcript to replay instead of connecting (-R) */
+static char *	replay_file = NULL;
+
 /* Set to the current time, each time you press a key. */
 Timeval		idle_time = { 0, 0 };
 
@@ -226,6 +231,7 @@ static		char	switch_help[] =
       -L <file>\tLoads <file> instead of your .ircrc file             \n\
       -n <nick>\tThe program will use <nick> as your default nickname \n\
       -p <port>\tThe program will use <port> as the default portnum   \n\
+      -R <file>\tReplay a server transcript headless and time it      \n\
       -z <user>\tThe program will use <user> as your default username \n";
 
 
@@ -289,6 +295,8 @@ void	irc_exit (int really_quit, const char *format, ...)
 #endif
 
 	close_all_servers(quit_message);
+	close_log_segments();
+	flush_all_logs();
 	value = 0;
 	logger(&value);
 	get_child_exit(-1);  /* In case some children died in the exit hook. */
@@ -316,6 +324,10 @@ void	irc_exit (int really_quit, const char *format, ...)
 	flush_on_hooks();
 	flush_all_symbols();
 	window_display = old_window_display;
+#ifdef WITH_THREADED_STDOUT
+	tio_close(tio_stdout);		/* Wait for the terminal to catch up */
+	tio_stdout = NULL;
+#endif
 	fprintf(stdout, "\r");
 	fflush(stdout);
 
@@ -463,7 +475,7 @@ static	void	show_version (void)
  *
  * Sanity check:
  *   Supported flags: -a, -b, -B, -d, -f, -F, -h, -q, -s -v, -x
- *   Flags that take args: -c, -l, -L, -n, -p, -z
+ *   Flags that take args: -c, -l, -L, -n, -p, -R, -z
  *
  * We use getopt() so that your local argument passing convension
  * will prevail.  The first argument that occurs after all of the normal 
@@ -673,7 +685,7 @@ static	void	parse_args (int argc, char **argv)
 	/*
 	 * Parse the command line arguments.
 	 */
-	while ((ch = getopt(argc, argv, "aBbc:dhH:l:L:n:p:qsSvxz:")) != EOF)
+	while ((ch = getopt(argc, argv, "aBbc:dhH:l:L:n:p:qR:sSvxz:")) != EOF)
 	{
 		switch (ch)
 		{
@@ -742,6 +754,10 @@ static	void	parse_args (int argc, char **argv)
 				malloc_strcpy(&default_channel, optarg);
 				break;
 
+			case 'R': /* Replay a transcript -- see bench.c */
+				malloc_strcpy(&replay_file, optarg);
+				break;
+
 			case 'H':
 				tmp_hostname = optarg;
 				break;
@@ -967,6 +983,12 @@ static	int		level = 0,
 	if (level == 1 && need_defered_commands)
 		do_defered_commands();
 
+	/* Send the JOINs and WHOs that were saved up to go out together */
+	if (need_deferred_joins)
+		send_deferred_joins();
+	if (need_deferred_whos)
+		send_deferred_whos();
+
 	/* Make sure all the servers are connected that ought to be */
 	window_check_servers();
 
@@ -1165,7 +1187,10 @@ void    load_ircrc (void)
 /*************************************************************************/
 int 	main (int argc, char *argv[])
 {
-	setvbuf(stdout, NULL, _IOLBF, 1024);
+	/* Our own buffer, so it really is big enough for a frame's output */
+	static	char	stdout_buffer[16384];
+
+	setvbuf(stdout, stdout_buffer, _IOLBF, sizeof stdout_buffer);
 #ifdef SOCKS
 	SOCKSinit(argv[0]);
 #endif
@@ -1221,7 +1246,7 @@ int 	main (int argc, char *argv[])
 		fprintf(stderr, "Process [%d]", getpid());
 		if (isatty(0))
 			fprintf(stderr, " connected to tty [%s]", ttyname(0));
-		else
+		else if (!replay_file)
 			dumb_mode = 1;
 		fprintf(stderr, "\n");
 	}
@@ -1243,6 +1268,20 @@ int 	main (int argc, char *argv[])
 
 	message_from(NULL, LEVEL_OTHER);
 
+	/*
+	 * A replay draws on a 24x80 vt100 that nobody is looking at, so
+	 * that the whole display is timed, and at the same size every time.
+	 * Taking the tty away also keeps us from using its size (or 
+	 * messing with its settings).
+	 */
+	if (replay_file)
+	{
+		setenv("TERM", "vt100", 1);
+		freopen("/dev/null", "r", stdin);
+		freopen("/dev/null", "w", stdout);
+		use_input = 0;		/* Nobody's typing */
+	}
+
 	/* 
 	 * We use dumb mode for -d, -b, when stdout is redirected to a file,
 	 * or as a failover if init_screen() fails. 
@@ -1280,7 +1319,12 @@ int 	main (int argc, char *argv[])
 
 	set_input(empty_string);
 
-	if (dont_connect)
+	if (replay_file)
+	{
+		if (bench_start(replay_file) < 0)
+			irc_exit(1, NULL);
+	}
+	else if (dont_connect)
 		display_server_list();		/* Let user choose server */
 	else
 	{
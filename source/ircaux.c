@@ -162,6 +162,10 @@ void	fatal_malloc_check (void *ptr, const char *special, const char *fn, int lin
 	}
 }
 
+/* How many allocations (and bytes) there have been; see bench.c */
+	unsigned long	new_malloc_count = 0;
+	unsigned long	new_malloc_bytes = 0;
+
 /*
  * really_new_malloc is the general interface to the malloc(3) call.
  * It is only called by way of the ``new_malloc'' #define.
@@ -171,6 +175,9 @@ void *	really_new_malloc (size_t size, const char *fn, int line)
 {
 	char	*ptr;
 
+	new_malloc_count++;
+	new_malloc_bytes += size;
+
 	if (!(ptr = (char *)malloc(size + sizeof(MO))))
 		panic(1, "Malloc() failed from [%s/%d], giving up!", fn, line);
 
@@ -293,6 +300,8 @@ void *	really_new_realloc (void **ptr, size_t size, const char *fn, int line)
 		}
 
 		/* Copy everything, including the MO buffer */
+		new_malloc_count++;
+		new_malloc_bytes += size;
 		VALGRIND_MEMPOOL_FREE(mo_ptr(*ptr), *ptr);
 		VALGRIND_DESTROY_MEMPOOL(mo_ptr(*ptr));
 		if ((newptr = (char *)realloc(mo_ptr(*ptr), size + sizeof(MO))))
@@ -1772,20 +1781,24 @@ static 	Filename 	path_to_bunzip2;
 		goto file_not_found;
 	    }
 	    while (0);
+        }
 
-            if (epic_stat(fullname, sb) < 0)
-            {
-                if (do_error)
-                    yell("%s could not be accessed", fullname);
-                goto error_cleanup;
-            }
+	/* 
+	 * Callers look at 'sb' (ie, to refuse executables), so fill it in
+	 * for files given with a compression extension, too.
+	 */
+        if (epic_stat(fullname, sb) < 0)
+        {
+            if (do_error)
+                yell("%s could not be accessed", fullname);
+            goto error_cleanup;
+        }
 
-            if (S_ISDIR(sb->st_mode))
-            {
-                if (do_error)
-                    yell("%s is a directory", fullname);
-                goto error_cleanup;
-            }
+        if (S_ISDIR(sb->st_mode))
+        {
+            if (do_error)
+                yell("%s is a directory", fullname);
+            goto error_cleanup;
         }
 
         /*
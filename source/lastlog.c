@@ -62,7 +62,7 @@ typedef struct	lastlog_stru
 
 static	intmax_t global_lastlog_refnum = 0;
 
-static int	show_lastlog (Lastlog **l, int *skip, int *number, Mask *level_mask, char *match, regex_t *rex, int *max, const char *target, int mangler, unsigned winref, char **);
+static int	show_lastlog (Lastlog **l, int *skip, int *number, Mask *level_mask, char *match, regex_t *rex, LastlogFilter *filter, int *max, const char *target, int mangler, unsigned winref, char **);
 static int	oldest_lastlog_for_window (Lastlog **item, unsigned winref);
 static int	newer_lastlog_entry (Lastlog **item, unsigned winref);
 static int	older_lastlog_entry (Lastlog **item, unsigned winref);
@@ -70,6 +70,9 @@ static int	newest_lastlog_for_window (Lastlog **item, unsigned winref);
 static void	remove_lastlog_item (Lastlog *item);
 static void	switch_lastlog_window (Lastlog *item, unsigned newref);
 static void	move_lastlog_item (Lastlog *item, unsigned newref);
+static void	index_lastlog_item (Lastlog *item);
+static void	unindex_lastlog_item (Lastlog *item);
+static void	forget_lastlog_index (unsigned winref);
 
 Lastlog *	lastlog_oldest = NULL;
 Lastlog *	lastlog_newest = NULL;
@@ -233,6 +236,7 @@ intmax_t	add_to_lastlog (Window *window, const char *line)
 
 	if (!lastlog_oldest)
 		lastlog_oldest = lastlog_newest;
+	index_lastlog_item(new_l);
 
 	if (mask_isset(&window->lastlog_mask, who_level))
 	{
@@ -262,6 +266,10 @@ void 	trim_lastlog (Window *window)
 			remove_lastlog_item(item);
 		}
 	}
+
+	/* A window that can't have a lastlog doesn't need an index */
+	if (window->lastlog_max == 0)
+		forget_lastlog_index(window->refnum);
 }
 
 /*
@@ -360,6 +368,7 @@ BUILT_IN_COMMAND(lastlog)
 	Lastlog *	lastshown;
 	regex_t 	realreg;
 	regex_t *	rex = NULL;
+	LastlogFilter *	filter = NULL;
 	int		cnt;
 	char *		arg;
 	int		header = 1;
@@ -610,6 +619,17 @@ BUILT_IN_COMMAND(lastlog)
 		rex = &realreg;
 	}
 
+	/* The index can't see through -MANGLE */
+	if (!mangler)
+	{
+		if (match)
+			filter = new_lastlog_filter(winref, match, 
+						LASTLOG_FILTER_WILD);
+		else if (regex)
+			filter = new_lastlog_filter(winref, regex, 
+						LASTLOG_FILTER_REGEX);
+	}
+
 	if (x_debug & DEBUG_LASTLOG)
 	{
 		yell("Lastlog summary status:");
@@ -681,7 +701,7 @@ BUILT_IN_COMMAND(lastlog)
 		char *result = NULL;
 
 		if (show_lastlog(&l, &skip, &number, &level_mask, 
-				match, rex, &max, target, mangler, winref,
+				match, rex, filter, &max, target, mangler, winref,
 				&result))
 		{
 		    if (counter == 0 && before > 0)
@@ -772,7 +792,7 @@ BUILT_IN_COMMAND(lastlog)
 		char *result = NULL;
 
 		if (show_lastlog(&l, &skip, &number, &level_mask, 
-				match, rex, &max, target, mangler, winref,
+				match, rex, filter, &max, target, mangler, winref,
 				&result))
 		{
 		    if (counter == 0 && before > 0)
@@ -846,6 +866,7 @@ bail:
 		fclose(outfp);
 	if (rex)
 		regfree(rex);
+	free_lastlog_filter(&filter);
 	current_window->lastlog_mask = save_mask;
 	pop_message_from(lc);
 	return;
@@ -855,7 +876,7 @@ bail:
  * This returns 1 if the current item pointed to by 'l' is something that
  * should be displayed based on the criteron provided.
  */
-static int	show_lastlog (Lastlog **l, int *skip, int *number, Mask *level_mask, char *match, regex_t *rex, int *max, const char *target, int mangler, unsigned winref, char **result)
+static int	show_lastlog (Lastlog **l, int *skip, int *number, Mask *level_mask, char *match, regex_t *rex, LastlogFilter *filter, int *max, const char *target, int mangler, unsigned winref, char **result)
 {
 	const char *str = NULL;
 	*result = NULL;
@@ -903,6 +924,12 @@ static int	show_lastlog (Lastlog **l, int *skip, int *number, Mask *level_mask,
 	else
 		str = (*l)->msg;
 
+	if (!lastlog_filter_maybe(filter, (*l)->refnum))
+	{
+		if (x_debug & DEBUG_LASTLOG)
+			yell("Line [%s] not in the index", str);
+		return 0;			/* Can't match anything */
+	}
 	if (match && !wild_match(match, str))
 	{
 		if (x_debug & DEBUG_LASTLOG)
@@ -1048,6 +1075,7 @@ BUILT_IN_FUNCTION(function_lastlog, word)
 	int	line = 1;
 	size_t	rvclue = 0;
 	char *	rejects = NULL;
+	LastlogFilter *filter;
 
 	GET_FUNC_ARG(windesc, word);
 	GET_DWORD_ARG(pattern, word);
@@ -1058,6 +1086,7 @@ BUILT_IN_FUNCTION(function_lastlog, word)
 	if (!(win = get_window_by_desc(windesc)))
 		RETURN_EMPTY;
 
+	filter = new_lastlog_filter(win->refnum, pattern, LASTLOG_FILTER_WILD);
 	for (iter = lastlog_newest; iter; iter = iter->older)
 	{
 		if (iter->winref != win->refnum)
@@ -1066,11 +1095,13 @@ BUILT_IN_FUNCTION(function_lastlog, word)
 			continue;
 
 		if (mask_isset(&lastlog_levels, iter->level))
-		    if (wild_match(pattern, iter->msg))
+		    if (lastlog_filter_maybe(filter, iter->refnum) &&
+				wild_match(pattern, iter->msg))
 			malloc_strcat_word_c(&retval, space, 
 					ltoa(line), DWORD_NO, &rvclue);
 		line++;
 	}
+	free_lastlog_filter(&filter);
 
 	if (retval)
 		return retval;
@@ -1152,6 +1183,562 @@ BUILT_IN_FUNCTION(function_lastlogctl, input)
 }
 #endif
 
+/************************************************************************/
+/*
+ * The lastlog index.
+ *
+ * Looking for something in a window's lastlog (or its scrollback) means
+ * running wild_match() or regexec() on every line, which gets slow when a
+ * window holds a lot of lines.  When /SET LASTLOG_INDEX is ON, the first
+ * search of a window builds an index of every three letter/digit sequence
+ * (a "trigram") to the lastlog refnums of the lines that contain it, and
+ * after that add_to_lastlog() and trim_lastlog() keep it up to date.
+ *
+ * A search pulls out of its pattern the runs of letters and digits that 
+ * every matching line has to contain, and then only the lines that have 
+ * all of their trigrams need to be checked for real.  The index can only
+ * say "maybe" or "definitely not", so a pattern it can't use (like "*" or
+ * "foo|bar") just checks every line, like always.
+ */
+#define TRIGRAM_CHARS	36
+#define TRIGRAMS	(TRIGRAM_CHARS * TRIGRAM_CHARS * TRIGRAM_CHARS)
+
+typedef struct	PostingStru
+{
+	uint32_t *	ids;		/* Refnums of lines, oldest first */
+	size_t		start;		/* Trimmed lines before this */
+	size_t		end;
+	size_t		size;
+}	Posting;
+
+typedef struct	LastlogIndexStru
+{
+	struct LastlogIndexStru *next;
+	unsigned	winref;
+	Posting *	grams[TRIGRAMS];
+}	LastlogIndex;
+
+struct	LastlogFilterStru
+{
+	uint32_t *	ids;		/* Lines that might match, sorted */
+	size_t		count;
+	intmax_t	oldest;		/* Lines outside of these weren't */
+	intmax_t	newest;		/* in the index; they might match */
+};
+
+static	LastlogIndex *	lastlog_indexes = NULL;
+
+/*
+ * The refnums are stored in 32 bits.  If you ever see four billion lines
+ * of output in one session, the index just stops being used.
+ */
+static int	lastlog_index_ok (void)
+{
+	if (!get_int_var(LASTLOG_INDEX_VAR))
+		return 0;
+	if (global_lastlog_refnum > (intmax_t)UINT32_MAX)
+		return 0;
+	return 1;
+}
+
+static int	trigram_char (int c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'z')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'Z')
+		return c - 'A' + 10;
+	return -1;
+}
+
+/*
+ * Call 'func' for each trigram in 'str'.  Control characters don't break
+ * up a word, so "hel^Blo" has "llo" in it, the same as it does when the
+ * screen doesn't show bold.  If 'skip_colors' is set, ^C color codes are
+ * skipped the same way, so "hel^C04lo" has "llo" in it too.
+ */
+static void	str_trigrams (const unsigned char *str, int skip_colors, void (*func) (LastlogIndex *, int, uint32_t), LastlogIndex *idx, uint32_t id)
+{
+	int	a = -1, b = -1, c;
+
+	for (; *str; str++)
+	{
+		if (*str == '\003' && skip_colors)
+		{
+			if (isdigit(str[1]))
+			{
+				str++;
+				if (isdigit(str[1]))
+					str++;
+				if (str[1] == ',' && isdigit(str[2]))
+				{
+					str += 2;
+					if (isdigit(str[1]))
+						str++;
+				}
+			}
+			continue;
+		}
+		if (*str < 32 || *str == 127)
+			continue;
+
+		if ((c = trigram_char(*str)) < 0)
+		{
+			a = b = -1;
+			continue;
+		}
+		if (a >= 0 && b >= 0)
+			func(idx, (a * TRIGRAM_CHARS + b) * TRIGRAM_CHARS + c, id);
+		a = b;
+		b = c;
+	}
+}
+
+/* Binary search 'p' for 'id'.  Returns where it is, or where it goes. */
+static size_t	posting_find (Posting *p, uint32_t id)
+{
+	size_t	lo = p->start, hi = p->end, mid;
+
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		if (p->ids[mid] < id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static void	posting_add (LastlogIndex *idx, int gram, uint32_t id)
+{
+	Posting *p;
+	size_t	where;
+
+	if (!(p = idx->grams[gram]))
+	{
+		p = idx->grams[gram] = (Posting *)new_malloc(sizeof(Posting));
+		p->ids = NULL;
+		p->start = p->end = p->size = 0;
+	}
+
+	/* Nearly always, this is a new line, so it goes at the end */
+	if (p->end > p->start && p->ids[p->end - 1] >= id)
+	{
+		where = posting_find(p, id);
+		if (where < p->end && p->ids[where] == id)
+			return;		/* Word is in the line twice */
+	}
+	else
+		where = p->end;
+
+	if (p->end == p->size)
+	{
+		/* Reclaim the space of trimmed lines before growing */
+		if (p->start > p->size / 2)
+		{
+			memmove(p->ids, p->ids + p->start, 
+				(p->end - p->start) * sizeof(uint32_t));
+			where -= p->start;
+			p->end -= p->start;
+			p->start = 0;
+		}
+		else
+		{
+			p->size = p->size ? p->size * 2 : 4;
+			RESIZE(p->ids, uint32_t, p->size);
+		}
+	}
+
+	if (where < p->end)
+		memmove(p->ids + where + 1, p->ids + where, 
+			(p->end - where) * sizeof(uint32_t));
+	p->ids[where] = id;
+	p->end++;
+}
+
+static void	posting_remove (LastlogIndex *idx, int gram, uint32_t id)
+{
+	Posting *p;
+	size_t	where;
+
+	if (!(p = idx->grams[gram]) || p->start == p->end)
+		return;
+
+	/* Nearly always, this is the oldest line being trimmed */
+	if (p->ids[p->start] == id)
+		where = p->start;
+	else if ((where = posting_find(p, id)) >= p->end || p->ids[where] != id)
+		return;		/* Already removed (word was in the line twice) */
+
+	if (where == p->start)
+		p->start++;
+	else
+	{
+		memmove(p->ids + where, p->ids + where + 1,
+			(p->end - where - 1) * sizeof(uint32_t));
+		p->end--;
+	}
+
+	if (p->start == p->end)
+	{
+		new_free((char **)&p->ids);
+		new_free((char **)&idx->grams[gram]);
+	}
+}
+
+static void	index_line (LastlogIndex *idx, Lastlog *item, void (*func) (LastlogIndex *, int, uint32_t))
+{
+	str_trigrams(item->msg, 0, func, idx, (uint32_t)item->refnum);
+	if (strchr(item->msg, '\003'))
+		str_trigrams(item->msg, 1, func, idx, (uint32_t)item->refnum);
+}
+
+static LastlogIndex *	find_lastlog_index (unsigned winref)
+{
+	LastlogIndex *idx;
+
+	for (idx = lastlog_indexes; idx; idx = idx->next)
+		if (idx->winref == winref)
+			return idx;
+	return NULL;
+}
+
+/* Find the window's index, building it if there isn't one yet */
+static LastlogIndex *	get_lastlog_index (unsigned winref)
+{
+	LastlogIndex *idx;
+	Lastlog *item;
+	int	i;
+
+	if (!lastlog_index_ok())
+		return NULL;
+	if ((idx = find_lastlog_index(winref)))
+		return idx;
+
+	idx = (LastlogIndex *)new_malloc(sizeof(LastlogIndex));
+	idx->winref = winref;
+	for (i = 0; i < TRIGRAMS; i++)
+		idx->grams[i] = NULL;
+	idx->next = lastlog_indexes;
+	lastlog_indexes = idx;
+
+	for (item = lastlog_oldest; item; item = item->newer)
+		if (item->winref == winref)
+			index_line(idx, item, posting_add);
+	return idx;
+}
+
+static void	free_lastlog_index (LastlogIndex *idx)
+{
+	LastlogIndex **prev;
+	int	i;
+
+	for (prev = &lastlog_indexes; *prev; prev = &(*prev)->next)
+	{
+		if (*prev == idx)
+		{
+			*prev = idx->next;
+			break;
+		}
+	}
+
+	for (i = 0; i < TRIGRAMS; i++)
+	{
+		if (idx->grams[i])
+		{
+			new_free((char **)&idx->grams[i]->ids);
+			new_free((char **)&idx->grams[i]);
+		}
+	}
+	new_free((char **)&idx);
+}
+
+static void	index_lastlog_item (Lastlog *item)
+{
+	LastlogIndex *idx;
+
+	if (lastlog_indexes && (idx = find_lastlog_index(item->winref)))
+	{
+		if (lastlog_index_ok())
+			index_line(idx, item, posting_add);
+		else
+			free_lastlog_index(idx);
+	}
+}
+
+static void	unindex_lastlog_item (Lastlog *item)
+{
+	LastlogIndex *idx;
+
+	if (lastlog_indexes && (idx = find_lastlog_index(item->winref)))
+		index_line(idx, item, posting_remove);
+}
+
+static void	forget_lastlog_index (unsigned winref)
+{
+	LastlogIndex *idx;
+
+	if (lastlog_indexes && (idx = find_lastlog_index(winref)))
+		free_lastlog_index(idx);
+}
+
+/* /SET LASTLOG_INDEX OFF throws all of the indexes away */
+void	set_lastlog_index (void *stuff)
+{
+	VARIABLE *v = (VARIABLE *)stuff;
+
+	if (!v->integer)
+		while (lastlog_indexes)
+			free_lastlog_index(lastlog_indexes);
+}
+
+/*
+ * The trigrams a line must have to be matched by a pattern are collected
+ * up in one of these.
+ */
+struct	required_grams
+{
+	int	grams[256];
+	int	count;
+	char	run[256];
+	int	len;
+};
+
+static void	require_run (struct required_grams *req)
+{
+	int	i, gram;
+
+	for (i = 2; i < req->len; i++)
+	{
+		if (req->count >= (int)(sizeof(req->grams) / sizeof(int)))
+			break;
+		gram = (trigram_char(req->run[i - 2]) * TRIGRAM_CHARS +
+			trigram_char(req->run[i - 1])) * TRIGRAM_CHARS +
+			trigram_char(req->run[i]);
+		req->grams[req->count++] = gram;
+	}
+	req->len = 0;
+}
+
+static void	require_char (struct required_grams *req, int c)
+{
+	if (trigram_char(c) < 0)
+		require_run(req);
+	else if (req->len < (int)sizeof(req->run))
+		req->run[req->len++] = c;
+}
+
+/*
+ * A wild_match() pattern has to match the whole line, so everything in
+ * it that isn't a * or % or ? has to be in the line.
+ */
+static void	wild_required_grams (const char *pattern, struct required_grams *req)
+{
+	for (; *pattern; pattern++)
+	{
+		if (*pattern == '\\' && pattern[1])
+			require_char(req, *++pattern);
+		else if (*pattern == '*' || *pattern == '%' || *pattern == '?')
+			require_run(req);
+		else
+			require_char(req, *pattern);
+	}
+	require_run(req);
+}
+
+/*
+ * For a regex, only plain letters and digits outside of any (group) count.
+ * A letter followed by ?, * or {} might not be there at all, and anything
+ * with a | in it is too much trouble to bother with.
+ */
+static void	regex_required_grams (const char *pattern, struct required_grams *req)
+{
+	int	depth = 0;
+
+	if (strchr(pattern, '|'))
+		return;
+
+	for (; *pattern; pattern++)
+	{
+	    switch (*pattern)
+	    {
+		case '\\':
+			/* \w, \b and friends aren't letters */
+			require_run(req);
+			if (pattern[1])
+				pattern++;
+			break;
+		case '[':
+			require_run(req);
+			pattern++;
+			if (*pattern == '^')
+				pattern++;
+			if (*pattern == ']')
+				pattern++;
+			while (*pattern && *pattern != ']')
+			{
+				if (*pattern == '[' && (pattern[1] == ':' ||
+				    pattern[1] == '.' || pattern[1] == '='))
+				{
+					const char *close;
+					char	x[3] = { pattern[1], ']', 0 };
+
+					if ((close = strstr(pattern + 2, x)))
+						pattern = close + 1;
+				}
+				pattern++;
+			}
+			if (!*pattern)
+				return;
+			break;
+		case '(':
+			depth++;
+			require_run(req);
+			break;
+		case ')':
+			depth--;
+			require_run(req);
+			break;
+		case '?':
+		case '*':
+		case '{':
+			if (req->len > 0)
+				req->len--;
+			require_run(req);
+			if (*pattern == '{')
+			{
+				while (pattern[1] && *pattern != '}')
+					pattern++;
+			}
+			break;
+		case '+':
+		case '.':
+		case '^':
+		case '$':
+			require_run(req);
+			break;
+		default:
+			if (depth > 0)
+				require_run(req);
+			else
+				require_char(req, *pattern);
+			break;
+	    }
+	}
+	require_run(req);
+}
+
+/*
+ * new_lastlog_filter: Get ready to search window 'winref' for 'pattern',
+ * which is a regex if 'type' is LASTLOG_FILTER_REGEX, and a wild_match()
+ * pattern otherwise.  Returns NULL if the index can't help, and you have
+ * to check every line.  Otherwise, lastlog_filter_maybe() tells you which 
+ * lines you don't have to check because they can't possibly match.
+ */
+LastlogFilter *	new_lastlog_filter (unsigned winref, const char *pattern, int type)
+{
+	struct required_grams	req = {{0}};
+	LastlogIndex *	idx;
+	LastlogFilter *	filter;
+	Lastlog *	item = NULL;
+	Posting *	p;
+	Posting *	smallest = NULL;
+	size_t		i, j;
+	int		g;
+
+	if (!pattern || !lastlog_index_ok())
+		return NULL;
+
+	if (type == LASTLOG_FILTER_REGEX)
+		regex_required_grams(pattern, &req);
+	else
+		wild_required_grams(pattern, &req);
+	if (req.count == 0)
+		return NULL;
+
+	if (!(idx = get_lastlog_index(winref)))
+		return NULL;
+
+	filter = (LastlogFilter *)new_malloc(sizeof(LastlogFilter));
+	filter->ids = NULL;
+	filter->count = 0;
+	filter->oldest = filter->newest = -1;
+	if (oldest_lastlog_for_window(&item, winref))
+		filter->oldest = item->refnum;
+	if (newest_lastlog_for_window(&item, winref))
+		filter->newest = item->refnum;
+
+	/* Start with the rarest trigram, and cross off from there */
+	for (g = 0; g < req.count; g++)
+	{
+		p = idx->grams[req.grams[g]];
+		if (!p)
+			return filter;		/* Nothing can match */
+		if (!smallest || p->end - p->start < smallest->end - smallest->start)
+			smallest = p;
+	}
+
+	filter->ids = (uint32_t *)new_malloc(sizeof(uint32_t) * 
+				(smallest->end - smallest->start));
+	memcpy(filter->ids, smallest->ids + smallest->start,
+			sizeof(uint32_t) * (smallest->end - smallest->start));
+	filter->count = smallest->end - smallest->start;
+
+	for (g = 0; g < req.count && filter->count; g++)
+	{
+		p = idx->grams[req.grams[g]];
+		if (p == smallest)
+			continue;
+
+		for (i = j = 0; i < filter->count; i++)
+		{
+			size_t	where = posting_find(p, filter->ids[i]);
+
+			if (where < p->end && p->ids[where] == filter->ids[i])
+				filter->ids[j++] = filter->ids[i];
+		}
+		filter->count = j;
+	}
+
+	return filter;
+}
+
+/*
+ * Returns 0 if the lastlog item 'refnum' can't match the filter's pattern,
+ * and 1 if it might (and you have to check it yourself).
+ */
+int	lastlog_filter_maybe (LastlogFilter *filter, intmax_t refnum)
+{
+	size_t	lo, hi, mid;
+
+	if (!filter)
+		return 1;
+	if (refnum < filter->oldest || refnum > filter->newest)
+		return 1;
+
+	lo = 0;
+	hi = filter->count;
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		if (filter->ids[mid] < (uint32_t)refnum)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (lo < filter->count && filter->ids[lo] == (uint32_t)refnum);
+}
+
+void	free_lastlog_filter (LastlogFilter **filter)
+{
+	if (!*filter)
+		return;
+	new_free((char **)&(*filter)->ids);
+	new_free((char **)filter);
+}
+
 /************************************************************************/
 
 static int	oldest_lastlog_for_window (Lastlog **item, unsigned winref)
@@ -1238,6 +1825,7 @@ static void	remove_lastlog_item (Lastlog *item)
 		item->newer->older = item->older;
 	item->newer = item->older = NULL;
 
+	unindex_lastlog_item(item);
 	item->dead = 1;
 	new_free((char **)&item->msg);
 	new_free((char **)&item->target);
@@ -1248,7 +1836,9 @@ static void	switch_lastlog_window (Lastlog *item, unsigned newref)
 {
 	/* Mark the old window's scrollback for reconstitution */
 	window_scrollback_needs_rebuild(item->winref);
+	unindex_lastlog_item(item);
 	item->winref = newref;
+	index_lastlog_item(item);
 	/* Mark the new window's scrollback for reconstitution */
 	window_scrollback_needs_rebuild(item->winref);
 }
@@ -1258,7 +1848,9 @@ static void	move_lastlog_item (Lastlog *item, unsigned newref)
 {
 	unsigned	oldref = item->winref;
 
+	unindex_lastlog_item(item);
 	item->winref = newref;
+	index_lastlog_item(item);
 	window_scrollback_needs_rebuild(oldref);
 	window_scrollback_needs_rebuild(newref);
 }
@@ -1348,6 +1940,15 @@ void	move_lastlog_item_by_regex (unsigned oldref, unsigned newref, const char *s
 void	lastlog_swap_winrefs (unsigned oldref, unsigned newref)
 {
 	Lastlog *l;
+	LastlogIndex *idx;
+
+	for (idx = lastlog_indexes; idx; idx = idx->next)
+	{
+		if (idx->winref == oldref)
+			idx->winref = newref;
+		else if (idx->winref == newref)
+			idx->winref = oldref;
+	}
 
 	for (l = lastlog_oldest; l; l = l->newer)
 	{
@@ -42,11 +42,341 @@
 #include "ircaux.h"
 #include "alias.h"
 #include "screen.h"
+#include "timer.h"
 
 	FILE	*irclog_fp;
 	int	logfile_line_mangler;
 	int	current_log_refnum = -1;
 
+/*
+ * Lines headed for a logfile are collected in a LogBuffer and written out
+ * all at once, instead of doing a write(2) for every line.  The buffer is
+ * written when it gets bigger than /SET LOG_BUFFER_SIZE, when the oldest
+ * line in it is /SET LOG_FLUSH_INTERVAL seconds old, when the log is
+ * closed, and when the client exits.  If LOG_FLUSH_INTERVAL is 0 (the 
+ * default), every line is written right away, as it always has been.
+ *
+ * If /SET LOG_WRITER_THREAD is on, the writing is done by another thread,
+ * so a slow disk doesn't hold up the client.  This needs pthreads, which
+ * you have if you built with threaded stdout or the pthread looper.
+ */
+#if defined(WITH_THREADED_STDOUT) || defined(USE_PTHREAD)
+# define LOG_WRITER
+# include <pthread.h>
+#endif
+
+typedef struct LogBufferStru {
+	struct LogBufferStru *next;
+	FILE *	fp;
+	char *	data;
+	size_t	len;
+	size_t	size;
+	time_t	oldest;			/* When the first unwritten line came */
+	unsigned long	line_count;	/* Counters since the log was opened */
+	unsigned long	byte_count;
+	unsigned long	flush_count;
+} LogBuffer;
+
+static	LogBuffer *	log_buffers = NULL;
+static	const char	log_flush_timeref[] = "LOGTIM";
+
+static void	log_write (FILE *fp, const char *data, size_t len);
+static void	log_writer_wait (void);
+static int	log_flush_timer (void *);
+
+/*
+ * get_log_buffer -- Find the buffer for a log's FILE.  The one we found 
+ * is moved to the front, since the same log tends to be written to many
+ * times in a row.
+ */
+static LogBuffer *	get_log_buffer (FILE *fp, int create)
+{
+	LogBuffer *lb, *prev = NULL;
+
+	for (lb = log_buffers; lb; prev = lb, lb = lb->next)
+		if (lb->fp == fp)
+			break;
+
+	if (lb)
+	{
+		if (prev)
+		{
+			prev->next = lb->next;
+			lb->next = log_buffers;
+			log_buffers = lb;
+		}
+		return lb;
+	}
+
+	if (!create)
+		return NULL;
+
+	lb = (LogBuffer *)new_malloc(sizeof(LogBuffer));
+	lb->fp = fp;
+	lb->data = NULL;
+	lb->len = lb->size = 0;
+	lb->oldest = 0;
+	lb->line_count = lb->byte_count = lb->flush_count = 0;
+	lb->next = log_buffers;
+	log_buffers = lb;
+	return lb;
+}
+
+static void	write_log_buffer (LogBuffer *lb)
+{
+	if (lb->len == 0)
+		return;
+
+	log_write(lb->fp, lb->data, lb->len);
+	lb->len = 0;
+	lb->oldest = 0;
+	lb->flush_count++;
+}
+
+/*
+ * flush_log_file -- Write out everything waiting to go to 'fp'.  Call 
+ * this before you write to a logfile's FILE directly, so the lines come
+ * out in the right order.  When this returns, it's all in the FILE.
+ */
+void	flush_log_file (FILE *fp)
+{
+	LogBuffer *lb;
+
+	if (fp && (lb = get_log_buffer(fp, 0)))
+		write_log_buffer(lb);
+	log_writer_wait();
+}
+
+/* Write out everything for every log (ie, at exit) */
+void	flush_all_logs (void)
+{
+	LogBuffer *lb;
+
+	for (lb = log_buffers; lb; lb = lb->next)
+		write_log_buffer(lb);
+	log_writer_wait();
+}
+
+/* The log is being closed -- write out what it has and forget it. */
+static void	forget_log_buffer (FILE *fp)
+{
+	LogBuffer *lb;
+
+	if (!(lb = get_log_buffer(fp, 0)))
+		return;
+
+	write_log_buffer(lb);
+	log_writer_wait();
+
+	/* get_log_buffer() moved it to the front */
+	log_buffers = lb->next;
+	new_free(&lb->data);
+	new_free((char **)&lb);
+}
+
+/*
+ * get_log_stats -- How many lines and bytes have been logged to 'fp'
+ * since it was opened, and how many writes that took.
+ * Returns -1 if nothing has ever been logged to 'fp'.
+ */
+int	get_log_stats (FILE *fp, unsigned long *nlines, unsigned long *nbytes, unsigned long *nflushes, size_t *pending)
+{
+	LogBuffer *lb;
+
+	*nlines = *nbytes = *nflushes = 0;
+	*pending = 0;
+	if (!fp || !(lb = get_log_buffer(fp, 0)))
+		return -1;
+
+	*nlines = lb->line_count;
+	*nbytes = lb->byte_count;
+	*nflushes = lb->flush_count;
+	*pending = lb->len;
+	return 0;
+}
+
+/*
+ * log_flush_timer -- Write out any buffer whose oldest line has been 
+ * waiting for LOG_FLUSH_INTERVAL seconds, and come back when the next
+ * one will have been.
+ */
+static int	log_flush_timer (void *unused)
+{
+	LogBuffer *lb;
+	int	interval;
+	time_t	right_now, next = 0;
+
+	interval = get_int_var(LOG_FLUSH_INTERVAL_VAR);
+	time(&right_now);
+
+	for (lb = log_buffers; lb; lb = lb->next)
+	{
+		if (lb->len == 0)
+			continue;
+		if (interval <= 0 || right_now - lb->oldest >= interval)
+			write_log_buffer(lb);
+		else if (next == 0 || lb->oldest + interval < next)
+			next = lb->oldest + interval;
+	}
+
+	if (next)
+		add_timer(1, log_flush_timeref, (double)(next - right_now), 1, 
+				log_flush_timer, NULL, NULL, GENERAL_TIMER, -1, 0);
+	return 0;
+}
+
+void	set_log_flush_interval (void *stuff)
+{
+	VARIABLE *v = (VARIABLE *)stuff;
+
+	if (v->integer < 0)
+		v->integer = 0;
+
+	/* Anything waiting goes out now; the new interval starts over */
+	if (timer_exists(log_flush_timeref))
+		remove_timer(log_flush_timeref);
+	flush_all_logs();
+}
+
+#ifdef LOG_WRITER
+/*
+ * The writer thread.  Buffers are handed to it on a queue; it writes and
+ * fflush()es them in order.  The main thread only waits for it when a log
+ * is closed or flushed with flush_log_file(), so it can't write to a FILE
+ * that's gone.  This doesn't use new_malloc(), which isn't thread safe.
+ */
+typedef struct LogChunkStru {
+	struct LogChunkStru *next;
+	FILE *	fp;
+	size_t	len;
+	char	data[1];
+} LogChunk;
+
+static	LogChunk *	log_queue_head = NULL;
+static	LogChunk *	log_queue_tail = NULL;
+static	int		log_writer_busy = 0;
+static	int		log_writer_started = 0;
+static	pthread_mutex_t	log_mtx = PTHREAD_MUTEX_INITIALIZER;
+static	pthread_cond_t	log_work = PTHREAD_COND_INITIALIZER;
+static	pthread_cond_t	log_idle = PTHREAD_COND_INITIALIZER;
+static	pthread_t	log_thread;
+
+static void *	log_writer_run (void *unused)
+{
+	LogChunk *c;
+
+	for (;;)
+	{
+		pthread_mutex_lock(&log_mtx);
+		while (!log_queue_head)
+		{
+			log_writer_busy = 0;
+			pthread_cond_broadcast(&log_idle);
+			pthread_cond_wait(&log_work, &log_mtx);
+		}
+		c = log_queue_head;
+		if (!(log_queue_head = c->next))
+			log_queue_tail = NULL;
+		log_writer_busy = 1;
+		pthread_mutex_unlock(&log_mtx);
+
+		fwrite(c->data, 1, c->len, c->fp);
+		fflush(c->fp);
+		free(c);
+	}
+	return NULL;
+}
+
+static void	log_write (FILE *fp, const char *data, size_t len)
+{
+	LogChunk *c;
+	int	rv;
+
+	if (!get_int_var(LOG_WRITER_THREAD_VAR) || 
+	    !(c = malloc(sizeof(LogChunk) + len)))
+	{
+		log_writer_wait();
+		fwrite(data, 1, len, fp);
+		fflush(fp);
+		return;
+	}
+
+	if (!log_writer_started)
+	{
+		if ((rv = pthread_create(&log_thread, NULL, 
+						log_writer_run, NULL)))
+		{
+			free(c);
+			yell("Could not start the log writer thread: %s", 
+					strerror(rv));
+			set_var_value(LOG_WRITER_THREAD_VAR, "OFF", 0);
+			fwrite(data, 1, len, fp);
+			fflush(fp);
+			return;
+		}
+		pthread_detach(log_thread);
+		log_writer_started = 1;
+	}
+
+	c->next = NULL;
+	c->fp = fp;
+	c->len = len;
+	memcpy(c->data, data, len);
+
+	pthread_mutex_lock(&log_mtx);
+	if (log_queue_tail)
+		log_queue_tail->next = c;
+	else
+		log_queue_head = c;
+	log_queue_tail = c;
+	log_writer_busy = 1;
+	pthread_cond_signal(&log_work);
+	pthread_mutex_unlock(&log_mtx);
+}
+
+/* Wait for the writer thread to finish everything it's been given */
+static void	log_writer_wait (void)
+{
+	if (!log_writer_started)
+		return;
+
+	pthread_mutex_lock(&log_mtx);
+	while (log_queue_head || log_writer_busy)
+		pthread_cond_wait(&log_idle, &log_mtx);
+	pthread_mutex_unlock(&log_mtx);
+}
+
+void	set_log_writer_thread (void *stuff)
+{
+	VARIABLE *v = (VARIABLE *)stuff;
+
+	if (v->integer == 0)
+		log_writer_wait();
+}
+#else
+static void	log_write (FILE *fp, const char *data, size_t len)
+{
+	fwrite(data, 1, len, fp);
+	fflush(fp);
+}
+
+static void	log_writer_wait (void)
+{
+	return;
+}
+
+void	set_log_writer_thread (void *stuff)
+{
+	VARIABLE *v = (VARIABLE *)stuff;
+
+	if (v->integer)
+	{
+		say("This client was not built with thread support.");
+		v->integer = 0;
+	}
+}
+#endif
+
 static FILE *	open_log (const char *logfile, FILE **fp)
 {
 	char *		tempname;
@@ -129,6 +459,7 @@ struct	tm	*ugh;
 
 	if (*fp)
 	{
+		forget_log_buffer(*fp);
 		fprintf(*fp, "IRC log ended %s\n", my_buffer);
 		fflush(*fp);
 		fclose(*fp);
@@ -187,6 +518,8 @@ void 	add_to_log (int logref, FILE *fp, long winref, const unsigned char *line,
 {
 	char	*local_line = NULL;
 	int	old_logref;
+	LogBuffer *lb;
+	size_t	len;
 
 	if (!fp || inhibit_logging)
 		return;
@@ -220,8 +553,30 @@ void 	add_to_log (int logref, FILE *fp, long winref, const unsigned char *line,
 		local_line = prepend_exp;
 	}
 
-	fprintf(fp, "%s\n", local_line);
-	fflush(fp);
+	lb = get_log_buffer(fp, 1);
+	len = strlen(local_line);
+	if (lb->len + len + 1 > lb->size)
+	{
+		lb->size = lb->len + len + 1 + BIG_BUFFER_SIZE;
+		RESIZE(lb->data, char, lb->size);
+	}
+	memcpy(lb->data + lb->len, local_line, len);
+	lb->data[lb->len + len] = '\n';
+	lb->len += len + 1;
+	lb->line_count++;
+	lb->byte_count += len + 1;
+
+	if (get_int_var(LOG_FLUSH_INTERVAL_VAR) <= 0 ||
+	    lb->len >= (size_t)get_int_var(LOG_BUFFER_SIZE_VAR))
+		write_log_buffer(lb);
+	else if (lb->oldest == 0)
+	{
+		time(&lb->oldest);
+		if (!timer_exists(log_flush_timeref))
+			add_timer(1, log_flush_timeref, 
+				get_int_var(LOG_FLUSH_INTERVAL_VAR), 1, 
+				log_flush_timer, NULL, NULL, GENERAL_TIMER, -1, 0);
+	}
 
 	new_free(&local_line);
 	current_log_refnum = old_logref;
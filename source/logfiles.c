@@ -41,6 +41,9 @@
 #include "server.h"
 #include "window.h"
 #include "functions.h"
+#include "alist.h"
+#include "reg.h"
+#include "elf.h"
 
 #define MAX_TARGETS 32
 
@@ -70,12 +73,64 @@ struct Logfile {
 	int	active;
 
 	time_t	activity;
+	unsigned long	last_line;	/* So we only log a line once */
+
+	/* See "Rotating logs" below */
+	long	rotate_size;		/* New segment after this many bytes */
+	long	rotate_time;		/* ... or this many seconds */
+	char *	segment;		/* The segment we're writing to */
+	time_t	segment_start;
+	time_t	segment_last;
+	long	segment_bytes;
+	long	segment_lines;
+	char *	segment_targets;	/* Targets logged to this segment */
 };
 
 typedef struct Logfile Logfile;
 Logfile *logfiles = NULL;
 int	logref = 0;
 
+/*
+ * add_to_logs() is called for every line of output, so rather than ask 
+ * every log whether it wants the line, we keep an index of which logs 
+ * want what.  Window and server logs are filed under each refnum they
+ * log, and target logs under each literal target.  Only target logs with 
+ * wildcard targets have to be wild_match()ed one by one.  The index is 
+ * thrown away whenever a log is created, deleted, or has its targets
+ * changed, and is rebuilt the next time it's needed.
+ */
+typedef struct LogRouteStru {
+	char *		name;		/* Target name, or refnum */
+	u_32int_t	hash;		/* Filled in by the alist */
+	Logfile **	logs;
+	int		count;
+} LogRoute;
+
+typedef struct LogRouteListStru {
+	LogRoute **	list;
+	int		max;
+	int		max_alloc;
+	alist_func	func;
+	hash_type	hash;
+} LogRouteList;
+
+typedef struct WildRouteStru {
+	struct WildRouteStru *next;
+	Logfile *	log;
+	const char *	pattern;	/* Belongs to the log's target list */
+} WildRoute;
+
+static	int		log_index_dirty = 1;
+static	LogRouteList	by_window = { NULL, 0, 0, (alist_func) my_strnicmp, HASH_SENSITIVE };
+static	LogRouteList	by_server = { NULL, 0, 0, (alist_func) my_strnicmp, HASH_SENSITIVE };
+static	LogRouteList	by_target = { NULL, 0, 0, (alist_func) my_strnicmp, HASH_INSENSITIVE };
+static	LogRoute	all_servers = { NULL, 0, NULL, 0 };	/* SERVER ALL */
+static	LogRoute	untargeted = { NULL, 0, NULL, 0 };	/* No targets */
+static	WildRoute *	wild_targets = NULL;
+static	unsigned long	log_line = 0;
+
+static	void	close_log_segment (Logfile *);
+
 static Logfile *	new_logfile (void)
 {
 	Logfile *log, *ptr;
@@ -107,7 +162,15 @@ static Logfile *	new_logfile (void)
 	log->mangle_desc = NULL;
 	log->active = 0;
 	time(&log->activity);
-
+	log->last_line = 0;
+	log->rotate_size = 0;
+	log->rotate_time = 0;
+	log->segment = NULL;
+	log->segment_start = log->segment_last = 0;
+	log->segment_bytes = log->segment_lines = 0;
+	log->segment_targets = NULL;
+
+	log_index_dirty = 1;
 	return log;
 }
 
@@ -127,7 +190,9 @@ static void	delete_logfile (Logfile *log)
 	}
 
 	new_free(&log->name);
-	if (log->active)
+	if (log->segment)
+		close_log_segment(log);
+	else if (log->active)
 		do_log(0, log->filename, &log->log);
 	new_free(&log->filename);
 
@@ -141,6 +206,8 @@ static void	delete_logfile (Logfile *log)
 
 	new_free(&log->rewrite);
 	new_free(&log->mangle_desc);
+	new_free((char **)&log);
+	log_index_dirty = 1;
 }
 
 static Logfile *	get_log_by_desc (const char *desc)
@@ -190,6 +257,7 @@ static void	clean_log_targets (Logfile *log)
 		new_free((char **)&log->targets);
 		log->targets = next;
 	}
+	log_index_dirty = 1;
 }
 
 static char *logfile_get_targets (Logfile *log)
@@ -213,6 +281,262 @@ static char *logfile_get_targets (Logfile *log)
 	return nicks;
 }
 
+/************************************************************************/
+/*
+ * Rotating logs.  When a log has /LOG ROTATE set, it doesn't write to its
+ * filename, but to a series of segments named "<filename>.YYYYMMDD-HHMMSS".
+ * A new segment is started when the current one has more than rotate_size
+ * bytes or is older than rotate_time seconds.  When a segment is finished,
+ * a line goes into "<filename>.index" saying when it starts and ends, how
+ * many lines it has, which targets were logged to it, and its name:
+ *
+ *	<start> <end> <lines> <target,target,...|-> <segment filename>
+ *
+ * and then it is gzip'ed in the background (if gzip is in your PATH).
+ * $logctl(SEGMENTS) and $logctl(SEARCH) use the index to only look at the
+ * segments that could have what you want.  uzfopen() finds the segment
+ * whether it has been compressed yet or not, so /LOAD, $open() and
+ * $logctl(SEARCH) don't have to care.
+ */
+static char *	log_base_filename (Logfile *log, Filename base)
+{
+	if (normalize_filename(log->filename, base))
+		strlcpy(base, log->filename, sizeof(Filename));
+	return base;
+}
+
+static void	open_log_segment (Logfile *log)
+{
+	Filename	base;
+	Filename	compressed;
+	char		stamp[64];
+	struct stat	st;
+	int		i;
+
+	time(&log->segment_start);
+	strftime(stamp, sizeof stamp, "%Y%m%d-%H%M%S", 
+			localtime(&log->segment_start));
+	log_base_filename(log, base);
+
+	/* Don't clobber a segment from the same second */
+	malloc_sprintf(&log->segment, "%s.%s", base, stamp);
+	for (i = 1; ; i++)
+	{
+		snprintf(compressed, sizeof compressed, "%s.gz", log->segment);
+		if (stat(log->segment, &st) && stat(compressed, &st))
+			break;
+		malloc_sprintf(&log->segment, "%s.%s-%d", base, stamp, i);
+	}
+
+	log->segment_last = log->segment_start;
+	log->segment_bytes = log->segment_lines = 0;
+	new_free(&log->segment_targets);
+	do_log(1, log->segment, &log->log);
+}
+
+static void	compress_log_segment (const char *segment)
+{
+static	int		setup = 0;
+static	Filename	path_to_gzip;
+
+	if (!setup)
+	{
+		*path_to_gzip = 0;
+		path_search("gzip", getenv("PATH"), path_to_gzip);
+		setup = 1;
+	}
+
+	/* If there is no gzip, the segment just stays uncompressed */
+	if (!*path_to_gzip)
+		return;
+
+	/* The child gets reaped by get_child_exit() */
+	switch (fork())
+	{
+		case -1:
+			yell("Could not compress log segment %s: %s", 
+					segment, strerror(errno));
+			break;
+		case 0:
+			close(2);	/* we dont want to see errors */
+			setuid(getuid());
+			setgid(getgid());
+			execl(path_to_gzip, path_to_gzip, "-q", "-f", segment, NULL);
+			_exit(0);
+		default:
+			break;
+	}
+}
+
+static void	close_log_segment (Logfile *log)
+{
+	Filename	base;
+	char *		index;
+	FILE *		fp;
+
+	if (!log->segment)
+		return;
+
+	do_log(0, log->segment, &log->log);
+
+	index = malloc_sprintf(NULL, "%s.index", log_base_filename(log, base));
+	if ((fp = fopen(index, "a")))
+	{
+		fprintf(fp, "%ld %ld %ld %s %s\n", (long)log->segment_start,
+			(long)log->segment_last, log->segment_lines,
+			log->segment_targets ? log->segment_targets : "-",
+			log->segment);
+		fclose(fp);
+	}
+	else
+		yell("Could not add to log index %s: %s", index, strerror(errno));
+	new_free(&index);
+
+	compress_log_segment(log->segment);
+	new_free(&log->segment);
+	new_free(&log->segment_targets);
+}
+
+/* Is 'target' in the comma separated list 'list'? */
+static int	segment_has_target (const char *list, const char *target)
+{
+	size_t	len = strlen(target);
+
+	while (list && *list)
+	{
+		if (!my_strnicmp(list, target, len) && 
+				(list[len] == ',' || list[len] == 0))
+			return 1;
+		if ((list = strchr(list, ',')))
+			list++;
+	}
+	return 0;
+}
+
+/* Does any target in the list 'list' match the pattern 'target'? */
+static int	segment_matches_target (const char *list, const char *target)
+{
+	char *	copy, *t;
+
+	if (!target || !strcmp(target, "*"))
+		return 1;
+	if (!list || !strcmp(list, "-"))
+		return 0;
+
+	copy = LOCAL_COPY(list);
+	while ((t = next_in_comma_list(copy, &copy)) && *t)
+		if (wild_match(target, t))
+			return 1;
+	return 0;
+}
+
+/* Called before each line goes to a rotating log */
+static void	log_segment_line (Logfile *log, const char *target, const char *str)
+{
+	time_t	right_now;
+
+	time(&right_now);
+	if (log->segment && 
+	    ((log->rotate_size > 0 && log->segment_bytes >= log->rotate_size) ||
+	     (log->rotate_time > 0 && 
+			right_now - log->segment_start >= log->rotate_time)))
+	{
+		int	old_window_display = window_display;
+
+		/* 
+		 * Don't announce every rotation -- that output would
+		 * come right back here while we're in the middle of it.
+		 */
+		window_display = 0;
+		close_log_segment(log);
+		open_log_segment(log);
+		window_display = old_window_display;
+	}
+
+	log->segment_last = right_now;
+	log->segment_lines++;
+	log->segment_bytes += strlen(str) + 1;
+	if (target && !segment_has_target(log->segment_targets, target))
+		malloc_strcat_wordlist(&log->segment_targets, ",", target);
+}
+
+/*
+ * Call 'func' for each segment of 'log' that could have lines logged 
+ * between 'from' and 'to' (0 means no limit) to targets matching 'target'.
+ * Includes the segment being written now.
+ */
+static void	log_segments (Logfile *log, time_t from, time_t to, const char *target, void (*func) (Logfile *, const char *, void *), void *data)
+{
+	Filename	base;
+	char *		index;
+	FILE *		fp;
+	char		buffer[BIG_BUFFER_SIZE * 2 + 1];
+	long		start, end, nlines;
+	char		targets[BIG_BUFFER_SIZE * 2 + 1];
+	int		offset;
+
+	index = malloc_sprintf(NULL, "%s.index", log_base_filename(log, base));
+	if ((fp = fopen(index, "r")))
+	{
+	    while (fgets(buffer, sizeof buffer, fp))
+	    {
+		chomp(buffer);
+		if (sscanf(buffer, "%ld %ld %ld %s %n", &start, &end, &nlines,
+				targets, &offset) < 4)
+			continue;
+		if ((to && start > to) || (from && end < from))
+			continue;
+		if (!segment_matches_target(targets, target))
+			continue;
+		func(log, buffer + offset, data);
+	    }
+	    fclose(fp);
+	}
+	new_free(&index);
+
+	if (log->segment && (!to || log->segment_start <= to) &&
+	    segment_matches_target(log->segment_targets, target))
+	{
+		flush_log_file(log->log);
+		func(log, log->segment, data);
+	}
+}
+
+static void	list_segment (Logfile *log, const char *segment, void *data)
+{
+	malloc_strcat_word((char **)data, space, segment, DWORD_YES);
+}
+
+struct segment_search {
+	const char *	pattern;
+	char *		results;
+};
+
+static void	search_segment (Logfile *log, const char *segment, void *data)
+{
+	struct segment_search *	search = (struct segment_search *)data;
+	struct epic_loadfile *	elf;
+	struct stat		sb;
+	char *			filename = NULL;
+	char			buffer[BIG_BUFFER_SIZE * 2 + 1];
+
+	malloc_strcpy(&filename, segment);
+	if (!(elf = uzfopen(&filename, ".", 0, &sb)))
+		return;
+
+	while (epic_fgets(buffer, sizeof buffer, elf))
+	{
+		chomp(buffer);
+		if (!strncmp(buffer, "IRC log ", 8))
+			continue;
+		if (wild_match(search->pattern, buffer))
+			malloc_strcat_word(&search->results, space, buffer, 
+						DWORD_YES);
+	}
+	epic_fclose(elf);
+	new_free(&filename);
+}
+
 /************************************************************************/
 typedef Logfile *(*logfile_func) (Logfile *, char **);
 
@@ -230,6 +554,7 @@ static Logfile *logfile_on (Logfile *log, char **args);
 static Logfile *logfile_refnum (Logfile *log, char **args);
 static Logfile *logfile_remove (Logfile *log, char **args);
 static Logfile *logfile_rewrite (Logfile *log, char **args);
+static Logfile *logfile_rotate (Logfile *log, char **args);
 static Logfile *logfile_type (Logfile *log, char **args);
 
 static Logfile *	logfile_activity (Logfile *log, char **args)
@@ -294,21 +619,25 @@ static Logfile *	logfile_add (Logfile *log, char **args)
 				break;
 			}
 		    }
-		    for (i = 0; i < MAX_TARGETS; i++)
+		    if (i >= MAX_TARGETS)
 		    {
+		      for (i = 0; i < MAX_TARGETS; i++)
+		      {
 			if (log->refnums[i] == -1)
 			{
 				say("Added %d to log name list", refnum);
 				log->refnums[i] = refnum;
 				break;
 			}
-		    }
-		    if (i >= MAX_TARGETS)
+		      }
+		      if (i >= MAX_TARGETS)
 			say("Could not add %d to log name list!", refnum);
+		    }
 		}
                 arg = ptr;
         }
 
+	log_index_dirty = 1;
         return log;
 }
 
@@ -336,6 +665,10 @@ static Logfile *	logfile_describe (Logfile *log, char **args)
 	say("\t        Level: %s", mask_to_str(&log->mask));
 	say("\t Rewrite Rule: %s", log->rewrite ? log->rewrite : "<NONE>");
 	say("\t Mangle rules: %s", log->mangle_desc ? log->mangle_desc : "<NONE>");
+	if (log->rotate_size || log->rotate_time)
+		say("\t     Rotation: every %ld bytes, %ld seconds, now %s",
+			log->rotate_size, log->rotate_time, 
+			log->segment ? log->segment : "<NONE>");
 
 	new_free(&targets);
 	return log;
@@ -491,7 +824,10 @@ static Logfile *	logfile_off (Logfile *log, char **args)
 	}
 
 	time(&log->activity);
-	do_log(0, log->filename, &log->log);
+	if (log->segment)
+		close_log_segment(log);
+	else
+		do_log(0, log->filename, &log->log);
 	log->active = 0;
 	return log;
 }
@@ -511,7 +847,13 @@ static Logfile *	logfile_on (Logfile *log, char **args)
 	}
 
 	time(&log->activity);
-	do_log(1, log->filename, &log->log);
+	if (log->rotate_size || log->rotate_time)
+	{
+		if (!log->segment)
+			open_log_segment(log);
+	}
+	else
+		do_log(1, log->filename, &log->log);
 	log->active = 1;
 	return log;
 }
@@ -558,7 +900,12 @@ static Logfile *	logfile_remove (Logfile *log, char **args)
 		}
 		else if (log->type == LOG_SERVERS || log->type == LOG_WINDOWS)
 		{
-		    int refnum = my_atol(ptr);
+		    int refnum;
+
+		    if (log->type == LOG_SERVERS && !my_strnicmp("ALL", arg, 1))
+			refnum = NOSERV;
+		    else
+			refnum = my_atol(arg);
 
 		    for (i = 0; i < MAX_TARGETS; i++)
 		    {
@@ -576,6 +923,7 @@ static Logfile *	logfile_remove (Logfile *log, char **args)
 		arg = ptr;
         }
 
+	log_index_dirty = 1;
         return log;
 }
 
@@ -593,6 +941,58 @@ static Logfile *	logfile_rewrite (Logfile *log, char **args)
 	return log;
 }
 
+/*
+ * /LOG ROTATE <bytes> [<seconds>]
+ * /LOG ROTATE OFF
+ */
+static Logfile *	logfile_rotate (Logfile *log, char **args)
+{
+	char *	arg = next_arg(*args, args);
+	long	size = 0, seconds = 0;
+	int	was_active;
+
+	if (!log)
+	{
+		say("ROTATE: You need to specify a logfile first");
+		return NULL;
+	}
+
+	if (!arg)
+	{
+		if (log->rotate_size || log->rotate_time)
+			say("Log %s starts a new segment every %ld bytes or "
+				"%ld seconds", log->name, 
+				log->rotate_size, log->rotate_time);
+		else
+			say("Log %s does not rotate", log->name);
+		return log;
+	}
+
+	if (my_stricmp(arg, "OFF"))
+	{
+		size = my_atol(arg);
+
+		/* The seconds are optional; don't eat the next option */
+		while (*args && **args == ' ')
+			(*args)++;
+		if (*args && isdigit(**args))
+			seconds = my_atol(next_arg(*args, args));
+		if (size < 0 || seconds < 0)
+		{
+			say("ROTATE: Sizes and times can't be negative");
+			return log;
+		}
+	}
+
+	if ((was_active = log->active))
+		logfile_off(log, NULL);
+	log->rotate_size = size;
+	log->rotate_time = seconds;
+	if (was_active)
+		logfile_on(log, NULL);
+	return log;
+}
+
 static Logfile *	logfile_server (Logfile *log, char **args)
 {
         char *arg = new_next_arg(*args, args);
@@ -657,6 +1057,7 @@ static const logfile_ops options [] = {
 	{ "REFNUM",	logfile_refnum		},
 	{ "REMOVE",	logfile_remove		},
 	{ "REWRITE",	logfile_rewrite		},
+	{ "ROTATE",	logfile_rotate		},
 	{ "SERVER",	logfile_server		},
 	{ "TYPE",	logfile_type		},
 	{ NULL,		NULL			}
@@ -704,57 +1105,175 @@ BUILT_IN_COMMAND(logcmd)
 }
 
 /****************************************************************************/
-void	add_to_logs (long winref, int servref, const char *target, int level, const char *orig_str)
+static void	add_route (LogRoute *r, Logfile *log)
 {
-	Logfile *log;
-	int	i;
+	RESIZE(r->logs, Logfile *, r->count + 1);
+	r->logs[r->count++] = log;
+}
+
+static void	add_route_by_name (LogRouteList *list, const char *name, Logfile *log)
+{
+	LogRoute *r;
+	int	cnt, loc;
+
+	r = (LogRoute *)find_array_item((array *)list, name, &cnt, &loc);
+	if (!r || cnt >= 0)
+	{
+		r = (LogRoute *)new_malloc(sizeof(LogRoute));
+		r->name = malloc_strdup(name);
+		r->logs = NULL;
+		r->count = 0;
+		add_to_array((array *)list, (array_item *)r);
+	}
+	add_route(r, log);
+}
+
+static LogRoute *	find_route (LogRouteList *list, const char *name)
+{
+	LogRoute *r;
+	int	cnt, loc;
+
+	r = (LogRoute *)find_array_item((array *)list, name, &cnt, &loc);
+	if (!r || cnt >= 0)
+		return NULL;
+	return r;
+}
+
+static void	clear_routes (LogRouteList *list)
+{
+	LogRoute *r;
+
+	while (list->max > 0)
+	{
+		r = (LogRoute *)array_pop((array *)list, list->max - 1);
+		new_free(&r->name);
+		new_free((char **)&r->logs);
+		new_free((char **)&r);
+	}
+}
+
+static void	build_log_index (void)
+{
+	Logfile *	log;
+	WNickList *	tmp;
+	WildRoute *	w;
+	int		i;
+
+	clear_routes(&by_window);
+	clear_routes(&by_server);
+	clear_routes(&by_target);
+	new_free((char **)&all_servers.logs);
+	all_servers.count = 0;
+	new_free((char **)&untargeted.logs);
+	untargeted.count = 0;
+	while ((w = wild_targets))
+	{
+		wild_targets = w->next;
+		new_free((char **)&w);
+	}
 
 	for (log = logfiles; log; log = log->next)
 	{
 	    if (log->type == LOG_WINDOWS)
 	    {
-		for (i = 0; i < MAX_TARGETS; i++) {
-		    if (log->refnums[i] == winref) {
-			if (!mask_isset(&log->mask, level))
-				continue;
-			time(&log->activity);
-			add_to_log(log->refnum, log->log, winref, orig_str, log->mangler, log->rewrite);
-		    }
+		for (i = 0; i < MAX_TARGETS; i++)
+		    if (log->refnums[i] != -1)
+			add_route_by_name(&by_window, ltoa(log->refnums[i]), log);
+	    }
+	    else if (log->type == LOG_SERVERS)
+	    {
+		for (i = 0; i < MAX_TARGETS; i++)
+		{
+		    if (log->refnums[i] == NOSERV)
+			add_route(&all_servers, log);
+		    else if (log->refnums[i] != -1)
+			add_route_by_name(&by_server, ltoa(log->refnums[i]), log);
 		}
 	    }
-
-	    if (log->type == LOG_SERVERS)
+	    else if (log->type == LOG_TARGETS)
 	    {
-		for (i = 0; i < MAX_TARGETS; i++) {
-		    if (log->refnums[i] == NOSERV ||
-			log->refnums[i] == servref) 
+		if (!log->targets)
+		    add_route(&untargeted, log);
+
+		for (tmp = log->targets; tmp; tmp = tmp->next)
+		{
+		    if (strpbrk(tmp->nick, "*%?\\"))
 		    {
-			if (!mask_isset(&log->mask, level))
-				continue;
-			time(&log->activity);
-			add_to_log(log->refnum, log->log, winref, orig_str, log->mangler, log->rewrite);
+			w = (WildRoute *)new_malloc(sizeof(WildRoute));
+			w->log = log;
+			w->pattern = tmp->nick;
+			w->next = wild_targets;
+			wild_targets = w;
 		    }
+		    else
+			add_route_by_name(&by_target, tmp->nick, log);
 		}
 	    }
+	}
 
-	    else if (log->type == LOG_TARGETS)
-	    {
-		if (log->servref != NOSERV && (log->servref != servref))
-			continue;
+	log_index_dirty = 0;
+}
 
-		if (!mask_isset(&log->mask, level))
-			continue;
+static void	log_to (Logfile *log, long winref, int servref, const char *target, int level, const char *orig_str)
+{
+	/* Each log only gets each line once */
+	if (log->last_line == log_line)
+		return;
+	if (log->type == LOG_TARGETS && log->servref != NOSERV && 
+			log->servref != servref)
+		return;
+	if (!mask_isset(&log->mask, level))
+		return;
+
+	log->last_line = log_line;
+	time(&log->activity);
+	if (log->segment)
+		log_segment_line(log, target, orig_str);
+	add_to_log(log->refnum, log->log, winref, orig_str, log->mangler, log->rewrite);
+}
 
-		if (log->targets && !target)
-			continue;
+static void	log_to_route (LogRoute *r, long winref, int servref, const char *target, int level, const char *orig_str)
+{
+	int	i;
 
-		if (target && !find_in_list((List **)&log->targets, target, USE_WILDCARDS))
-			continue;
+	if (!r)
+		return;
+	for (i = 0; i < r->count; i++)
+		log_to(r->logs[i], winref, servref, target, level, orig_str);
+}
 
-		/* OK!  We want to log it now! */
-		time(&log->activity);
-		add_to_log(log->refnum, log->log, winref, orig_str, log->mangler, log->rewrite);
-	    }
+void	add_to_logs (long winref, int servref, const char *target, int level, const char *orig_str)
+{
+	WildRoute *w;
+
+	if (!logfiles)
+		return;
+	if (log_index_dirty)
+		build_log_index();
+
+	log_line++;
+	if (by_window.max)
+		log_to_route(find_route(&by_window, ltoa(winref)), 
+				winref, servref, target, level, orig_str);
+	if (by_server.max)
+		log_to_route(find_route(&by_server, ltoa(servref)), 
+				winref, servref, target, level, orig_str);
+	log_to_route(&all_servers, winref, servref, target, level, orig_str);
+
+	if (!target)
+		log_to_route(&untargeted, winref, servref, target, level, orig_str);
+	else
+	{
+		if (by_target.max)
+			log_to_route(find_route(&by_target, target), 
+				winref, servref, target, level, orig_str);
+		for (w = wild_targets; w; w = w->next)
+		{
+			if (w->log->last_line == log_line)
+				continue;
+			if (wild_match(w->pattern, target))
+				log_to(w->log, winref, servref, target, level, orig_str);
+		}
 	}
 }
 
@@ -769,6 +1288,12 @@ void	add_to_logs (long winref, int servref, const char *target, int level, const
  * $logctl(SET <refnum> [ITEM] [VALUE])
  * $logctl(MATCH [pattern])
  * $logctl(PMATCH [pattern])
+ * $logctl(SEGMENTS log-desc <from> <to> [target])
+ *	The segments of a rotating log that could have lines logged between
+ *	<from> and <to> ($time() values, 0 for no limit) to [target].
+ * $logctl(SEARCH log-desc <from> <to> <target> <pattern>)
+ *	The lines in those segments that match <pattern>.  Use * for any 
+ *	target.  Each line is one (double quoted) word.
  *
  * [LIST] and [ITEM] are one of the following
  *	REFNUM		The refnum for the log (GET only)
@@ -781,6 +1306,12 @@ void	add_to_logs (long winref, int servref, const char *target, int level, const
  *	MANGLE		The mangle rule for this log
  *	STATUS		1 if log is on, 0 if log is off.
  *	TYPE		Either "TARGET", "WINDOW", or "SERVER"
+ *	LINES		Lines logged since the log was turned on (GET only)
+ *	BYTES		Bytes logged since the log was turned on (GET only)
+ *	FLUSHES		How many writes that took (GET only)
+ *	PENDING		Bytes waiting to be written (GET only)
+ *	ROTATE		"<bytes> <seconds>" for a rotating log, or empty
+ *	SEGMENT		The segment a rotating log is writing to (GET only)
  */
 char *logctl	(char *input)
 {
@@ -828,13 +1359,47 @@ char *logctl	(char *input)
 			RETURN_EMPTY;
 		logfile_remove(log, &input);
 		RETURN_INT(1);
+        } else if (!my_strnicmp(listc, "SEGMENTS", 3)) {
+		char *	retval = NULL;
+		long	from, to;
+
+		GET_FUNC_ARG(refstr, input);
+		if (!(log = get_log_by_desc(refstr)))
+			RETURN_EMPTY;
+		GET_INT_ARG(from, input);
+		GET_INT_ARG(to, input);
+		log_segments(log, from, to, *input ? input : NULL, 
+				list_segment, &retval);
+		RETURN_MSTR(retval);
+        } else if (!my_strnicmp(listc, "SEARCH", 3)) {
+		struct segment_search search;
+		char *	target;
+		long	from, to;
+
+		GET_FUNC_ARG(refstr, input);
+		if (!(log = get_log_by_desc(refstr)))
+			RETURN_EMPTY;
+		GET_INT_ARG(from, input);
+		GET_INT_ARG(to, input);
+		GET_FUNC_ARG(target, input);
+		search.pattern = input;
+		search.results = NULL;
+		log_segments(log, from, to, target, search_segment, &search);
+		RETURN_MSTR(search.results);
         } else if (!my_strnicmp(listc, "GET", 2)) {
                 GET_FUNC_ARG(refstr, input);
 		if (!(log = get_log_by_desc(refstr)))
 			RETURN_EMPTY;
 
                 GET_FUNC_ARG(listc, input);
-                if (!my_strnicmp(listc, "REFNUM", 1)) {
+		if (!my_strnicmp(listc, "ROTATE", 2)) {
+			if (!log->rotate_size && !log->rotate_time)
+				RETURN_EMPTY;
+			return malloc_sprintf(NULL, "%ld %ld", 
+					log->rotate_size, log->rotate_time);
+		} else if (!my_strnicmp(listc, "SEGMENT", 3)) {
+			RETURN_STR(log->segment);
+                } else if (!my_strnicmp(listc, "REFNUM", 1)) {
 			RETURN_INT(log->refnum);
                 } else if (!my_strnicmp(listc, "NAME", 3)) {
 			RETURN_STR(log->name);
@@ -858,6 +1423,30 @@ char *logctl	(char *input)
 			RETURN_STR(logtype[log->type]);
 		} else if (!my_strnicmp(listc, "ACTIVITY", 1)) {
 			RETURN_INT(log->activity);
+		} else if (!my_strnicmp(listc, "LINES", 2)) {
+			unsigned long	nlines, nbytes, nflushes;
+			size_t		pending;
+
+			get_log_stats(log->log, &nlines, &nbytes, &nflushes, &pending);
+			RETURN_INT(nlines);
+		} else if (!my_strnicmp(listc, "BYTES", 1)) {
+			unsigned long	nlines, nbytes, nflushes;
+			size_t		pending;
+
+			get_log_stats(log->log, &nlines, &nbytes, &nflushes, &pending);
+			RETURN_INT(nbytes);
+		} else if (!my_strnicmp(listc, "FLUSHES", 2)) {
+			unsigned long	nlines, nbytes, nflushes;
+			size_t		pending;
+
+			get_log_stats(log->log, &nlines, &nbytes, &nflushes, &pending);
+			RETURN_INT(nflushes);
+		} else if (!my_strnicmp(listc, "PENDING", 1)) {
+			unsigned long	nlines, nbytes, nflushes;
+			size_t		pending;
+
+			get_log_stats(log->log, &nlines, &nbytes, &nflushes, &pending);
+			RETURN_INT(pending);
 		}
         } else if (!my_strnicmp(listc, "SET", 1)) {
                 GET_FUNC_ARG(refstr, input);
@@ -900,6 +1489,9 @@ char *logctl	(char *input)
                 } else if (!my_strnicmp(listc, "ACTIVITY", 1)) {
 			logfile_activity(log, &input);
 			RETURN_INT(1);
+                } else if (!my_strnicmp(listc, "ROTATE", 2)) {
+			logfile_rotate(log, &input);
+			RETURN_INT(1);
 		}
         } else if (!my_strnicmp(listc, "MATCH", 1)) {
                 RETURN_EMPTY;           /* Not implemented for now. */
@@ -935,5 +1527,18 @@ void    logfiles_swap_winrefs (int oldref, int newref)
 				log->refnums[i] = newref;
 		}
         }
+	log_index_dirty = 1;
 }
 
+/*
+ * At exit, finish each rotating log's current segment so it goes in the
+ * index (and gets compressed) like all the others.
+ */
+void	close_log_segments (void)
+{
+	Logfile *log;
+
+	for (log = logfiles; log; log = log->next)
+		if (log->segment)
+			close_log_segment(log);
+}
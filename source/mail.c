@@ -608,7 +608,7 @@ void	mail_systimer (void)
 			panic(1, "mail_systimer called with set mail %d", x);
 	}
 
-	update_all_status();
+	update_all_status_for(STATUS_DEP_MAIL);
 	return;
 }
 
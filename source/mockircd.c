@@ -0,0 +1,823 @@
+/* $EPIC: mockircd.c,v 1.1 2026/10/19 00:00:00 jnelson Exp $ */
+/*
+ * mockircd.c -- A pretend irc server that keeps the client busy.
+ *
+ * Copyright 2026 EPIC Software Labs
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notices, the above paragraph (the one permitting redistribution),
+ *    this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The names of the author(s) may not be used to endorse or promote
+ *    products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/*
+ * mockircd is for load testing the client without bothering a real irc
+ * network.  It listens on a port, lets clients register, puts them on a
+ * bunch of busy channels, and then makes up traffic for them at whatever
+ * rate you ask for:
+ *
+ *	privmsg	Somebody says something to a channel (or to you)
+ *	join	Somebody leaves a channel and comes right back
+ *	quit	Somebody quits, or comes back after quitting
+ *	nick	Somebody changes their nick
+ *	split	A quarter of everybody splits off, or comes back
+ *	dcc	Somebody offers you a file (that you can't get)
+ *	names	You get a channel's NAMES list again
+ *
+ * It answers what the client asks after it joins a channel (MODE, WHO)
+ * and PINGs, and otherwise ignores it.  Every client that connects gets 
+ * its own people and its own traffic, which is the same every time for
+ * the same options.
+ *
+ * Usage: mockircd [-1] [-p port] [-c channels] [-u users] [-r lines/sec]
+ *		   [-n lines] [-m kind=weight,...]
+ *	-1	Exit after the first client leaves
+ *	-p	The port to listen on, on 127.0.0.1 (default 6667)
+ *	-c	How many channels each client is put on (default 20)
+ *	-u	How many people are on each channel (default 100)
+ *	-r	Lines per second (default 1000, 0 is as fast as the client
+ *		can take them)
+ *	-n	Hang up after this many lines (default 0, never)
+ *	-m	How often each kind of traffic happens, as weights (default
+ *		privmsg=70,join=10,quit=5,nick=5,split=1,dcc=1,names=1)
+ *
+ * The client's own counters ($profilectl(), "epic5 -R") tell you where 
+ * the time went.
+ */
+
+#define MOCKIRCD_C
+
+#include "defs.h"
+#include "config.h"
+#include "irc_std.h"
+
+#define SERVER_NAME	"mock.irc"
+#define MAX_OUTPUT	65536		/* Don't get further ahead than this */
+#define LINE_LEN	512
+
+enum Kind { PRIVMSG, JOIN, QUIT, NICK, SPLIT, DCC, NAMES, NUMBER_OF_KINDS };
+
+static	const char *	kind_names[NUMBER_OF_KINDS] = {
+	"privmsg", "join", "quit", "nick", "split", "dcc", "names"
+};
+static	int	weights[NUMBER_OF_KINDS] = { 70, 10, 5, 5, 1, 1, 1 };
+
+static	const char *	chatter[] = {
+	"hello there",
+	"anybody around?",
+	"brb",
+	"that's what i was saying about the parser, it allocates way too much",
+	"lol",
+	"has anyone tried the new release yet",
+	"no",
+	"http://www.example.com/some/long/path?with=arguments&and=more",
+	"ok, see you all tomorrow",
+	":)"
+};
+#define NUMBER_OF_CHATTER	(sizeof(chatter) / sizeof(chatter[0]))
+
+static	int	channels = 20;
+static	int	users = 100;
+static	double	rate = 1000;
+static	long	max_lines = 0;
+static	int	just_once = 0;
+
+typedef struct {
+	char	nick[32];
+	int	gone;			/* 1 = Quit, 2 = Split */
+} Person;
+
+typedef struct ClientStru {
+	struct ClientStru *next;
+	int		fd;
+	int		registered;
+	int		got_user;
+	int		capping;	/* Holding off for CAP END */
+	int		closing;	/* Close after the output is sent */
+	char		nick[32];
+	char		inbuf[4096];
+	size_t		inlen;
+	char *		outbuf;
+	size_t		outlen;
+	size_t		outsize;
+	long		sent;
+	double		credit;
+	struct timeval	last;
+	struct timeval	started;
+	long		seed;
+	Person *	people;
+	int		npeople;
+	int		renames;
+	int		split;		/* A split is going on */
+} Client;
+
+static	Client *	clients = NULL;
+
+static	void	usage (void);
+static	void	send_line (Client *, const char *, ...);
+static	void	drop_client (Client *);
+
+static double	time_since (struct timeval *then)
+{
+	struct timeval	now;
+
+	gettimeofday(&now, NULL);
+	return (now.tv_sec - then->tv_sec) + 
+		(now.tv_usec - then->tv_usec) / 1000000.0;
+}
+
+/* Park-Miller (with Schrage's trick), so it's the same everywhere */
+static int	rnd (Client *c, int n)
+{
+	long	hi, lo;
+
+	hi = c->seed / 127773;
+	lo = c->seed % 127773;
+	if ((c->seed = 16807 * lo - 2836 * hi) <= 0)
+		c->seed += 2147483647;
+	return (int)(c->seed % n);
+}
+
+/*
+ * Channel 'chan' has 'users' people on it, starting at person 
+ * (chan * users / 2), so everybody is on a few channels.
+ */
+static int	member (Client *c, int chan, int i)
+{
+	return (chan * (users / 2 + 1) + i) % c->npeople;
+}
+
+static int	is_member (Client *c, int person, int chan)
+{
+	int	first = member(c, chan, 0);
+
+	return (person - first + c->npeople) % c->npeople < users;
+}
+
+static const char *	uh (Client *c, int person)
+{
+	static	char	buffers[2][LINE_LEN];
+	static	int	which = 0;
+	char *	buffer = buffers[which ^= 1];
+
+	snprintf(buffer, LINE_LEN, "%s!~user%d@host%d.example.com",
+			c->people[person].nick, person, person % 37);
+	return buffer;
+}
+
+static int	present (Client *c, int person)
+{
+	return c->people[person].gone == 0;
+}
+
+/**************************************************************************/
+static void	send_names (Client *c, int chan)
+{
+	char	line[LINE_LEN];
+	size_t	len, start;
+	int	i, p;
+
+	start = snprintf(line, sizeof line, "%s 353 %s = #chan%d :", 
+				SERVER_NAME, c->nick, chan);
+	len = start + snprintf(line + start, sizeof line - start, "@%s", 
+				c->nick);
+	for (i = 0; i < users; i++)
+	{
+		p = member(c, chan, i);
+		if (!present(c, p))
+			continue;
+
+		if (len > 400)
+		{
+			send_line(c, ":%s", line);
+			len = start = snprintf(line, sizeof line, 
+					"%s 353 %s = #chan%d :", 
+					SERVER_NAME, c->nick, chan);
+		}
+		len += snprintf(line + len, sizeof line - len, "%s%s%s",
+			len == start ? "" : " ",
+			i % 10 == 0 ? "@" : (i % 10 == 5 ? "+" : ""),
+			c->people[p].nick);
+	}
+	send_line(c, ":%s", line);
+	send_line(c, ":%s 366 %s #chan%d :End of /NAMES list.", 
+				SERVER_NAME, c->nick, chan);
+}
+
+static void	send_who (Client *c, const char *target)
+{
+	int	chan, i, p;
+
+	if (sscanf(target, "#chan%d", &chan) == 1 && chan >= 0 && 
+							chan < channels)
+	{
+		send_line(c, ":%s 352 %s #chan%d ~user localhost %s %s H@ "
+				":0 You", SERVER_NAME, c->nick, chan, 
+				SERVER_NAME, c->nick);
+		for (i = 0; i < users; i++)
+		{
+			p = member(c, chan, i);
+			if (!present(c, p))
+				continue;
+			send_line(c, ":%s 352 %s #chan%d ~user%d "
+				"host%d.example.com %s %s %s%s :0 Person %d",
+				SERVER_NAME, c->nick, chan, p, p % 37, 
+				SERVER_NAME, c->people[p].nick, 
+				p % 7 ? "H" : "G", 
+				i % 10 == 0 ? "@" : (i % 10 == 5 ? "+" : ""), 
+				p);
+		}
+	}
+	send_line(c, ":%s 315 %s %s :End of /WHO list.", 
+				SERVER_NAME, c->nick, target);
+}
+
+static void	welcome (Client *c)
+{
+	int	chan;
+
+	send_line(c, ":%s 001 %s :Welcome to the Mock IRC Network %s", 
+				SERVER_NAME, c->nick, c->nick);
+	send_line(c, ":%s 002 %s :Your host is %s, running version mock-1",
+				SERVER_NAME, c->nick, SERVER_NAME);
+	send_line(c, ":%s 003 %s :This server was created just now",
+				SERVER_NAME, c->nick);
+	send_line(c, ":%s 004 %s %s mock-1 iosw biklmnopstv",
+				SERVER_NAME, c->nick, SERVER_NAME);
+	send_line(c, ":%s 005 %s CHANTYPES=# PREFIX=(ov)@+ "
+			"CHANMODES=b,k,l,imnpst NICKLEN=30 NETWORK=Mock "
+			":are supported by this server", SERVER_NAME, c->nick);
+	send_line(c, ":%s 251 %s :There are %d users and 0 services on "
+			"1 servers", SERVER_NAME, c->nick, c->npeople + 1);
+	send_line(c, ":%s 375 %s :- %s Message of the Day -", 
+				SERVER_NAME, c->nick, SERVER_NAME);
+	send_line(c, ":%s 372 %s :- This server isn't real.", 
+				SERVER_NAME, c->nick);
+	send_line(c, ":%s 376 %s :End of /MOTD command.", 
+				SERVER_NAME, c->nick);
+
+	for (chan = 0; chan < channels; chan++)
+	{
+		send_line(c, ":%s!~user@localhost JOIN :#chan%d", 
+				c->nick, chan);
+		send_names(c, chan);
+	}
+	c->registered = 1;
+	gettimeofday(&c->last, NULL);
+}
+
+/**************************************************************************/
+static void	come_back (Client *c, int person)
+{
+	int	chan;
+
+	c->people[person].gone = 0;
+	for (chan = 0; chan < channels; chan++)
+		if (is_member(c, person, chan))
+			send_line(c, ":%s JOIN :#chan%d", uh(c, person), chan);
+}
+
+static void	netsplit (Client *c)
+{
+	int	p, chan;
+
+	if (!c->split)
+	{
+		for (p = 0; p < c->npeople; p += 4)
+		{
+			if (!present(c, p))
+				continue;
+			c->people[p].gone = 2;
+			send_line(c, ":%s QUIT :%s leaf.%s", uh(c, p), 
+					SERVER_NAME, SERVER_NAME);
+		}
+		c->split = 1;
+		return;
+	}
+
+	for (p = 0; p < c->npeople; p++)
+	{
+		if (c->people[p].gone != 2)
+			continue;
+		come_back(c, p);
+		for (chan = 0; chan < channels; chan++)
+			if (p % 40 == 0 && is_member(c, p, chan))
+				send_line(c, ":leaf.%s MODE #chan%d +o %s",
+					SERVER_NAME, chan, c->people[p].nick);
+	}
+	c->split = 0;
+}
+
+static void	make_traffic (Client *c)
+{
+	int	total = 0, pick, kind;
+	int	chan, p;
+	const char *said;
+
+	for (kind = 0; kind < NUMBER_OF_KINDS; kind++)
+		total += weights[kind];
+	if (total <= 0)
+		return;
+
+	pick = rnd(c, total);
+	for (kind = 0; kind < NUMBER_OF_KINDS; kind++)
+		if ((pick -= weights[kind]) < 0)
+			break;
+
+	chan = rnd(c, channels);
+	p = member(c, chan, rnd(c, users));
+	said = chatter[rnd(c, NUMBER_OF_CHATTER)];
+
+	/* People who quit come back when they have something to say */
+	if (c->people[p].gone == 1 && kind != SPLIT && kind != NAMES)
+	{
+		come_back(c, p);
+		return;
+	}
+	if (!present(c, p) && kind != SPLIT && kind != NAMES)
+		return;				/* Split off, try again */
+
+	switch (kind)
+	{
+	    case PRIVMSG:
+		switch (rnd(c, 10))
+		{
+		    case 0:
+			send_line(c, ":%s PRIVMSG %s :%s", uh(c, p), 
+					c->nick, said);
+			break;
+		    case 1:
+			send_line(c, ":%s PRIVMSG #chan%d :\001ACTION %s\001",
+					uh(c, p), chan, said);
+			break;
+		    case 2:
+			send_line(c, ":%s NOTICE #chan%d :%s", 
+					uh(c, p), chan, said);
+			break;
+		    default:
+			send_line(c, ":%s PRIVMSG #chan%d :%s", 
+					uh(c, p), chan, said);
+		}
+		break;
+
+	    case JOIN:
+		send_line(c, ":%s PART #chan%d :bye", uh(c, p), chan);
+		send_line(c, ":%s JOIN :#chan%d", uh(c, p), chan);
+		break;
+
+	    case QUIT:
+		c->people[p].gone = 1;
+		send_line(c, ":%s QUIT :Quit: %s", uh(c, p), said);
+		break;
+
+	    case NICK:
+	    {
+		char	old[LINE_LEN];
+
+		snprintf(old, sizeof old, "%s", uh(c, p));
+		snprintf(c->people[p].nick, sizeof c->people[p].nick, 
+				"nick%d_%d", p, ++c->renames);
+		send_line(c, ":%s NICK :%s", old, c->people[p].nick);
+		break;
+	    }
+
+	    case SPLIT:
+		netsplit(c);
+		break;
+
+	    case DCC:
+		send_line(c, ":%s PRIVMSG %s :\001DCC SEND file%d.txt "
+				"2130706433 1 %d\001", uh(c, p), c->nick, 
+				rnd(c, 1000), rnd(c, 1000000) + 1);
+		break;
+
+	    case NAMES:
+		send_names(c, chan);
+		break;
+	}
+}
+
+/* Make as much traffic as the rate allows */
+static void	pump (Client *c)
+{
+	long	before;
+	double	elapsed;
+
+	if (!c->registered || c->closing)
+		return;
+
+	elapsed = time_since(&c->last);
+	gettimeofday(&c->last, NULL);
+	c->credit += elapsed * rate;
+	if (c->credit > rate)
+		c->credit = rate;		/* At most a second's worth */
+
+	while ((rate <= 0 || c->credit >= 1) && c->outlen < MAX_OUTPUT)
+	{
+		if (max_lines && c->sent >= max_lines)
+		{
+			send_line(c, "ERROR :Closing Link: That's all, folks");
+			c->closing = 1;
+			break;
+		}
+
+		before = c->sent;
+		make_traffic(c);
+		c->credit -= c->sent - before;
+	}
+}
+
+/**************************************************************************/
+static void	send_line (Client *c, const char *format, ...)
+{
+	char	line[LINE_LEN];
+	va_list	args;
+	size_t	len;
+
+	va_start(args, format);
+	vsnprintf(line, sizeof line - 2, format, args);
+	va_end(args);
+	len = strlen(line);
+	line[len++] = '\r';
+	line[len++] = '\n';
+
+	if (c->outlen + len > c->outsize)
+	{
+		c->outsize = (c->outlen + len) * 2;
+		if (!(c->outbuf = realloc(c->outbuf, c->outsize)))
+		{
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+	}
+	memcpy(c->outbuf + c->outlen, line, len);
+	c->outlen += len;
+	c->sent++;
+}
+
+/* Registration is done when we have NICK and USER and CAP is done */
+static void	maybe_register (Client *c)
+{
+	if (!c->registered && *c->nick && c->got_user && !c->capping)
+		welcome(c);
+}
+
+static void	handle_line (Client *c, char *line)
+{
+	char *	command;
+	char *	arg;
+	char *	target;
+
+	if (*line == ':')			/* Prefixes are ignored */
+		strsep(&line, " ");
+	if (!line || !(command = strsep(&line, " ")))
+		return;
+	arg = line ? line : "";
+
+	if (!strcasecmp(command, "NICK"))
+	{
+		if (*arg == ':')
+			arg++;
+		if (c->registered)
+			send_line(c, ":%s!~user@localhost NICK :%s", 
+					c->nick, arg);
+		snprintf(c->nick, sizeof c->nick, "%s", arg);
+		maybe_register(c);
+	}
+	else if (!strcasecmp(command, "USER"))
+	{
+		c->got_user = 1;
+		maybe_register(c);
+	}
+	else if (!strcasecmp(command, "CAP"))
+	{
+		if (!strncasecmp(arg, "LS", 2))
+		{
+			if (!c->registered)
+				c->capping = 1;
+			send_line(c, ":%s CAP * LS :", SERVER_NAME);
+		}
+		else if (!strncasecmp(arg, "REQ ", 4))
+			send_line(c, ":%s CAP * NAK %s", SERVER_NAME, arg + 4);
+		else if (!strncasecmp(arg, "END", 3))
+		{
+			c->capping = 0;
+			maybe_register(c);
+		}
+	}
+	else if (!strcasecmp(command, "PING"))
+		send_line(c, ":%s PONG %s %s", SERVER_NAME, SERVER_NAME, arg);
+	else if (!strcasecmp(command, "QUIT"))
+	{
+		send_line(c, "ERROR :Closing Link: localhost (Quit)");
+		c->closing = 1;
+	}
+	else if (!c->registered)
+		return;
+	else if (!strcasecmp(command, "MODE"))
+	{
+		target = strsep(&arg, " ");
+		if (*target != '#')
+			return;
+		if (arg && *arg == 'b')
+			send_line(c, ":%s 368 %s %s :End of Channel Ban List",
+					SERVER_NAME, c->nick, target);
+		else
+		{
+			send_line(c, ":%s 324 %s %s +nt", 
+					SERVER_NAME, c->nick, target);
+			send_line(c, ":%s 329 %s %s 1000000000", 
+					SERVER_NAME, c->nick, target);
+		}
+	}
+	else if (!strcasecmp(command, "WHO"))
+	{
+		target = strsep(&arg, " ");
+		while ((arg = strsep(&target, ",")))
+			send_who(c, arg);
+	}
+	else if (!strcasecmp(command, "JOIN"))
+	{
+		int	chan;
+
+		target = strsep(&arg, " ");
+		while ((arg = strsep(&target, ",")))
+		{
+			if (sscanf(arg, "#chan%d", &chan) == 1 && 
+					chan >= 0 && chan < channels)
+				continue;	/* You're already on it */
+			send_line(c, ":%s!~user@localhost JOIN :%s", 
+					c->nick, arg);
+			send_line(c, ":%s 353 %s = %s :@%s", 
+					SERVER_NAME, c->nick, arg, c->nick);
+			send_line(c, ":%s 366 %s %s :End of /NAMES list.",
+					SERVER_NAME, c->nick, arg);
+		}
+	}
+	else if (!strcasecmp(command, "PART"))
+	{
+		target = strsep(&arg, " ");
+		while ((arg = strsep(&target, ",")))
+			send_line(c, ":%s!~user@localhost PART %s", 
+					c->nick, arg);
+	}
+	else if (!strcasecmp(command, "USERHOST"))
+		send_line(c, ":%s 302 %s :", SERVER_NAME, c->nick);
+	else if (!strcasecmp(command, "ISON"))
+		send_line(c, ":%s 303 %s :", SERVER_NAME, c->nick);
+}
+
+static void	read_client (Client *c)
+{
+	ssize_t	len;
+	char *	line;
+	char *	end;
+
+	len = read(c->fd, c->inbuf + c->inlen, sizeof c->inbuf - c->inlen - 1);
+	if (len <= 0)
+	{
+		drop_client(c);
+		return;
+	}
+	c->inlen += len;
+	c->inbuf[c->inlen] = 0;
+
+	line = c->inbuf;
+	while ((end = strchr(line, '\n')))
+	{
+		*end = 0;
+		if (end > line && end[-1] == '\r')
+			end[-1] = 0;
+		handle_line(c, line);
+		line = end + 1;
+	}
+
+	c->inlen -= line - c->inbuf;
+	memmove(c->inbuf, line, c->inlen);
+	if (c->inlen == sizeof c->inbuf - 1)
+		c->inlen = 0;			/* Line too long, drop it */
+}
+
+static void	write_client (Client *c)
+{
+	ssize_t	len;
+
+	if ((len = write(c->fd, c->outbuf, c->outlen)) < 0)
+	{
+		if (errno != EAGAIN && errno != EINTR)
+			drop_client(c);
+		return;
+	}
+	c->outlen -= len;
+	memmove(c->outbuf, c->outbuf + len, c->outlen);
+
+	if (c->outlen == 0 && c->closing)
+		drop_client(c);
+}
+
+static void	new_client (int listener)
+{
+	Client *c;
+	int	fd, i;
+
+	if ((fd = accept(listener, NULL, NULL)) < 0)
+		return;
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	c = calloc(1, sizeof *c);
+	c->fd = fd;
+	c->seed = 1;
+	c->npeople = users * 2;
+	c->people = calloc(c->npeople, sizeof *c->people);
+	for (i = 0; i < c->npeople; i++)
+		snprintf(c->people[i].nick, sizeof c->people[i].nick, 
+				"nick%d", i);
+	gettimeofday(&c->started, NULL);
+	c->next = clients;
+	clients = c;
+}
+
+static void	drop_client (Client *c)
+{
+	Client **	p;
+	double		secs;
+
+	for (p = &clients; *p; p = &(*p)->next)
+	{
+		if (*p == c)
+		{
+			*p = c->next;
+			break;
+		}
+	}
+
+	secs = time_since(&c->started);
+	fprintf(stderr, "%s: %ld lines in %.1f secs (%.0f lines/sec)\n",
+			*c->nick ? c->nick : "(unregistered)", c->sent, 
+			secs, secs > 0 ? c->sent / secs : 0);
+
+	close(c->fd);
+	free(c->outbuf);
+	free(c->people);
+	free(c);
+
+	if (just_once)
+		exit(0);
+}
+
+/**************************************************************************/
+static void	set_weights (char *spec)
+{
+	char *	item;
+	char *	value;
+	int	kind;
+
+	while ((item = strsep(&spec, ",")))
+	{
+		if (!(value = strchr(item, '=')))
+			usage();
+		*value++ = 0;
+		for (kind = 0; kind < NUMBER_OF_KINDS; kind++)
+			if (!strcasecmp(item, kind_names[kind]))
+				break;
+		if (kind == NUMBER_OF_KINDS)
+			usage();
+		weights[kind] = atoi(value);
+	}
+}
+
+static void	usage (void)
+{
+	fprintf(stderr, 
+"Usage: mockircd [-1] [-p port] [-c channels] [-u users] [-r lines/sec]\n"
+"                [-n lines] [-m kind=weight,...]\n"
+"  kinds: privmsg join quit nick split dcc names\n");
+	exit(1);
+}
+
+int	main (int argc, char **argv)
+{
+	struct sockaddr_in	sin;
+	struct timeval		timeout;
+	fd_set	rd, wr;
+	Client *c, *next;
+	int	listener, maxfd, ch, one = 1;
+	int	port = 6667;
+
+	while ((ch = getopt(argc, argv, "1c:m:n:p:r:u:")) != EOF)
+	{
+		switch (ch)
+		{
+			case '1':
+				just_once = 1;
+				break;
+			case 'c':
+				channels = atoi(optarg);
+				break;
+			case 'm':
+				set_weights(optarg);
+				break;
+			case 'n':
+				max_lines = atol(optarg);
+				break;
+			case 'p':
+				port = atoi(optarg);
+				break;
+			case 'r':
+				rate = atof(optarg);
+				break;
+			case 'u':
+				users = atoi(optarg);
+				break;
+			default:
+				usage();
+		}
+	}
+	if (channels < 1 || users < 1 || port < 1)
+		usage();
+
+	my_signal(SIGPIPE, SIG_IGN);
+
+	if ((listener = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+	{
+		perror("socket");
+		exit(1);
+	}
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+
+	memset(&sin, 0, sizeof sin);
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(port);
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(listener, (struct sockaddr *)&sin, sizeof sin) < 0 ||
+	    listen(listener, 5) < 0)
+	{
+		perror("bind");
+		exit(1);
+	}
+	fprintf(stderr, "Listening on 127.0.0.1 port %d\n", port);
+
+	for (;;)
+	{
+		FD_ZERO(&rd);
+		FD_ZERO(&wr);
+		FD_SET(listener, &rd);
+		maxfd = listener;
+		for (c = clients; c; c = c->next)
+		{
+			pump(c);
+			FD_SET(c->fd, &rd);
+			if (c->outlen)
+				FD_SET(c->fd, &wr);
+			if (c->fd > maxfd)
+				maxfd = c->fd;
+		}
+
+		timeout.tv_sec = 0;
+		timeout.tv_usec = 10000;
+		if (select(maxfd + 1, &rd, &wr, NULL, &timeout) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			perror("select");
+			exit(1);
+		}
+
+		if (FD_ISSET(listener, &rd))
+			new_client(listener);
+
+		for (c = clients; c; c = next)
+		{
+			next = c->next;
+			if (FD_ISSET(c->fd, &wr))
+			{
+				write_client(c);
+				continue;	/* 'c' might be gone */
+			}
+			if (FD_ISSET(c->fd, &rd))
+				read_client(c);
+		}
+	}
+}
+
+/* End of file */
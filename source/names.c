@@ -47,6 +47,8 @@
 #include "list.h"
 #include "hook.h"
 #include "parse.h"
+#include "timer.h"
+#include "functions.h"
 
 typedef struct nick_stru
 {
@@ -57,6 +59,8 @@ typedef struct nick_stru
 	short	chanop;		/* True if they are a channel operator */
 	short	voice;		/* 1 if they are, 0 if theyre not, -1 if uk */
 	short	half_assed;	/* 1 if they are, 0 if theyre not, -1 if uk */
+	short	away;		/* 1 if they are, 0 if theyre not, -1 if uk */
+	char	*account;	/* Services account, if the server told us */
 }	Nick;
 
 typedef	struct	nick_list_stru
@@ -79,7 +83,8 @@ struct	channel_stru *	prev;		/* pointer to previous channel */
 	int		server;		/* The server the channel is "on" */
 	int		winref;		/* The window the channel is "on" */
 	int		curr_count;	/* Current channel precedence */
-	int		waiting;	/* Syncing, waiting for names/who */
+	int		waiting;	/* 1 = Syncing, waiting for names/who,
+					   2 = Waiting to send the MODE */
 	NickList	nicks;		/* alist of nicks on channel */
 
 	char 		base_modes[54];	/* Just the modes w/o args */
@@ -101,6 +106,9 @@ static	Channel *	channel_list = NULL;
 static	int	match_chan_with_id (const char *chan, const char *match);
 #endif
 static	void	channel_hold_election (int winref);
+static	int	run_channel_syncs (void *);
+
+static	const char	channel_sync_timeref[] = "SYNCTIM";
 
 
 /*
@@ -197,6 +205,7 @@ static void 	clear_channel (Channel *chan)
 	{
 		new_free(&list->list[i]->nick);
 		new_free(&list->list[i]->userhost);
+		new_free(&list->list[i]->account);
 		new_free(&list->list[i]);
 	}
 	new_free((void **)&list->list);
@@ -412,7 +421,9 @@ void 	add_to_channel (const char *channel, const char *nick, int server, int sus
 	int	ischop = oper;
 	int	isvoice = voice;
 	int	half_assed = ha;
+	int	multi;
 const	char	*prefix;
+const	char	*userhost;
 
 	if (!(chan = find_channel(channel, server)))
 		return;
@@ -423,71 +434,76 @@ const	char	*prefix;
 	if (!prefix || !*prefix)
 		prefix = "@%+";
 
-	/* 
-	 * This is defensive just in case someone in the future
-	 * decides to do the right thing...
+	/*
+	 * Without multi-prefix, the server only tells us the "highest"
+	 * status, so an op might or might not also be voiced.  With it,
+	 * we get every status the user has, so we know for sure.
 	 */
-	for (;;)
+	multi = get_server_cap(server, "multi-prefix");
+	while (*nick && strchr(prefix, *nick))
 	{
-		if (!strchr(prefix, *nick))
-		{
-			break;
-		}
-		else if (*nick == '+')
-		{
-			nick++;
-			if (is_me(server, nick))
-				chan->voice = 1;
-			isvoice = 1;
-			break;
-		}
-		else if (*nick == '@')
+		if (*nick == '@')
 		{
-			nick++;
-			if (is_me(server, nick))
-				chan->chop = 1;
-			else 
-			{
-				if (isvoice == 0)
-					isvoice = -1;
-				if (half_assed == 0)
-					half_assed = -1;
-			}
 			ischop = 1;
-			break;
+			if (!multi && isvoice == 0)
+				isvoice = -1;
+			if (!multi && half_assed == 0)
+				half_assed = -1;
 		}
 		else if (*nick == '%')
 		{
-			nick++;
-			if (is_me(server, nick))
-				chan->half_assed = 1;
-			else
-			{
-				if (isvoice == 0)
-					isvoice = -1;
-			}
 			half_assed = 1;
-			break;
+			if (!multi && isvoice == 0)
+				isvoice = -1;
 		}
-		else
-		{
-			nick++;
+		else if (*nick == '+')
+			isvoice = 1;
+		nick++;
+
+		if (!multi)
 			break;
-		}
+	}
+
+	/* With userhost-in-names, we get "nick!user@host" */
+	if ((userhost = strchr(nick, '!')))
+	{
+		char *	copy = LOCAL_COPY(nick);
+
+		copy[userhost - nick] = 0;
+		userhost++;
+		nick = copy;
+	}
+
+	if (is_me(server, nick))
+	{
+		if (ischop == 1)
+			chan->chop = 1;
+		if (half_assed == 1)
+			chan->half_assed = 1;
+		if (isvoice == 1)
+			chan->voice = 1;
+		if (isvoice == -1)
+			isvoice = voice;
+		if (half_assed == -1)
+			half_assed = ha;
 	}
 
 	new_n = (Nick *)new_malloc(sizeof(Nick));
 	new_n->nick = malloc_strdup(nick);
-	new_n->userhost = NULL;
+	new_n->userhost = userhost ? malloc_strdup(userhost) : NULL;
+	new_n->account = NULL;
+
 	new_n->suspicious = suspicious;
 	new_n->chanop = ischop;
 	new_n->voice = isvoice;
 	new_n->half_assed = half_assed;
+	new_n->away = -1;
 
 	if ((old = (Nick *)add_to_array((array *)&chan->nicks, (array_item *)new_n)))
 	{
 		new_free(&old->nick);
 		new_free(&old->userhost);
+		new_free(&old->account);
 	}
 }
 
@@ -568,6 +584,7 @@ void 	remove_from_channel (const char *channel, const char *nick, int server)
 		{
 			new_free(&tmp->nick);
 			new_free(&tmp->userhost); /* Da5id reported mf here */
+			new_free(&tmp->account);
 			new_free((char **)&tmp);
 		}
 	}
@@ -597,6 +614,45 @@ void 	rename_nick (const char *old_nick, const char *new_nick, int server)
 }
 
 
+/*
+ * set_nick_away: in response to an AWAY from a server with away-notify,
+ * or a WHO reply, remember whether the nick is away on all your channels.
+ */
+void	set_nick_away (int server, const char *nick, int away)
+{
+	Channel *chan = NULL;
+	Nick	*tmp;
+
+	if (server == NOSERV) return;
+
+	while (traverse_all_channels(&chan, server, 1))
+		if ((tmp = find_nick_on_channel(chan, nick)))
+			tmp->away = away;
+}
+
+/*
+ * set_nick_account: in response to an ACCOUNT from a server with 
+ * account-notify, or an extended JOIN, remember which services account
+ * the nick is logged into on all your channels.  "*" means none.
+ */
+void	set_nick_account (int server, const char *nick, const char *account)
+{
+	Channel *chan = NULL;
+	Nick	*tmp;
+
+	if (server == NOSERV) return;
+
+	while (traverse_all_channels(&chan, server, 1))
+	{
+		if (!(tmp = find_nick_on_channel(chan, nick)))
+			continue;
+		if (!account || !strcmp(account, "*"))
+			new_free(&tmp->account);
+		else
+			malloc_strcpy(&tmp->account, account);
+	}
+}
+
 /*
  * check_channel_type: checks if the given channel is a normal #channel
  * or a new !channel from irc2.10.  If the latter, then it reformats it
@@ -651,6 +707,26 @@ int	is_halfop (const char *channel, const char *nick)
 		return 0;
 }
 
+int	is_nick_away (const char *channel, const char *nick)
+{
+	Nick *n;
+
+	if ((n = find_nick(from_server, channel, nick)))
+		return n->away;
+	else
+		return -1;
+}
+
+const char *	get_nick_account (const char *channel, const char *nick)
+{
+	Nick *n;
+
+	if ((n = find_nick(from_server, channel, nick)))
+		return n->account;
+	else
+		return NULL;
+}
+
 int	number_on_channel (const char *name, int server)
 {
 	Channel *channel = find_channel(name, server);
@@ -978,13 +1054,122 @@ void	channel_not_waiting (const char *channel, int server)
 			channel, server);
 }
 
+/*
+ * schedule_channel_sync: Sync the channel (MODE, and then WHO when that
+ * comes back) when the server has a sync token for it.  If you join 
+ * fifty channels at once, they are synced a few at a time, in the order
+ * you joined them, instead of all at once.
+ */
+void	schedule_channel_sync (const char *channel, int server)
+{
+	Channel *tmp = find_channel(channel, server);
+
+	if (tmp)
+	{
+		tmp->waiting = 2;
+		run_channel_syncs(NULL);
+	}
+}
+
+static int	run_channel_syncs (void *unused)
+{
+	Channel *tmp;
+	double	wait, next = 0;
+
+	if (!channel_list)
+		return 0;
+
+	/* Oldest channels are at the end of the list */
+	for (tmp = channel_list; tmp->next; tmp = tmp->next)
+		;
+	for (; tmp; tmp = tmp->prev)
+	{
+		if (tmp->waiting != 2)
+			continue;
+		if ((wait = take_server_sync_token(tmp->server)) > 0)
+		{
+			if (next == 0 || wait < next)
+				next = wait;
+			continue;
+		}
+
+		tmp->waiting = 1;
+		send_to_aserver(tmp->server, "MODE %s", tmp->channel);
+	}
+
+	if (timer_exists(channel_sync_timeref))
+		remove_timer(channel_sync_timeref);
+	if (next > 0)
+		add_timer(1, channel_sync_timeref, next, 1, run_channel_syncs,
+				NULL, NULL, GENERAL_TIMER, -1, 0);
+	return 0;
+}
+
+/*
+ * $chanctl(SYNCING [server])		Channels that aren't synced yet
+ * $chanctl(QUEUED [server])		Channels still waiting for a turn
+ * $chanctl(GET <channel> SYNC [server])	QUEUED, SYNCING, or SYNCED
+ */
+BUILT_IN_FUNCTION(function_chanctl, input)
+{
+	char *	listc;
+	char *	channel = NULL;
+	char *	retval = NULL;
+	size_t	clue = 0;
+	int	server = from_server;
+	Channel *tmp;
+
+	GET_FUNC_ARG(listc, input);
+	if (!my_stricmp(listc, "GET"))
+	{
+		char *	item;
+
+		GET_FUNC_ARG(channel, input);
+		GET_FUNC_ARG(item, input);
+		if (input && *input)
+			GET_INT_ARG(server, input);
+		if (!(tmp = find_channel(channel, server)))
+			RETURN_EMPTY;
+
+		if (!my_stricmp(item, "SYNC"))
+		{
+			if (tmp->waiting == 2)
+				RETURN_STR("QUEUED");
+			else if (tmp->waiting)
+				RETURN_STR("SYNCING");
+			else
+				RETURN_STR("SYNCED");
+		}
+		RETURN_EMPTY;
+	}
+	else if (!my_stricmp(listc, "SYNCING") || !my_stricmp(listc, "QUEUED"))
+	{
+		int	queued = !my_stricmp(listc, "QUEUED");
+
+		if (input && *input)
+			GET_INT_ARG(server, input);
+
+		for (tmp = channel_list; tmp; tmp = tmp->next)
+		{
+			if (tmp->server != server || !tmp->waiting)
+				continue;
+			if (queued && tmp->waiting != 2)
+				continue;
+			malloc_strcat_wordlist_c(&retval, " ", tmp->channel, &clue);
+		}
+		RETURN_MSTR(retval);
+	}
+
+	RETURN_EMPTY;
+}
+
 void 	update_channel_mode (const char *channel, const char *mode)
 {
 	Channel *tmp = find_channel(channel, from_server);
 
 	if (tmp)
 		decifer_mode(mode, tmp);
-	update_all_status();
+	update_all_status_for(STATUS_DEP_MODE);
 }
 
 const char 	*get_channel_key (const char *channel, int server)
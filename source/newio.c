@@ -74,6 +74,8 @@ typedef	struct	myio_struct
 	int	(*io_callback) (int vfd, int quiet);
 	int	quiet;
 	int	server;			/* For message routing */
+	void *	ssl;			/* SSL state (see ssl.c) */
+	short	want_write;		/* Callback wants writable events */
 }           MyIO;
 
 static	MyIO **	io_rec = NULL;
@@ -539,6 +541,7 @@ int 	new_open (int channel, void (*callback) (int), int io_type, int quiet, int
 		ioe = io_rec[vfd] = (MyIO *)new_malloc(sizeof(MyIO));
 		ioe->buffer_size = IO_BUFFER_SIZE;
 		ioe->buffer = (char *)new_malloc(ioe->buffer_size + 2);
+		ioe->ssl = NULL;
 	}
 
 	ioe->channel = channel;
@@ -549,6 +552,7 @@ int 	new_open (int channel, void (*callback) (int), int io_type, int quiet, int
 	ioe->held = 0;
 	ioe->quiet = quiet;
 	ioe->server = server;
+	ioe->want_write = 0;
 
 	if (io_type == NEWIO_READ)
 		ioe->io_callback = unix_read;
@@ -644,8 +648,8 @@ int	new_close (int vfd)
 
 	if (vfd >= 0 && vfd <= global_max_vfd && (ioe = io_rec[vfd]))
 	{
-		if (ioe->io_callback == ssl_read)	/* XXX */
-			shutdown_ssl(ioe->channel);
+		if (ioe->ssl)
+			shutdown_ssl(vfd);
 		knoread(vfd);
 		knowrite(vfd);
 
@@ -670,6 +674,47 @@ int	new_close (int vfd)
 }
 
 
+/*
+ * The SSL state for a vfd lives here, so ssl.c can get at it without 
+ * having to go looking for it.  The vfd must have been new_open()ed first.
+ */
+void *	get_vfd_ssl (int vfd)
+{
+	if (vfd < 0 || vfd > global_max_vfd || !io_rec[vfd])
+		return NULL;
+	return io_rec[vfd]->ssl;
+}
+
+int	set_vfd_ssl (int vfd, void *ssl)
+{
+	if (vfd < 0 || vfd > global_max_vfd || !io_rec[vfd])
+		return -1;
+	io_rec[vfd]->ssl = ssl;
+	return 0;
+}
+
+/*
+ * new_want_write -- Ask that the vfd's io callback also be called when 
+ *		     the vfd is writable (want = 1), or stop asking (want = 0).
+ *		     This is for things like SSL that sometimes can't make 
+ *		     progress until the other side takes our data.
+ */
+void	new_want_write (int vfd, int want)
+{
+	if (vfd < 0 || vfd > global_max_vfd || !io_rec[vfd])
+		return;
+	if (io_rec[vfd]->want_write == want)
+		return;
+
+#ifndef USE_PTHREAD
+	if ((io_rec[vfd]->want_write = want))
+		kwrite(vfd);
+	else
+		knowrite(vfd);
+#endif
+}
+
+
 /***********************************************************************/
 /******************** Start of unix-specific code here ******************/
 /************************************************************************/
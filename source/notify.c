@@ -84,6 +84,8 @@ typedef struct	notify_alist
 
 static 	void	ison_notify (int refnum, char *AskedFor, char *AreOn);
 static 	void	rebuild_notify_ison 	(int server);
+static	void	monitor_send		(int refnum, char op, const char *nicks);
+static	void	monitor_clear		(int refnum);
 
 
 #define NOTIFY_LIST(s)		(&(s->notify_list))
@@ -193,6 +195,8 @@ BUILT_IN_COMMAND(notify)
 			    if ((new_n = (NotifyItem *)remove_from_array(
 					(array *)NOTIFY_LIST(s), nick)))
 			    {
+				if (NOTIFY_LIST(s)->monitor > 0)
+				    monitor_send(refnum, '-', new_n->nick);
 				new_free(&(new_n->nick));
 				new_free((char **)&new_n);
 
@@ -219,6 +223,8 @@ BUILT_IN_COMMAND(notify)
 			    if (!(s = get_server(refnum)))
 				continue;
 
+			    if (NOTIFY_LIST(s)->monitor > 0)
+				monitor_clear(refnum);
 			    while ((new_n = (NotifyItem *)array_pop(
 						(array *)NOTIFY_LIST(s), 0)))
 			    {
@@ -277,14 +283,17 @@ BUILT_IN_COMMAND(notify)
 	    } /* End of for */
 	} /* End of while */
 
-	if (do_ison && get_int_var(DO_NOTIFY_IMMEDIATELY_VAR))
+	if (do_ison)
 	{
 	    for (refnum = first; refnum < last; refnum++)
 	    {
 		if (!(s = get_server(refnum)))
 		    continue;
 
-		if (is_server_registered(refnum) && list && *list)
+		if (NOTIFY_LIST(s)->monitor > 0)
+			monitor_send(refnum, '+', list);
+		else if (get_int_var(DO_NOTIFY_IMMEDIATELY_VAR) &&
+			    is_server_registered(refnum) && list && *list)
 			isonbase(refnum, list, ison_notify);
 	    }
 	}
@@ -363,6 +372,11 @@ void 	do_notify (void)
 		    continue;
 		}
 
+		/* The server will tell us, so we don't need to ask */
+		notify_monitor_start(servnum);
+		if (NOTIFY_LIST(s)->monitor > 0)
+			continue;
+
 		from_server = servnum;
 		if (NOTIFY_LIST(s)->ison && *NOTIFY_LIST(s)->ison
 				&& !get_server(servnum)->ison_wait)
@@ -530,6 +544,7 @@ void 	make_notify_list (int refnum)
 	s->notify_list.func = (alist_func)my_stricmp;
 	s->notify_list.hash = HASH_INSENSITIVE;
 	s->notify_list.ison = NULL;
+	s->notify_list.monitor = NOTIFY_ISON;
 
 	for (i = 0; i < number_of_servers; i++)
 		if ((sp = get_server(i)) && NOTIFY_MAX(sp))
@@ -573,6 +588,248 @@ void	destroy_notify_list (int refnum)
 	new_free(NOTIFY_LIST(s));
 }
 
+/*
+ * MONITOR and WATCH:  Servers that have one of these in their 005 will
+ * tell us when someone on the notify list signs on or off, so we only
+ * have to send them the list once per connection, instead of sending
+ * an ISON for the whole list every NOTIFY_INTERVAL.
+ */
+#define MONITOR_LINE_LEN	400
+
+static int	notify_server_protocol (int refnum)
+{
+	Server *	s;
+	const char *	limit;
+	int		protocol;
+
+	if (!(s = get_server(refnum)))
+		return NOTIFY_ISON;
+
+	if ((limit = get_server_005(refnum, "MONITOR")))
+		protocol = NOTIFY_MONITOR;
+	else if ((limit = get_server_005(refnum, "WATCH")))
+		protocol = NOTIFY_WATCH;
+	else
+		return NOTIFY_ISON;
+
+	/* If the whole list won't fit, just stick with ISON */
+	if (atol(limit) > 0 && NOTIFY_MAX(s) > atol(limit))
+		return NOTIFY_ISON;
+
+	return protocol;
+}
+
+static void	monitor_flush (int refnum, char op, char **line)
+{
+	Server *s;
+
+	if (!(s = get_server(refnum)) || !*line)
+		return;
+
+	if (NOTIFY_LIST(s)->monitor == NOTIFY_MONITOR)
+		send_to_aserver(refnum, "MONITOR %c %s", op, *line);
+	else
+		send_to_aserver(refnum, "WATCH %s", *line);
+	new_free(line);
+}
+
+/*
+ * monitor_send: Add ('+') or remove ('-') the space separated 'nicks' 
+ * from the server's MONITOR or WATCH list, as many per line as will fit.
+ */
+static void	monitor_send (int refnum, char op, const char *nicks)
+{
+	Server *s;
+	char *	copy;
+	char *	nick;
+	char *	line = NULL;
+	char	word[IRCD_BUFFER_SIZE + 1];
+	size_t	clue = 0;
+
+	if (!(s = get_server(refnum)) || !nicks)
+		return;
+
+	copy = LOCAL_COPY(nicks);
+	while ((nick = next_arg(copy, &copy)))
+	{
+		if (line && clue + strlen(nick) + 2 > MONITOR_LINE_LEN)
+		{
+			monitor_flush(refnum, op, &line);
+			clue = 0;
+		}
+
+		/* MONITOR + a,b,c	WATCH +a +b +c */
+		if (NOTIFY_LIST(s)->monitor == NOTIFY_MONITOR)
+			malloc_strcat_wordlist_c(&line, ",", nick, &clue);
+		else
+		{
+			snprintf(word, sizeof word, "%c%s", op, nick);
+			malloc_strcat_wordlist_c(&line, space, word, &clue);
+		}
+	}
+	monitor_flush(refnum, op, &line);
+}
+
+static void	monitor_clear (int refnum)
+{
+	Server *s;
+
+	if (!(s = get_server(refnum)))
+		return;
+
+	if (NOTIFY_LIST(s)->monitor == NOTIFY_MONITOR)
+		send_to_aserver(refnum, "MONITOR C");
+	else
+		send_to_aserver(refnum, "WATCH C");
+}
+
+/*
+ * notify_monitor_start: Once the server is registered and has told us
+ * in its 005 that it does MONITOR or WATCH, send it the notify list.
+ * After that, do_notify() leaves the server alone.
+ */
+void	notify_monitor_start (int refnum)
+{
+	Server *s;
+	int	protocol;
+
+	if (!(s = get_server(refnum)) || !is_server_registered(refnum))
+		return;
+	if (NOTIFY_LIST(s)->monitor != NOTIFY_ISON)
+		return;		/* Already did it, or it didn't work */
+	if ((protocol = notify_server_protocol(refnum)) == NOTIFY_ISON)
+		return;
+
+	if (x_debug & DEBUG_NOTIFY)
+		yell("Server [%d] does %s, so no more ISONs for it", refnum,
+			protocol == NOTIFY_MONITOR ? "MONITOR" : "WATCH");
+
+	NOTIFY_LIST(s)->monitor = protocol;
+	rebuild_notify_ison(refnum);
+	monitor_send(refnum, '+', NOTIFY_LIST(s)->ison);
+}
+
+/*
+ * A new connection starts with an empty MONITOR/WATCH list, so
+ * register_server() calls this to have notify_monitor_start() send
+ * ours again.
+ */
+void	notify_monitor_reset (int refnum)
+{
+	Server *s;
+
+	if (!(s = get_server(refnum)))
+		return;
+
+	NOTIFY_LIST(s)->monitor = NOTIFY_ISON;
+}
+
+/*
+ * monitor_mark: Someone on the notify list has signed on (with 'uh' 
+ * if we know it) or off.  Unlike an ISON reply, we already know their
+ * userhost, so there's no need to go ask for it.
+ */
+static void	monitor_mark (int refnum, const char *nick, const char *uh, int flag)
+{
+	Server *	s;
+	NotifyItem *	tmp;
+
+	if (!(s = get_server(refnum)))
+		return;
+
+	if (flag && uh && (tmp = (NotifyItem *)array_lookup(
+				(array *)NOTIFY_LIST(s), nick, 0, 0)))
+	{
+		if (tmp->flag != 1)
+		{
+			tmp->flag = 1;
+			notify_userhost_reply(refnum, nick, uh);
+		}
+	}
+	else
+		notify_mark(refnum, nick, flag, 0);
+}
+
+/*
+ * notify_monitor_returned: Called from numbers.c for the MONITOR and
+ * WATCH numerics.  'ArgList' does not include our nickname.  Returns 1
+ * if it was a reply to the notify list (and shouldn't be displayed), 0
+ * if it was something else (like the user doing /QUOTE MONITOR).
+ */
+int	notify_monitor_returned (int refnum, int numeric, const char **ArgList)
+{
+	Server *s;
+	char *	copy;
+	char *	target;
+	char *	uh;
+
+	if (!(s = get_server(refnum)))
+		return 0;
+
+	switch (numeric)
+	{
+	    case 730:		/* RPL_MONONLINE	:nick!user@host,... */
+	    case 731:		/* RPL_MONOFFLINE	:nick,... */
+	    {
+		if (!ArgList[0] || NOTIFY_LIST(s)->monitor != NOTIFY_MONITOR)
+			return 0;
+
+		copy = LOCAL_COPY(ArgList[0]);
+		while (copy && *copy)
+		{
+			target = next_in_comma_list(copy, &copy);
+			if ((uh = strchr(target, '!')))
+				*uh++ = 0;
+			monitor_mark(refnum, target, uh, numeric == 730);
+		}
+		break;
+	    }
+
+	    case 600:		/* RPL_LOGON		nick user host ts */
+	    case 604:		/* RPL_NOWON		nick user host ts */
+	    case 601:		/* RPL_LOGOFF		nick user host ts */
+	    case 605:		/* RPL_NOWOFF		nick * * 0 */
+	    {
+		size_t	size;
+
+		if (NOTIFY_LIST(s)->monitor != NOTIFY_WATCH)
+			return 0;
+		if (!ArgList[0] || !ArgList[1] || !ArgList[2])
+			return 0;
+
+		size = strlen(ArgList[1]) + strlen(ArgList[2]) + 2;
+		uh = alloca(size);
+		snprintf(uh, size, "%s@%s", ArgList[1], ArgList[2]);
+		monitor_mark(refnum, ArgList[0], uh, 
+				numeric == 600 || numeric == 604);
+		break;
+	    }
+
+	    /* 
+	     * ERR_MONLISTFULL / ERR_TOOMANYWATCH -- The list got too big
+	     * for the server.  Take everything back and go back to ISON.
+	     */
+	    case 734:
+	    case 512:
+	    {
+		if (numeric == 734 && NOTIFY_LIST(s)->monitor != NOTIFY_MONITOR)
+			return 0;
+		if (numeric == 512 && NOTIFY_LIST(s)->monitor != NOTIFY_WATCH)
+			return 0;
+
+		monitor_clear(refnum);
+		NOTIFY_LIST(s)->monitor = NOTIFY_ISON_ONLY;
+		return 0;
+	    }
+
+	    /* RPL_WATCHOFF -- The reply to "WATCH -nick" */
+	    case 602:
+		return (NOTIFY_LIST(s)->monitor == NOTIFY_WATCH);
+	}
+
+	return 1;
+}
+
 char *	get_notify_nicks (int refnum, int showon)
 {
 	Server *s;
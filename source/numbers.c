@@ -57,6 +57,9 @@
 
 static void	add_user_who (int refnum, const char *from, const char *comm, const char **ArgList);
 static void	add_user_end (int refnum, const char *from, const char *comm, const char **ArgList);
+static void	add_user_whox (int refnum, const char *from, const char *comm, const char **ArgList);
+static void	sync_channel_who (int refnum, char *channel);
+static void	names_compat (int refnum, const char *line, char *result);
 static 	int	number_of_bans = 0;
 
 /*
@@ -295,6 +298,9 @@ void 	numbered_command (const char *from, const char *comm, char const **ArgList
 			else
 				set_server_005(from_server, set, space);
 		}
+
+		/* If it does MONITOR or WATCH, we can stop ISONing it */
+		notify_monitor_start(from_server);
 		break;
 	}
 
@@ -504,6 +510,14 @@ void 	numbered_command (const char *from, const char *comm, char const **ArgList
 
 		    if (is_channel_anonymous(copy, from_server))
 			channel_not_waiting(copy, from_server);
+
+		    /*
+		     * With both of these, NAMES already told us everything
+		     * the WHO would have, so don't bother asking.
+		     */
+		    else if (get_server_cap(from_server, "multi-prefix") &&
+			     get_server_cap(from_server, "userhost-in-names"))
+			channel_not_waiting(copy, from_server);
 		    else
 		    {
 			maxnum = get_server_max_cached_chan_size(from_server);
@@ -511,14 +525,12 @@ void 	numbered_command (const char *from, const char *comm, char const **ArgList
 			{
 			    numonchannel = number_on_channel(copy, from_server);
 			    if (numonchannel <= maxnum)
-				whobase(from_server, copy, add_user_who, 
-						add_user_end);
+				sync_channel_who(from_server, copy);
 			    else
 				channel_not_waiting(copy, from_server);
 			}
 			else
-			    whobase(from_server, copy, add_user_who, 
-					add_user_end);
+			    sync_channel_who(from_server, copy);
 		    }
 		}
 
@@ -541,6 +553,21 @@ void 	numbered_command (const char *from, const char *comm, char const **ArgList
 		if (!(line = ArgList[2]))
 			{ line = empty_string; }
 
+		/*
+		 * With multi-prefix and userhost-in-names, the nicks look
+		 * like "@+nick!user@host".  The channel wants all that, but
+		 * scripts and /ON NAMES expect the old "@nick", so that's 
+		 * what everybody after us gets.
+		 */
+		if (get_server_cap(from_server, "multi-prefix") ||
+		    get_server_cap(from_server, "userhost-in-names"))
+		{
+		    char *	compat = alloca(strlen(line) + 1);
+
+		    names_compat(from_server, line, compat);
+		    ArgList[2] = compat;
+		}
+
 		if (channel_is_syncing(channel, from_server))
 		{
 		    char *line_copy = LOCAL_COPY(line);
@@ -612,6 +639,22 @@ void 	numbered_command (const char *from, const char *comm, char const **ArgList
 		xwhoreply(from_server, NULL, comm, ArgList);
 		goto END;
 
+	case 600:		/* #define RPL_LOGON		600 */
+	case 601:		/* #define RPL_LOGOFF		601 */
+	case 602:		/* #define RPL_WATCHOFF	602 */
+	case 604:		/* #define RPL_NOWON		604 */
+	case 605:		/* #define RPL_NOWOFF		605 */
+	case 730:		/* #define RPL_MONONLINE	730 */
+	case 731:		/* #define RPL_MONOFFLINE	731 */
+		if (notify_monitor_returned(from_server, numeric, ArgList))
+			goto END;
+		break;
+
+	case 512:		/* #define ERR_TOOMANYWATCH	512 */
+	case 734:		/* #define ERR_MONLISTFULL	734 */
+		notify_monitor_returned(from_server, numeric, ArgList);
+		break;
+
 	/* XXX Yea yea, these are out of order. so shoot me. */
 	case 346:               /* #define RPL_INVITELIST (+I for erf) */
 	case 348:               /* #define RPL_EXCEPTLIST (+e for erf) */
@@ -742,6 +785,10 @@ void 	numbered_command (const char *from, const char *comm, char const **ArgList
 		if (!(token = ArgList[0]))
 			{ rfc1459_odd(from, comm, ArgList); goto END; }
 
+		/* Servers that don't do CAP don't need to tell us about it */
+		if (!is_server_registered(from_server) && !strcmp(token, "CAP"))
+			goto END;
+
 		if (check_server_redirect(from_server, token))
 			goto END;
 		if (check_server_wait(from_server, token))
@@ -1583,18 +1630,105 @@ static void	add_user_who (int refnum, const char *from, const char *comm, const
 	uh = alloca(size);
 	snprintf(uh, size, "%s@%s", user, host);
 	add_userhost_to_channel(channel, nick, refnum, uh);
+
+	/* "H" is here, "G" is gone */
+	if (ArgList[5])
+		set_nick_away(refnum, nick, *ArgList[5] == 'G');
+}
+
+/*
+ * names_compat: Rewrite a 353 names list so each nick has only its 
+ * "highest" status prefix and no "!user@host", the way it looks when the
+ * server doesn't have multi-prefix or userhost-in-names.  'result' must 
+ * have room for strlen(line) + 1 bytes.
+ */
+static void	names_compat (int refnum, const char *line, char *result)
+{
+	const char *	prefix;
+	char *	copy;
+	char *	nick;
+	char *	bang;
+	char *	p = result;
+	size_t	len;
+
+	prefix = get_server_005(refnum, "PREFIX");
+	if (prefix && *prefix == '(' && (prefix = strchr(prefix, ')')))
+		prefix++;
+	if (!prefix || !*prefix)
+		prefix = "@%+";
+
+	copy = LOCAL_COPY(line);
+	while ((nick = next_arg(copy, &copy)))
+	{
+		if (p > result)
+			*p++ = ' ';
+		if (*nick && strchr(prefix, *nick))
+			*p++ = *nick++;
+		while (*nick && strchr(prefix, *nick))
+			nick++;
+		if ((bang = strchr(nick, '!')))
+			*bang = 0;
+		len = strlen(nick);
+		memcpy(p, nick, len);
+		p += len;
+	}
+	*p = 0;
 }
 
+/* The WHOX version: token, channel, user, host, nick, flags, account */
+static void	add_user_whox (int refnum, const char *from, const char *comm, const char **ArgList)
+{
+	const char 	*channel, *user, *host, *nick, *flags, *account;
+	size_t	size;
+	char 	*uh;
+
+	if (!(channel = ArgList[1]))
+		{ rfc1459_odd(from, "*", ArgList); return; }
+	if (!(user = ArgList[2]))
+		{ rfc1459_odd(from, "*", ArgList); return; }
+	if (!(host = ArgList[3]))
+		{ rfc1459_odd(from, "*", ArgList); return; }
+	if (!(nick = ArgList[4]))
+		{ rfc1459_odd(from, "*", ArgList); return; }
+	if (!(flags = ArgList[5]))
+		{ rfc1459_odd(from, "*", ArgList); return; }
+
+	size = strlen(user) + strlen(host) + 2;
+	uh = alloca(size);
+	snprintf(uh, size, "%s@%s", user, host);
+	add_userhost_to_channel(channel, nick, refnum, uh);
+	set_nick_away(refnum, nick, *flags == 'G');
+
+	/* WHOX says "0" for "not logged in" */
+	if ((account = ArgList[6]) && strcmp(account, zero))
+		set_nick_account(refnum, nick, account);
+}
+
+/* The end of a WHO can be for a whole comma-set of channels */
 static void	add_user_end (int refnum, const char *from, const char *comm, const char **ArgList)
 {
 	char *	copy;
+	char *	channels;
 	char *	channel;
 
 	if (!ArgList[0])
 		{ rfc1459_odd(from, "*", ArgList); return; }
 
 	copy = LOCAL_COPY(ArgList[0]);
-	channel = next_arg(copy, &copy);
-	channel_not_waiting(channel, refnum);
+	channels = next_arg(copy, &copy);
+	while (channels && *channels)
+	{
+		channel = next_in_comma_list(channels, &channels);
+		channel_not_waiting(channel, refnum);
+	}
+}
+
+/* Ask for the userhosts of everybody on a channel we just joined */
+static void	sync_channel_who (int refnum, char *channel)
+{
+	if (get_server_005(refnum, "WHOX"))
+		whoxbase(refnum, channel, add_user_whox, add_user_end);
+	else
+		whobase(refnum, channel, add_user_who, add_user_end);
 }
 
@@ -51,6 +51,7 @@
 #include "commands.h"
 #include "server.h"
 #include "levels.h"
+#include "bench.h"
 
 /* make this buffer *much* bigger than needed */
 #define OBNOXIOUS_BUFFER_SIZE BIG_BUFFER_SIZE * 10
@@ -199,7 +200,9 @@ int	init_screen (void)
 void	put_echo (const unsigned char *str)
 {
 	add_to_log(0, irclog_fp, -1, str, 0, NULL);
+	bench_enter(BENCH_DISPLAY);
 	add_to_screen(str);
+	bench_leave(BENCH_DISPLAY);
 }
 
 /*
@@ -55,6 +55,8 @@
 #include "parse.h"
 #include "notify.h"
 #include "timer.h"
+#include "alias.h"
+#include "functions.h"
 
 #define STRING_CHANNEL 	'+'
 #define MULTI_CHANNEL 	'#'
@@ -622,12 +624,16 @@ static void	p_channel (const char *from, const char *comm, const char **ArgList)
 	if (is_me(from_server, from))
 	{
 		add_channel(channel, from_server);
-		send_to_server("MODE %s", channel);
+		schedule_channel_sync(channel, from_server);
 	}
 	else
 	{
 		add_to_channel(channel, from, from_server, 0, op, vo, ha);
 		add_userhost_to_channel(channel, from, from_server, FromUserHost);
+
+		/* extended-join: "JOIN #channel account :realname" */
+		if (ArgList[1] && get_server_cap(from_server, "extended-join"))
+			set_nick_account(from_server, from, ArgList[1]);
 	}
 
 	if (check_ignore_channel(from, FromUserHost, 
@@ -667,6 +673,47 @@ static void	p_channel (const char *from, const char *comm, const char **ArgList)
 	notify_mark(from_server, from, 1, 0);
 }
 
+/*
+ * p_cap: The server's half of IRCv3 capability negotiation:
+ *	CAP <target> LS * :<caps>	(more LS lines to come)
+ *	CAP <target> LS :<caps>		(last LS line)
+ *	CAP <target> ACK :<caps>
+ */
+static void	p_cap (const char *from, const char *comm, const char **ArgList)
+{
+	const char	*subcmd, *caps;
+	int	more = 0;
+
+	if (!ArgList[0])
+		{ rfc1459_odd(from, comm, ArgList); return; }
+	if (!(subcmd = ArgList[1]))
+		{ rfc1459_odd(from, comm, ArgList); return; }
+	if (!(caps = ArgList[2]))
+		caps = empty_string;
+	else if (!strcmp(caps, "*") && ArgList[3])
+	{
+		more = 1;
+		caps = ArgList[3];
+	}
+
+	server_cap(from_server, subcmd, caps, more);
+}
+
+/* away-notify: "AWAY :reason" when they leave, "AWAY" when they're back */
+static void	p_away (const char *from, const char *comm, const char **ArgList)
+{
+	set_nick_away(from_server, from, ArgList[0] ? 1 : 0);
+}
+
+/* account-notify: "ACCOUNT <account>", or "ACCOUNT *" for logging out */
+static void	p_account (const char *from, const char *comm, const char **ArgList)
+{
+	if (!ArgList[0])
+		{ rfc1459_odd(from, comm, ArgList); return; }
+
+	set_nick_account(from_server, from, ArgList[0]);
+}
+
 static void 	p_invite (const char *from, const char *comm, const char **ArgList)
 {
 	const char	*invitee, *invited_to;
@@ -1405,53 +1452,313 @@ void	rfc1459_odd (const char *from, const char *comm, const char **ArgList)
 }
 
 protocol_command rfc1459[] = {
-{	"ADMIN",	NULL,		0		},
-{	"AWAY",		NULL,		0		},
-{ 	"CONNECT",	NULL,		0		},
-{	"ERROR",	p_error,	0		},
-{	"ERROR:",	p_error,	0		},
-{	"INVITE",	p_invite,	0		},
-{	"INFO",		NULL,		0		},
-{	"ISON",		NULL,		PROTO_QUOTEBAD	},
-{	"JOIN",		p_channel,	0		},
-{	"KICK",		p_kick,		0		},
-{	"KILL",		p_kill,		0		},
-{	"LINKS",	NULL,		0		},
-{	"LIST",		NULL,		0		},
-{	"MODE",		p_mode,		0		},
-{	"NAMES",	NULL,		0		},
-{	"NICK",		p_nick,		PROTO_QUOTEBAD	},
-{	"NOTICE",	p_notice,	0		},
-{	"OPER",		NULL,		0		},
-{	"PART",		p_part,		0		},
-{	"PASS",		NULL,		0 		},
-{	"PING",		p_ping,		0		},
-{	"PONG",		p_pong,		0		},
-{	"PRIVMSG",	p_privmsg,	0		},
-{	"QUIT",		p_quit,		PROTO_QUOTEBAD	},
-{	"REHASH",	NULL,		0		},
-{	"RESTART",	NULL,		0		},
-{	"RPONG",	p_rpong,	0		},
-{	"SERVER",	NULL,		PROTO_QUOTEBAD	},
-{	"SILENCE",	p_silence,	0		},
-{	"SQUIT",	NULL,		0		},
-{	"STATS",	NULL,		0		},
-{	"SUMMON",	NULL,		0		},
-{	"TIME",		NULL,		0		},
-{	"TRACE",	NULL,		0		},
-{	"TOPIC",	p_topic,	0		},
-{	"USER",		NULL,		0		},
-{	"USERHOST",	NULL,		PROTO_QUOTEBAD	},
-{	"USERS",	NULL,		0		},
-{	"VERSION",	NULL,		0		},
-{	"WALLOPS",	p_wallops,	0		},
-{	"WHO",		NULL,		PROTO_QUOTEBAD	},
-{	"WHOIS",	NULL,		0		},
-{	"WHOWAS",	NULL,		0		},
-{	NULL,		NULL,		0		}
+{	"ADMIN",	NULL,		0,		NULL,	NULL	},
+{	"ACCOUNT",	p_account,	0,		NULL,	NULL	},
+{	"AWAY",		p_away,		0,		NULL,	NULL	},
+{	"CAP",		p_cap,		0,		NULL,	NULL	},
+{ 	"CONNECT",	NULL,		0,		NULL,	NULL	},
+{	"ERROR",	p_error,	0,		NULL,	NULL	},
+{	"ERROR:",	p_error,	0,		NULL,	NULL	},
+{	"INVITE",	p_invite,	0,		NULL,	NULL	},
+{	"INFO",		NULL,		0,		NULL,	NULL	},
+{	"ISON",		NULL,		PROTO_QUOTEBAD,	NULL,	NULL	},
+{	"JOIN",		p_channel,	0,		NULL,	NULL	},
+{	"KICK",		p_kick,		0,		NULL,	NULL	},
+{	"KILL",		p_kill,		0,		NULL,	NULL	},
+{	"LINKS",	NULL,		0,		NULL,	NULL	},
+{	"LIST",		NULL,		0,		NULL,	NULL	},
+{	"MODE",		p_mode,		0,		NULL,	NULL	},
+{	"NAMES",	NULL,		0,		NULL,	NULL	},
+{	"NICK",		p_nick,		PROTO_QUOTEBAD,	NULL,	NULL	},
+{	"NOTICE",	p_notice,	0,		NULL,	NULL	},
+{	"OPER",		NULL,		0,		NULL,	NULL	},
+{	"PART",		p_part,		0,		NULL,	NULL	},
+{	"PASS",		NULL,		0,		NULL,	NULL	},
+{	"PING",		p_ping,		0,		NULL,	NULL	},
+{	"PONG",		p_pong,		0,		NULL,	NULL	},
+{	"PRIVMSG",	p_privmsg,	0,		NULL,	NULL	},
+{	"QUIT",		p_quit,		PROTO_QUOTEBAD,	NULL,	NULL	},
+{	"REHASH",	NULL,		0,		NULL,	NULL	},
+{	"RESTART",	NULL,		0,		NULL,	NULL	},
+{	"RPONG",	p_rpong,	0,		NULL,	NULL	},
+{	"SERVER",	NULL,		PROTO_QUOTEBAD,	NULL,	NULL	},
+{	"SILENCE",	p_silence,	0,		NULL,	NULL	},
+{	"SQUIT",	NULL,		0,		NULL,	NULL	},
+{	"STATS",	NULL,		0,		NULL,	NULL	},
+{	"SUMMON",	NULL,		0,		NULL,	NULL	},
+{	"TIME",		NULL,		0,		NULL,	NULL	},
+{	"TRACE",	NULL,		0,		NULL,	NULL	},
+{	"TOPIC",	p_topic,	0,		NULL,	NULL	},
+{	"USER",		NULL,		0,		NULL,	NULL	},
+{	"USERHOST",	NULL,		PROTO_QUOTEBAD,	NULL,	NULL	},
+{	"USERS",	NULL,		0,		NULL,	NULL	},
+{	"VERSION",	NULL,		0,		NULL,	NULL	},
+{	"WALLOPS",	p_wallops,	0,		NULL,	NULL	},
+{	"WHO",		NULL,		PROTO_QUOTEBAD,	NULL,	NULL	},
+{	"WHOIS",	NULL,		0,		NULL,	NULL	},
+{	"WHOWAS",	NULL,		0,		NULL,	NULL	},
+{	NULL,		NULL,		0,		NULL,	NULL	}
 };
-#define NUMBER_OF_COMMANDS (sizeof(rfc1459) / sizeof(protocol_command)) - 2;
-int 	num_protocol_cmds = -1;
+
+/*
+ * The protocol dispatch table.  Commands are hashed into an open addressed
+ * table that is never more than half full, so finding the handler for a
+ * command takes one or two string compares no matter how many there are.
+ * Numerics mostly go to numbered_command() (its switch is already a jump
+ * table), but a handler registered for one goes in numeric_handlers[].
+ *
+ * The table starts out with everything in rfc1459[], and then C code can
+ * register_protocol_command() and scripts can $protocolctl(ADD) more.
+ * A registered handler replaces any handler that was there before.
+ */
+static	protocol_command **	protocol_table = NULL;
+static	int			protocol_table_size = 0;
+static	int			protocol_table_count = 0;
+static	protocol_command *	numeric_handlers[1000];
+static	protocol_command *	registered = NULL;
+
+static unsigned	protocol_hash (const char *command)
+{
+	unsigned	hash = 2166136261U;
+
+	while (*command)
+		hash = (hash ^ (unsigned char)*command++) * 16777619U;
+	return hash;
+}
+
+/* Put 'cmd' in the table, replacing one of the same name */
+static void	protocol_table_insert (protocol_command *cmd)
+{
+	unsigned	mask = protocol_table_size - 1;
+	unsigned	i;
+
+	for (i = protocol_hash(cmd->command) & mask; protocol_table[i]; 
+			i = (i + 1) & mask)
+	{
+		if (!strcmp(protocol_table[i]->command, cmd->command))
+		{
+			protocol_table[i] = cmd;
+			return;
+		}
+	}
+	protocol_table[i] = cmd;
+	protocol_table_count++;
+}
+
+static int	valid_numeric (const char *command)
+{
+	long	numeric;
+
+	if (!is_number(command))
+		return 0;
+	numeric = atol(command);
+	return (numeric >= 0 && numeric < 1000);
+}
+
+/* (Re)build the table from rfc1459[] and whatever has been registered */
+static void	build_protocol_table (void)
+{
+	protocol_command *	cmd;
+	int	count = 0;
+	int	i;
+
+	for (i = 0; rfc1459[i].command; i++)
+		count++;
+	for (cmd = registered; cmd; cmd = cmd->next)
+		count++;
+
+	for (protocol_table_size = 64; protocol_table_size < count * 2; )
+		protocol_table_size *= 2;
+	new_free((char **)&protocol_table);
+	protocol_table = (protocol_command **)new_malloc(
+			sizeof(protocol_command *) * protocol_table_size);
+	memset(protocol_table, 0, 
+			sizeof(protocol_command *) * protocol_table_size);
+	protocol_table_count = 0;
+
+	for (i = 0; rfc1459[i].command; i++)
+		protocol_table_insert(&rfc1459[i]);
+
+	/* There is only ever one registration for each command */
+	memset(numeric_handlers, 0, sizeof(numeric_handlers));
+	for (cmd = registered; cmd; cmd = cmd->next)
+	{
+		if (valid_numeric(cmd->command))
+			numeric_handlers[atol(cmd->command)] = cmd;
+		else
+			protocol_table_insert(cmd);
+	}
+}
+
+static protocol_command *	find_protocol_command (const char *command)
+{
+	unsigned	mask;
+	unsigned	i;
+
+	if (!protocol_table)
+		build_protocol_table();
+
+	mask = protocol_table_size - 1;
+	for (i = protocol_hash(command) & mask; protocol_table[i]; 
+			i = (i + 1) & mask)
+		if (!strcmp(protocol_table[i]->command, command))
+			return protocol_table[i];
+	return NULL;
+}
+
+/*
+ * register_protocol_command: Handle 'command' from the server with 
+ * 'handler' (or the alias 'alias' if 'handler' is NULL) instead of
+ * whatever was handling it before.  'command' may be a numeric.
+ * Returns -1 if 'command' is a number outside of 000-999.
+ */
+int	register_protocol_command (const char *command, void (*handler) (const char *, const char *, const char **), int flags, const char *alias)
+{
+	protocol_command *	cmd;
+	char *	name;
+
+	if (is_number(command) && !valid_numeric(command))
+		return -1;
+
+	unregister_protocol_command(command);
+
+	name = upper(malloc_strdup(command));
+	cmd = (protocol_command *)new_malloc(sizeof(protocol_command));
+	cmd->command = name;
+	cmd->inbound_handler = handler;
+	cmd->flags = flags;
+	cmd->alias = alias ? upper(malloc_strdup(alias)) : NULL;
+	cmd->next = registered;
+	registered = cmd;
+
+	if (!protocol_table || protocol_table_count * 2 >= protocol_table_size)
+		build_protocol_table();
+	else if (valid_numeric(name))
+		numeric_handlers[atol(name)] = cmd;
+	else
+		protocol_table_insert(cmd);
+	return 0;
+}
+
+/*
+ * unregister_protocol_command: Go back to handling 'command' the way it
+ * was handled before anything was registered for it.  Returns -1 if
+ * nothing had been registered for it.
+ */
+int	unregister_protocol_command (const char *command)
+{
+	protocol_command *	cmd;
+	protocol_command *	prev = NULL;
+
+	for (cmd = registered; cmd; prev = cmd, cmd = cmd->next)
+		if (!my_stricmp(cmd->command, command))
+			break;
+	if (!cmd)
+		return -1;
+
+	if (prev)
+		prev->next = cmd->next;
+	else
+		registered = cmd->next;
+
+	new_free((char **)&cmd->command);
+	new_free(&cmd->alias);
+	new_free((char **)&cmd);
+	build_protocol_table();
+	return 0;
+}
+
+/* The handler for commands that were $protocolctl(ADD)ed by a script */
+static void	p_alias (const char *from, const char *comm, const char **ArgList)
+{
+	protocol_command *	cmd;
+	const char *	alias;
+	char *	name;
+	void *	arglist = NULL;
+	void	(*builtin) (const char *, char *, const char *) = NULL;
+	char *	args;
+
+	if (valid_numeric(comm))
+		cmd = numeric_handlers[atol(comm)];
+	else
+		cmd = find_protocol_command(comm);
+
+	if (!cmd || !cmd->alias ||
+	    !(alias = get_cmd_alias(cmd->alias, &arglist, &builtin)))
+	{
+		rfc1459_odd(from, comm, ArgList);
+		return;
+	}
+
+	/* The alias might $protocolctl(DELETE) itself, so copy its name */
+	name = LOCAL_COPY(cmd->alias);
+	args = LOCAL_COPY(PasteArgs(ArgList, 0));
+	args = malloc_sprintf(NULL, "%s %s %s", from, comm, args);
+	call_user_command(name, alias, args, arglist);
+	new_free(&args);
+}
+
+/*
+ * $protocolctl(ADD <command> <alias>)
+ *	When the server sends <command> (which may be a numeric), run
+ *	/<alias> <from> <command> <args> instead of what would have
+ *	happened.  This is faster than /ON RAW_IRC, which has to look at
+ *	every line.
+ * $protocolctl(DELETE <command>)
+ *	Undo $protocolctl(ADD).
+ * $protocolctl(GET <command>)
+ *	The alias that handles <command>, or empty.
+ * $protocolctl(COMMANDS)
+ *	Every command that the client knows how to handle.
+ */
+BUILT_IN_FUNCTION(function_protocolctl, input)
+{
+	char *	listc;
+	char *	command;
+
+	GET_FUNC_ARG(listc, input);
+	if (!my_stricmp(listc, "ADD")) {
+		char *	alias;
+
+		GET_FUNC_ARG(command, input);
+		GET_FUNC_ARG(alias, input);
+		if (register_protocol_command(command, p_alias, 0, alias))
+			RETURN_EMPTY;
+		RETURN_INT(1);
+	} else if (!my_stricmp(listc, "DELETE")) {
+		GET_FUNC_ARG(command, input);
+		RETURN_INT(unregister_protocol_command(command) ? 0 : 1);
+	} else if (!my_stricmp(listc, "GET")) {
+		protocol_command *	cmd;
+
+		GET_FUNC_ARG(command, input);
+		upper(command);
+		if (valid_numeric(command))
+			cmd = numeric_handlers[atol(command)];
+		else
+			cmd = find_protocol_command(command);
+		if (cmd && cmd->alias)
+			RETURN_STR(cmd->alias);
+	} else if (!my_stricmp(listc, "COMMANDS")) {
+		char *	retval = NULL;
+		size_t	clue = 0;
+		int	i;
+
+		if (!protocol_table)
+			build_protocol_table();
+		for (i = 0; i < protocol_table_size; i++)
+			if (protocol_table[i] && protocol_table[i]->inbound_handler)
+				malloc_strcat_wordlist_c(&retval, " ", 
+					protocol_table[i]->command, &clue);
+		for (i = 0; i < 1000; i++)
+			if (numeric_handlers[i])
+				malloc_strcat_wordlist_c(&retval, " ", 
+					numeric_handlers[i]->command, &clue);
+		RETURN_MSTR(retval);
+	}
+
+	RETURN_EMPTY;
+}
 
 /*
  * parse_server: parses messages from the server, doing what should be done
@@ -1464,12 +1771,9 @@ void 	parse_server (const char *orig_line, size_t orig_line_size)
 	const char	**ArgList;
 	const char	*TrueArgs[MAXPARA + 2];	/* Include space for command */
 	const char 	*OldFromUserHost;
-	int	loc;
+	protocol_command *cmd;
 	char	*line;
 
-	if (num_protocol_cmds == -1)
-		num_protocol_cmds = NUMBER_OF_COMMANDS;
-
 	if (!orig_line || !*orig_line)
 		return;		/* empty line from server -- bye bye */
 
@@ -1502,20 +1806,17 @@ void 	parse_server (const char *orig_line, size_t orig_line_size)
 		return;		/* Serious protocol violation -- ByeBye */
 	}
 
-	/* Some day all this needs to be replaced with an alist. */
 	if (is_number(comm))
-		numbered_command(from, comm, ArgList);
-	else
 	{
-		for (loc = 0; rfc1459[loc].command; loc++)
-			if (!strcmp(rfc1459[loc].command, comm))
-				break;
-
-		if (rfc1459[loc].command && rfc1459[loc].inbound_handler)
-			rfc1459[loc].inbound_handler(from, comm, ArgList);
+		if (valid_numeric(comm) && (cmd = numeric_handlers[atol(comm)]))
+			cmd->inbound_handler(from, comm, ArgList);
 		else
-			rfc1459_odd(from, comm, ArgList);
+			numbered_command(from, comm, ArgList);
 	}
+	else if ((cmd = find_protocol_command(comm)) && cmd->inbound_handler)
+		cmd->inbound_handler(from, comm, ArgList);
+	else
+		rfc1459_odd(from, comm, ArgList);
 
 	FromUserHost = OldFromUserHost;
 	from_server = -1;
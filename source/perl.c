@@ -44,11 +44,15 @@
 #include "functions.h"
 #include "output.h"
 #include "ifcmd.h"
+#include "hook.h"
 #include "extlang.h"
 
 int	isperlrunning=0, perlcalldepth=0;
 PerlInterpreter	*my_perl;
 
+static	char *	perl_hook		(int, const char *);
+static	void	perl_forget_handles	(void);
+
 EXTERN_C void xs_init _((void));
 EXTERN_C void boot_DynaLoader _((CV* cv));
 
@@ -106,6 +110,20 @@ static XS (XS_call) {
 	XSRETURN(items);
 }
 
+static XS (XS_on) {
+	int	handle, retval = -1;
+	char *	desc;
+	dXSARGS;
+	if (items >= 3 && (handle = perl_handle(SvPV_nolen(ST(2)))) != -1) {
+		desc = malloc_sprintf(NULL, "perl sub %s", SvPV_nolen(ST(2)));
+		retval = add_callback_hook(SvPV_nolen(ST(0)), 
+				items > 3 ? SvIV(ST(3)) : 0,
+				SvPV_nolen(ST(1)), perl_hook, handle, desc);
+		new_free(&desc);
+	}
+	XSRETURN_IV(retval);
+}
+
 static XS (XS_yell) {
 	int	foo;
 	dXSARGS;
@@ -128,6 +146,7 @@ EXTERN_C void	xs_init(void)
 	newXS(malloc_strdup("EPIC::expr"), XS_expr, malloc_strdup("IRC"));
 	newXS(malloc_strdup("EPIC::call"), XS_call, malloc_strdup("IRC"));
 	newXS(malloc_strdup("EPIC::yell"), XS_yell, malloc_strdup("IRC"));
+	newXS(malloc_strdup("EPIC::on"), XS_on, malloc_strdup("IRC"));
 }
 
 /* Stopping has one big memory leak right now, so it's not used. */
@@ -149,6 +168,7 @@ void	perlstartstop (int startnotstop)
 		if (SvTRUE(ERRSV)) 
 			yell("perl_run: %s", SvPV_nolen(ERRSV));
 	} else if (!startnotstop && isperlrunning && !perlcalldepth) {
+		perl_forget_handles();
 		perl_destruct(my_perl);
 		if (SvTRUE(ERRSV)) 
 			yell("perl_destruct: %s", SvPV_nolen(ERRSV));
@@ -215,6 +235,103 @@ char *	perlcall (char* sub, char* in, char* out, long item, char* input)
 	RETURN_MSTR(retval);
 }
 
+/*
+ * $perl() and /PERL compile their code every time, and $perlcall() looks
+ * its sub up by name every time.  A "handle" is a sub that was looked up
+ * once, and after that, using it is just a call:
+ *	$perlhandle(name)		Look up sub 'name' and return a handle
+ *	$perlinvoke(handle args)	Call it with each word of 'args'
+ *	EPIC::on(type, nick, name [, serial])
+ *					Call sub 'name' for /ON TYPE "NICK"
+ * Handles are never reused, so a hook's handle is good as long as the
+ * client is running.  If perl is stopped, they're looked up again.
+ */
+static	SV **	perl_handles = NULL;
+static	char **	perl_handle_names = NULL;
+static	int	perl_handle_count = 0;
+
+int	perl_handle (const char *name)
+{
+	CV *	cv;
+	int	i;
+
+	if (!name || !*name)
+		return -1;
+
+	perlstartstop(1);
+	for (i = 0; i < perl_handle_count; i++)
+		if (!strcmp(perl_handle_names[i], name))
+			return i;
+
+	if (!(cv = get_cv(name, 0)))
+		return -1;
+
+	RESIZE(perl_handles, SV *, perl_handle_count + 1);
+	RESIZE(perl_handle_names, char *, perl_handle_count + 1);
+	perl_handles[perl_handle_count] = SvREFCNT_inc((SV *)cv);
+	perl_handle_names[perl_handle_count] = malloc_strdup(name);
+	return perl_handle_count++;
+}
+
+static void	perl_forget_handles (void)
+{
+	int	i;
+
+	for (i = 0; i < perl_handle_count; i++)
+	{
+		if (perl_handles[i])
+			SvREFCNT_dec(perl_handles[i]);
+		perl_handles[i] = NULL;
+	}
+}
+
+char *	perl_invoke (int handle, int argc, char **argv)
+{
+	char *	retval = NULL;
+	CV *	cv;
+	SV *	sv;
+	SV **	sp;
+	int	i;
+
+	if (handle < 0 || handle >= perl_handle_count)
+		RETURN_EMPTY;
+
+	perlstartstop(1);
+	if (!perl_handles[handle])
+	{
+		if (!(cv = get_cv(perl_handle_names[handle], 0)))
+			RETURN_EMPTY;
+		perl_handles[handle] = SvREFCNT_inc((SV *)cv);
+	}
+
+	SPAGAIN;		/* Perl might not have been running before */
+	++perlcalldepth;
+	ENTER;
+	SAVETMPS;
+	PUSHMARK(SP);
+	for (i = 0; i < argc; i++)
+		XPUSHs(sv_2mortal(newSVpv(argv[i], 0)));
+	PUTBACK;
+	call_sv(perl_handles[handle], G_EVAL|G_SCALAR);
+	SPAGAIN;
+	sv = POPs;
+	SV2STR(sv, retval);
+	PUTBACK;
+	FREETMPS;
+	LEAVE;
+	--perlcalldepth;
+	RETURN_MSTR(retval);
+}
+
+/* A hooked sub gets $* of the event as its only argument */
+static char *	perl_hook (int handle, const char *args)
+{
+	char *	argv[1];
+
+	argv[0] = (char *)args;
+	return perl_invoke(handle, 1, argv);
+}
+
 char* perleval (char* input) {
 	char *retval=NULL;
 	if (input && *input) {
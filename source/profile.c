@@ -0,0 +1,597 @@
+/* $EPIC: profile.c,v 1.1 2026/10/19 00:00:00 jnelson Exp $ */
+/*
+ * profile.c -- Where does all the script time go?
+ *
+ * Copyright 2026 EPIC Software Labs
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notices, the above paragraph (the one permitting redistribution),
+ *    this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The names of the author(s) may not be used to endorse or promote
+ *    products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/*
+ * The profiler keeps track of every alias, $function(), /ON and /TIMER
+ * that runs while it is turned on.  For each of them it counts how many
+ * times it was called, how much time was spent in it (inclusive), and how
+ * much of that time was not spent in anything else it called (exclusive).
+ * Both wall clock time and cpu time are counted.
+ *
+ * It also keeps the exclusive time for each call stack ("alias:FOO;
+ * builtin:STRLEN"), which /PROFILE EXPORT writes out in the "folded"
+ * format that flamegraph.pl and most other flame graph tools read.
+ *
+ * The profiler costs one integer compare per call while it is off.
+ */
+#include "irc.h"
+#include "ircaux.h"
+#include "output.h"
+#include "functions.h"
+#include "alist.h"
+#include "reg.h"
+#include "profile.h"
+#include <sys/resource.h>
+
+typedef struct ProfileEntryStru
+{
+	char *		name;		/* "alias:FOO", etc */
+	u_32int_t	hash;		/* Used by alist.c */
+	long		calls;
+	int		active;		/* How many calls are on the stack */
+	double		incl_wall;
+	double		excl_wall;
+	double		incl_cpu;
+	double		excl_cpu;
+} ProfileEntry;
+
+typedef struct ProfileStackStru
+{
+	char *		name;		/* "alias:FOO;builtin:STRLEN" */
+	u_32int_t	hash;		/* Used by alist.c */
+	double		excl_wall;
+} ProfileStack;
+
+typedef struct ProfileFrameStru
+{
+	ProfileEntry *	entry;		/* NULL after a /PROFILE RESET */
+	double		start_wall;
+	double		start_cpu;
+	double		child_wall;
+	double		child_cpu;
+	size_t		path_len;	/* Length of 'path' before this call */
+} ProfileFrame;
+
+	int		profiling = 0;
+static	array		entries = { NULL, 0, 0, strncmp, HASH_SENSITIVE };
+static	array		stacks = { NULL, 0, 0, strncmp, HASH_SENSITIVE };
+static	ProfileFrame *	frames = NULL;
+static	int		depth = 0;
+static	int		max_depth = 0;
+static	char *		path = NULL;
+static	size_t		path_len = 0;
+static	size_t		path_size = 0;
+static	double		started = 0;		/* When we last started */
+static	double		total_wall = 0;		/* Time spent turned on */
+
+static const char *	kind_names[] = {
+	"alias", "function", "builtin", "on", "timer"
+};
+
+static double	wall_time (void)
+{
+	Timeval	t;
+
+	get_time(&t);
+	return (double)t.tv_sec + (double)t.tv_usec / 1000000.0;
+}
+
+static double	cpu_time (void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_PROCESS_CPUTIME_ID)
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+#else
+	struct rusage	r;
+
+	getrusage(RUSAGE_SELF, &r);
+	return (double)(r.ru_utime.tv_sec + r.ru_stime.tv_sec) +
+		(double)(r.ru_utime.tv_usec + r.ru_stime.tv_usec) / 1000000.0;
+#endif
+}
+
+static ProfileEntry *	get_profile_entry (const char *name)
+{
+	ProfileEntry *	e;
+	int	cnt, loc;
+
+	e = (ProfileEntry *)find_array_item(&entries, name, &cnt, &loc);
+	if (e && cnt < 0)
+		return e;
+
+	e = (ProfileEntry *)new_malloc(sizeof(ProfileEntry));
+	e->name = malloc_strdup(name);
+	e->calls = 0;
+	e->active = 0;
+	e->incl_wall = e->excl_wall = 0;
+	e->incl_cpu = e->excl_cpu = 0;
+	add_to_array(&entries, (array_item *)e);
+	return e;
+}
+
+static void	add_stack_time (const char *name, double wall)
+{
+	ProfileStack *	s;
+	int	cnt, loc;
+
+	s = (ProfileStack *)find_array_item(&stacks, name, &cnt, &loc);
+	if (!s || cnt >= 0)
+	{
+		s = (ProfileStack *)new_malloc(sizeof(ProfileStack));
+		s->name = malloc_strdup(name);
+		s->excl_wall = 0;
+		add_to_array(&stacks, (array_item *)s);
+	}
+	s->excl_wall += wall;
+}
+
+/*
+ * profile_enter: Note that something is about to be run.  'name' is the
+ * name of the alias, function, hook type, or timer refnum.  'serial' is
+ * only used for PROFILE_HOOK.  You must pass the return value to
+ * profile_leave() when it is done running, even if the profiler was
+ * turned off in the meantime.
+ */
+int	profile_enter (enum ProfileKind kind, const char *name, int serial)
+{
+	char		buffer[BIG_BUFFER_SIZE];
+	ProfileFrame *	f;
+	size_t		len;
+	char *		p;
+
+	if (!profiling)
+		return 0;
+
+	if (kind == PROFILE_HOOK)
+		snprintf(buffer, sizeof buffer, "%s:%s/%d",
+				kind_names[kind], name, serial);
+	else
+		snprintf(buffer, sizeof buffer, "%s:%s",
+				kind_names[kind], name ? name : "<lambda>");
+
+	/* The folded stack format uses ; and spaces */
+	for (p = buffer; *p; p++)
+		if (*p == ';' || isspace(*p))
+			*p = '_';
+
+	if (depth >= max_depth)
+	{
+		max_depth = max_depth ? max_depth * 2 : 16;
+		RESIZE(frames, ProfileFrame, max_depth);
+	}
+
+	f = &frames[depth++];
+	f->entry = get_profile_entry(buffer);
+	f->entry->calls++;
+	f->entry->active++;
+	f->child_wall = f->child_cpu = 0;
+	f->path_len = path_len;
+
+	len = strlen(buffer);
+	if (path_len + len + 2 > path_size)
+	{
+		path_size = (path_len + len + 2) * 2;
+		RESIZE(path, char, path_size);
+	}
+	if (path_len)
+		path[path_len++] = ';';
+	strlcpy(path + path_len, buffer, path_size - path_len);
+	path_len += len;
+
+	/* Do this last so the profiler doesn't count itself */
+	f->start_cpu = cpu_time();
+	f->start_wall = wall_time();
+	return 1;
+}
+
+/*
+ * profile_leave: Note that what profile_enter() was told about is done.
+ */
+void	profile_leave (int entered)
+{
+	ProfileFrame *	f;
+	double		wall, cpu;
+
+	if (!entered || depth == 0)
+		return;
+
+	f = &frames[--depth];
+	wall = wall_time() - f->start_wall;
+	cpu = cpu_time() - f->start_cpu;
+
+	if (f->entry)
+	{
+		/* Recursive calls are already counted by the outermost call */
+		if (--f->entry->active == 0)
+		{
+			f->entry->incl_wall += wall;
+			f->entry->incl_cpu += cpu;
+		}
+		f->entry->excl_wall += wall - f->child_wall;
+		f->entry->excl_cpu += cpu - f->child_cpu;
+		add_stack_time(path, wall - f->child_wall);
+	}
+
+	if (f->path_len <= path_len)
+		path[path_len = f->path_len] = 0;
+
+	if (depth > 0)
+	{
+		frames[depth - 1].child_wall += wall;
+		frames[depth - 1].child_cpu += cpu;
+	}
+}
+
+static void	profile_start (void)
+{
+	if (profiling)
+		return;
+	profiling = 1;
+	started = wall_time();
+}
+
+static void	profile_stop (void)
+{
+	if (!profiling)
+		return;
+	profiling = 0;
+	total_wall += wall_time() - started;
+}
+
+static void	profile_reset (void)
+{
+	array_item *	item;
+	int	i;
+
+	while ((item = array_pop(&entries, 0)))
+	{
+		new_free(&item->name);
+		new_free(&item);
+	}
+	while ((item = array_pop(&stacks, 0)))
+	{
+		new_free(&item->name);
+		new_free(&item);
+	}
+
+	/* Anything still running won't be counted */
+	for (i = 0; i < depth; i++)
+	{
+		frames[i].entry = NULL;
+		frames[i].path_len = 0;
+	}
+	path_len = 0;
+	if (path)
+		*path = 0;
+
+	total_wall = 0;
+	if (profiling)
+		started = wall_time();
+}
+
+static double	profile_elapsed (void)
+{
+	if (profiling)
+		return total_wall + wall_time() - started;
+	return total_wall;
+}
+
+static int	compare_sort_key = 0;
+
+static int	compare_entries (const void *a, const void *b)
+{
+	const ProfileEntry *	x = *(const ProfileEntry * const *)a;
+	const ProfileEntry *	y = *(const ProfileEntry * const *)b;
+	double	diff;
+
+	switch (compare_sort_key)
+	{
+		case 0:	diff = y->excl_wall - x->excl_wall; break;
+		case 1:	diff = y->incl_wall - x->incl_wall; break;
+		case 2:	diff = y->excl_cpu - x->excl_cpu; break;
+		case 3:	diff = y->incl_cpu - x->incl_cpu; break;
+		case 4:	diff = (double)(y->calls - x->calls); break;
+		default: diff = 0; break;
+	}
+
+	if (diff < 0)
+		return -1;
+	else if (diff > 0)
+		return 1;
+	return strcmp(x->name, y->name);
+}
+
+static const char *	sort_keys[] = {
+	"EXCLUSIVE", "INCLUSIVE", "CPU", "INCLUSIVE_CPU", "CALLS", "NAME", NULL
+};
+
+static int	find_sort_key (const char *key)
+{
+	int	i;
+
+	for (i = 0; sort_keys[i]; i++)
+		if (!my_stricmp(key, sort_keys[i]))
+			return i;
+	return -1;
+}
+
+/*
+ * Returns the entries that match 'mask', sorted by 'key'.  The caller
+ * must new_free() the return value.
+ */
+static ProfileEntry **	sorted_entries (int key, const char *mask, int *count)
+{
+	ProfileEntry **	list;
+	int	i;
+
+	list = (ProfileEntry **)new_malloc(sizeof(ProfileEntry *) *
+						(entries.max + 1));
+	for (*count = i = 0; i < entries.max; i++)
+	{
+		ProfileEntry *e = (ProfileEntry *)ARRAY_ITEM(&entries, i);
+
+		if (mask && !wild_match(mask, e->name))
+			continue;
+		list[(*count)++] = e;
+	}
+
+	compare_sort_key = key;
+	qsort(list, *count, sizeof(ProfileEntry *), compare_entries);
+	return list;
+}
+
+static void	profile_report (int key, int count, const char *mask)
+{
+	ProfileEntry **	list;
+	int	total, i;
+
+	list = sorted_entries(key, mask, &total);
+	say("Profile: %d entries, %.3f seconds profiled, sorted by %s",
+		total, profile_elapsed(), sort_keys[key]);
+	say("%10s %10s %10s %10s %10s  %s", "calls", "excl ms", "incl ms",
+		"cpu ms", "incl cpu", "name");
+	for (i = 0; i < total && (count <= 0 || i < count); i++)
+		say("%10ld %10.3f %10.3f %10.3f %10.3f  %s",
+			list[i]->calls,
+			list[i]->excl_wall * 1000.0,
+			list[i]->incl_wall * 1000.0,
+			list[i]->excl_cpu * 1000.0,
+			list[i]->incl_cpu * 1000.0,
+			list[i]->name);
+	new_free((char **)&list);
+}
+
+/*
+ * Write out each call stack and its exclusive time in microseconds, one
+ * per line, the way flamegraph.pl wants them.
+ */
+static int	profile_export (const char *filename)
+{
+	FILE *	fp;
+	Filename expanded;
+	int	i;
+
+	if (normalize_filename(filename, expanded))
+		return -1;
+	if (!(fp = fopen(expanded, "w")))
+		return -1;
+
+	for (i = 0; i < stacks.max; i++)
+	{
+		ProfileStack *s = (ProfileStack *)ARRAY_ITEM(&stacks, i);
+		long	usecs = (long)(s->excl_wall * 1000000.0 + 0.5);
+
+		if (usecs > 0)
+			fprintf(fp, "%s %ld\n", s->name, usecs);
+	}
+
+	fclose(fp);
+	return stacks.max;
+}
+
+/*
+ * /PROFILE			Tell whether the profiler is on
+ * /PROFILE START		Start counting
+ * /PROFILE STOP		Stop counting, but keep what has been counted
+ * /PROFILE RESET		Forget everything that has been counted
+ * /PROFILE REPORT [-SORT key] [-COUNT n] [pattern]
+ *	Show what has been counted, most expensive first.  The sort keys
+ *	are EXCLUSIVE (the default), INCLUSIVE, CPU, INCLUSIVE_CPU, CALLS
+ *	and NAME.  Only the first <n> entries are shown, and only those
+ *	entries whose names match the pattern (eg, "alias:*").
+ * /PROFILE EXPORT <filename>
+ *	Write the call stacks out for flamegraph.pl
+ */
+BUILT_IN_COMMAND(profilecmd)
+{
+	char *	arg;
+
+	if (!(arg = next_arg(args, &args)))
+	{
+		say("Profiler is %s (%d entries, %.3f seconds profiled)",
+			profiling ? "on" : "off", entries.max,
+			profile_elapsed());
+		return;
+	}
+
+	if (!my_stricmp(arg, "START"))
+	{
+		profile_start();
+		say("Profiler is on");
+	}
+	else if (!my_stricmp(arg, "STOP"))
+	{
+		profile_stop();
+		say("Profiler is off");
+	}
+	else if (!my_stricmp(arg, "RESET"))
+	{
+		profile_reset();
+		say("Profiler has been reset");
+	}
+	else if (!my_stricmp(arg, "REPORT"))
+	{
+		int	key = 0;
+		int	count = 0;
+		char *	mask = NULL;
+
+		while ((arg = next_arg(args, &args)))
+		{
+			if (!my_stricmp(arg, "-SORT"))
+			{
+				if (!(arg = next_arg(args, &args)) ||
+				    (key = find_sort_key(arg)) < 0)
+				{
+					say("Usage: /PROFILE REPORT -SORT "
+					    "EXCLUSIVE|INCLUSIVE|CPU|"
+					    "INCLUSIVE_CPU|CALLS|NAME");
+					return;
+				}
+			}
+			else if (!my_stricmp(arg, "-COUNT"))
+			{
+				if ((arg = next_arg(args, &args)))
+					count = my_atol(arg);
+			}
+			else
+				mask = arg;
+		}
+		profile_report(key, count, mask);
+	}
+	else if (!my_stricmp(arg, "EXPORT"))
+	{
+		int	total;
+
+		if (!(arg = new_next_arg(args, &args)))
+			say("Usage: /PROFILE EXPORT <filename>");
+		else if ((total = profile_export(arg)) < 0)
+			say("Couldn't write to %s: %s", arg, strerror(errno));
+		else
+			say("Wrote %d call stacks to %s", total, arg);
+	}
+	else
+		say("Usage: /PROFILE [START|STOP|RESET|REPORT|EXPORT]");
+}
+
+/*
+ * $profilectl(START)		Start counting; returns 1
+ * $profilectl(STOP)		Stop counting; returns 1
+ * $profilectl(RESET)		Forget everything; returns 1
+ * $profilectl(STATUS)		1 if the profiler is on, 0 if it is off
+ * $profilectl(ELAPSED)		Seconds the profiler has been on
+ * $profilectl(ENTRIES [key [pattern]])
+ *	The names of the entries that match pattern, sorted by key (as for
+ *	/PROFILE REPORT)
+ * $profilectl(GET <name> [ITEM])
+ *	ITEM is one of CALLS, EXCLUSIVE, INCLUSIVE, CPU or INCLUSIVE_CPU.
+ *	Times are in microseconds.
+ * $profilectl(EXPORT <filename>)
+ *	Write the call stacks for flamegraph.pl; returns how many there were
+ */
+BUILT_IN_FUNCTION(function_profilectl, input)
+{
+	char *	listc;
+
+	GET_FUNC_ARG(listc, input);
+	if (!my_stricmp(listc, "START")) {
+		profile_start();
+		RETURN_INT(1);
+	} else if (!my_stricmp(listc, "STOP")) {
+		profile_stop();
+		RETURN_INT(1);
+	} else if (!my_stricmp(listc, "RESET")) {
+		profile_reset();
+		RETURN_INT(1);
+	} else if (!my_stricmp(listc, "STATUS")) {
+		RETURN_INT(profiling);
+	} else if (!my_stricmp(listc, "ELAPSED")) {
+		double	elapsed = profile_elapsed();
+		RETURN_FLOAT(elapsed);
+	} else if (!my_stricmp(listc, "ENTRIES")) {
+		ProfileEntry **	list;
+		char *	key = NULL;
+		char *	mask = NULL;
+		char *	retval = NULL;
+		size_t	clue = 0;
+		int	sort = 0, total, i;
+
+		if (input && *input)
+		{
+			GET_FUNC_ARG(key, input);
+			if ((sort = find_sort_key(key)) < 0)
+				RETURN_EMPTY;
+		}
+		if (input && *input)
+			GET_FUNC_ARG(mask, input);
+
+		list = sorted_entries(sort, mask, &total);
+		for (i = 0; i < total; i++)
+			malloc_strcat_word_c(&retval, space, list[i]->name,
+						DWORD_NO, &clue);
+		new_free((char **)&list);
+		RETURN_MSTR(retval);
+	} else if (!my_stricmp(listc, "GET")) {
+		ProfileEntry *	e;
+		char *	name;
+		char *	item;
+		int	cnt, loc;
+
+		GET_FUNC_ARG(name, input);
+		e = (ProfileEntry *)find_array_item(&entries, name, &cnt, &loc);
+		if (!e || cnt >= 0)
+			RETURN_EMPTY;
+
+		GET_FUNC_ARG(item, input);
+		if (!my_stricmp(item, "CALLS"))
+			RETURN_INT(e->calls);
+		else if (!my_stricmp(item, "EXCLUSIVE"))
+			RETURN_INT((long)(e->excl_wall * 1000000.0));
+		else if (!my_stricmp(item, "INCLUSIVE"))
+			RETURN_INT((long)(e->incl_wall * 1000000.0));
+		else if (!my_stricmp(item, "CPU"))
+			RETURN_INT((long)(e->excl_cpu * 1000000.0));
+		else if (!my_stricmp(item, "INCLUSIVE_CPU"))
+			RETURN_INT((long)(e->incl_cpu * 1000000.0));
+	} else if (!my_stricmp(listc, "EXPORT")) {
+		char *	filename;
+		int	total;
+
+		GET_DWORD_ARG(filename, input);
+		if ((total = profile_export(filename)) < 0)
+			RETURN_EMPTY;
+		RETURN_INT(total);
+	}
+
+	RETURN_EMPTY;
+}
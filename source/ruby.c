@@ -39,6 +39,7 @@
 #include "functions.h"
 #include "output.h"
 #include "ifcmd.h"
+#include "hook.h"
 #include "extlang.h"
 #include <ruby.h>
 
@@ -98,6 +99,31 @@ static VALUE epic_call (VALUE module, VALUE string)
 	return rb_str_new(funcval, strlen(funcval));
 }
 
+static	char *	ruby_hook (int, const char *);
+
+static VALUE epic_on (int argc, VALUE *argv, VALUE module)
+{
+	VALUE	x, y, z;
+	char *	desc;
+	int	handle, userial = -1;
+
+	if (argc < 3 || argc > 4)
+		rb_raise(rb_eArgError, "EPIC.on(type, nick, method [, serial])");
+
+	x = rb_obj_as_string(argv[0]);
+	y = rb_obj_as_string(argv[1]);
+	z = rb_obj_as_string(argv[2]);
+	if ((handle = ruby_handle(STR2CSTR(z))) != -1)
+	{
+		desc = malloc_sprintf(NULL, "ruby method %s", STR2CSTR(z));
+		userial = add_callback_hook(STR2CSTR(x), 
+					argc > 3 ? NUM2INT(argv[3]) : 0,
+					STR2CSTR(y), ruby_hook, handle, desc);
+		new_free(&desc);
+	}
+	return INT2NUM(userial);
+}
+
 /* Called by the epic hooks to activate tcl on-demand. */
 void ruby_startstop (int value)
 {
@@ -127,6 +153,7 @@ void ruby_startstop (int value)
 	rb_define_singleton_method(rubyclass, "eval", epic_eval, 1);
 	rb_define_singleton_method(rubyclass, "expr", epic_expr, 1);
 	rb_define_singleton_method(rubyclass, "call", epic_call, 1);
+	rb_define_singleton_method(rubyclass, "on", epic_on, -1);
 	rb_gc_register_address(&rubyclass);
 
 	/* XXX Is it a hack to do it like this instead of in pure C? */
@@ -200,6 +227,118 @@ char *	rubyeval (char *input)
 	RETURN_STR(retval);	/* XXX Is this malloced or not? */
 }
 
+/*
+ * $ruby() and /RUBY parse their code every time.  A "handle" is a method
+ * that was looked up once; calling it is just rb_funcall2() with each 
+ * argument as its own string, so nothing gets parsed.
+ *	$rubyhandle(name)		Look up method 'name' and return a handle
+ *	$rubyinvoke(handle args)	Call it with each word of 'args'
+ *	EPIC.on(type, nick, name [, serial])
+ *					Call method 'name' for /ON TYPE "NICK"
+ * 'name' is either a top level method ("foo") or a receiver and a
+ * method ("MyScript.foo").  The receiver is only evaluated once.
+ */
+struct ruby_call {
+	VALUE	recv;
+	ID	method;
+	int	argc;
+	VALUE *	argv;
+};
+
+static	VALUE	ruby_handle_recvs;		/* Kept from the GC */
+static	ID *	ruby_handle_methods = NULL;
+static	char **	ruby_handle_names = NULL;
+static	int	ruby_handle_count = 0;
+
+static VALUE	internal_rubycall (VALUE *a)
+{
+	struct ruby_call *c = (struct ruby_call *)a;
+
+	return rb_funcall2(c->recv, c->method, c->argc, c->argv);
+}
+
+int	ruby_handle (const char *name)
+{
+	char *	recvname;
+	char *	methname;
+	VALUE	recv;
+	ID	method;
+	int	i;
+
+	if (!name || !*name)
+		return -1;
+
+	ruby_startstop(1);
+	for (i = 0; i < ruby_handle_count; i++)
+		if (!strcmp(ruby_handle_names[i], name))
+			return i;
+
+	recvname = LOCAL_COPY(name);
+	if ((methname = strrchr(recvname, '.')))
+	{
+		*methname++ = 0;
+		recv = rb_rescue2(internal_rubyeval, (VALUE)recvname, 
+					eval_failed, 0, rb_eException, 0);
+		method = rb_intern(methname);
+		if (!rb_respond_to(recv, method))
+			return -1;
+	}
+	else
+	{
+		/* Top level "def"s are private, so ask about those too */
+		recv = rb_eval_string("self");
+		method = rb_intern(recvname);
+		if (!RTEST(rb_funcall(recv, rb_intern("respond_to?"), 2, 
+					ID2SYM(method), Qtrue)))
+			return -1;
+	}
+
+	if (ruby_handle_count == 0)
+	{
+		ruby_handle_recvs = rb_ary_new();
+		rb_gc_register_address(&ruby_handle_recvs);
+	}
+	rb_ary_push(ruby_handle_recvs, recv);
+	RESIZE(ruby_handle_methods, ID, ruby_handle_count + 1);
+	RESIZE(ruby_handle_names, char *, ruby_handle_count + 1);
+	ruby_handle_methods[ruby_handle_count] = method;
+	ruby_handle_names[ruby_handle_count] = malloc_strdup(name);
+	return ruby_handle_count++;
+}
+
+char *	ruby_invoke (int handle, int argc, char **argv)
+{
+	struct ruby_call c;
+	VALUE	rubyval;
+	int	i;
+
+	if (handle < 0 || handle >= ruby_handle_count)
+		RETURN_EMPTY;
+
+	c.recv = rb_ary_entry(ruby_handle_recvs, handle);
+	c.method = ruby_handle_methods[handle];
+	c.argc = argc;
+	c.argv = (VALUE *)alloca(sizeof(VALUE) * (argc + 1));
+	for (i = 0; i < argc; i++)
+		c.argv[i] = rb_str_new(argv[i], strlen(argv[i]));
+
+	rubyval = rb_rescue2(internal_rubycall, (VALUE)&c, 
+				eval_failed, 0, rb_eException, 0);
+	if (rubyval == Qnil)
+		RETURN_EMPTY;
+	rubyval = rb_obj_as_string(rubyval);
+	return malloc_strdup(STR2CSTR(rubyval));
+}
+
+/* A hooked method gets $* of the event as its only argument */
+static char *	ruby_hook (int handle, const char *args)
+{
+	char *	argv[1];
+
+	argv[0] = (char *)args;
+	return ruby_invoke(handle, 1, argv);
+}
+
 /*
  * The /RUBY function: Evalulate the args as a RUBY block and ignore the 
  * return value of the statement.
@@ -40,6 +40,7 @@
  */
 
 #define __need_putchar_x__
+#define __need_term_flush__
 #include "irc.h"
 #include "alias.h"
 #include "clock.h"
@@ -61,6 +62,7 @@
 #include "commands.h"
 #include "parse.h"
 #include "newio.h"
+#include "timer.h"
 #include <sys/ioctl.h>
 
 #define CURRENT_WSERV_VERSION	4
@@ -126,9 +128,26 @@ static int 	rite 		(Window *, const unsigned char *);
 static void 	scroll_window   (Window *);
 static void 	add_to_window	(Window *, const unsigned char *);
 static	int	ok_to_output	(Window *);
+static	void	remember_row	(Window *, int, const unsigned char *);
+static	void	scroll_rows	(Window *, int);
+static	void	schedule_frame	(void);
+static	int	draw_frames	(void *);
 static ssize_t read_esc_seq     (const unsigned char *, void *, int *);
 static ssize_t read_color_seq   (const unsigned char *, void *d, int);
 static	void translate_user_input (char byte);
+static	void add_to_paste (Screen *screen, char byte);
+static	void flush_paste (Screen *screen);
+static	void release_paste_match (Screen *screen);
+static	int	paste_match_timeout (void *);
+
+/* The markers around a bracketed paste */
+static	const char	paste_start[] = "\033[200~";
+static	const char	paste_end[] = "\033[201~";
+#define PASTE_MARKER_LEN	6
+static	const char	paste_timeref[] = "PASTETIM";
+
+/* While this is set, output is drawn in frames even at /SET FRAME_RATE 0 */
+static	int	frames_held = 0;
 
 /*
  * "Attributes" were an invention for epic5, and the general idea was
@@ -1979,7 +1998,10 @@ static int 	rite (Window *window, const unsigned char *str)
 	scroll_window(window);
 
 	if (window->screen && window->display_lines)
+	{
 		output_with_count(str, 1, foreground);
+		remember_row(window, window->cursor, str);
+	}
 
 	window->cursor++;
 	return 0;
@@ -2277,6 +2299,7 @@ static void 	add_to_window (Window *window, const unsigned char *str)
         int             cols;
 	int		numl = 0;
 	intmax_t	refnum;
+	int		framed;
 
 	if (get_server_redirect(window->server))
 		if (redirect_text(window->server, 
@@ -2318,11 +2341,18 @@ static void 	add_to_window (Window *window, const unsigned char *str)
 	/* Add to scrollback + display... */
 	cols = window->my_columns - 1;
 	strval = new_normalize_string(str, 0, display_line_mangler);
+	framed = ((frames_held || get_int_var(FRAME_RATE_VAR) > 0) && 
+			window->screen && foreground && !dumb_mode);
         for (my_lines = prepare_display(window->refnum, strval, cols, &numl, 0); *my_lines; my_lines++)
 	{
 		if (add_to_scrollback(window, *my_lines, refnum))
 		    if (ok_to_output(window))
-			rite(window, *my_lines);
+		    {
+			if (framed)
+				window->frame_dirty = 1;
+			else
+				rite(window, *my_lines);
+		    }
 	}
 	new_free(&strval);
 
@@ -2330,8 +2360,17 @@ static void 	add_to_window (Window *window, const unsigned char *str)
 	check_window_cursor(window);
 	trim_scrollback(window);
 
-	cursor_in_display(window);
-	cursor_to_input();
+	/* Nothing was drawn; the next frame will take care of it */
+	if (framed && window->frame_dirty)
+	{
+		if (!frames_held)
+			schedule_frame();
+	}
+	else
+	{
+		cursor_in_display(window);
+		cursor_to_input();
+	}
 
 	/*
 	 * Handle special cases for output to hidden windows -- A beep to
@@ -2359,7 +2398,7 @@ static void 	add_to_window (Window *window, const unsigned char *str)
 	    	do_hook(WINDOW_NOTIFIED_LIST, "%u %s", window->refnum, level_to_str(who_level));
 		if (window->notify_when_hidden)
 			type = "Activity";
-		update_all_status();
+		update_all_status_for(STATUS_DEP_ACTIVITY);
 	    }
 
 	    if (type)
@@ -2489,6 +2528,7 @@ static void 	scroll_window (Window *window)
 			term_scroll(window->top,
 				window->top + window->cursor - 1, 
 				scroll);
+			scroll_rows(window, scroll);
 		}
 
 		/* Adjust the cursor */
@@ -2551,6 +2591,28 @@ int 	is_cursor_in_display (Screen *screen)
 
 
 /* * * * * * * SCREEN UDPATING AND RESIZING * * * * * * * * */
+/*
+ * window_display_top: Which line is at the top of the window's body?
+ * That depends on whether it's scrolling, holding, or in scrollback.
+ */
+static Display *window_display_top (Window *window)
+{
+	if (window->scrollback_distance_from_display_ip > window->holding_distance_from_display_ip)
+	{
+	    if (window->scrolling_distance_from_display_ip >= window->scrollback_distance_from_display_ip)
+		return window->scrolling_top_of_display;
+	    else
+		return window->scrollback_top_of_display;
+	}
+	else
+	{
+	    if (window->scrolling_distance_from_display_ip >= window->holding_distance_from_display_ip)
+		return window->scrolling_top_of_display;
+	    else
+		return window->holding_top_of_display;
+	}
+}
+
 /*
  * repaint_window_body: redraw the entire window's scrollable region
  * The old logic for doing a partial repaint has been removed with prejudice.
@@ -2567,21 +2629,8 @@ void 	repaint_window_body (Window *window)
 		return;
 
 	global_beep_ok = 0;		/* Suppress beeps */
-
-	if (window->scrollback_distance_from_display_ip > window->holding_distance_from_display_ip)
-	{
-	    if (window->scrolling_distance_from_display_ip >= window->scrollback_distance_from_display_ip)
-		curr_line = window->scrolling_top_of_display;
-	    else
-		curr_line = window->scrollback_top_of_display;
-	}
-	else
-	{
-	    if (window->scrolling_distance_from_display_ip >= window->holding_distance_from_display_ip)
-		curr_line = window->scrolling_top_of_display;
-	    else
-		curr_line = window->holding_top_of_display;
-	}
+	window->frame_dirty = 0;
+	curr_line = window_display_top(window);
 
 	if (window->screen && window->toplines_showing)
 	    for (count = 0; count < window->toplines_showing; count++)
@@ -2629,6 +2678,7 @@ void 	repaint_window_body (Window *window)
 			{
 				term_clear_to_eol();
 				term_newline();
+				remember_row(window, count, empty_string);
 			}
 			break;
 		}
@@ -2640,6 +2690,222 @@ void 	repaint_window_body (Window *window)
 }
 
 
+/* * * * * * * * * * * * * * * * FRAMES * * * * * * * * * * * * * * * * * */
+/*
+ * When /SET FRAME_RATE is more than 0, output to a visible window isn't
+ * drawn right away.  Instead the window is marked "frame_dirty", and no
+ * more than FRAME_RATE times a second, draw_frames() brings all of the
+ * dirty windows up to date at once.
+ *
+ * To keep that cheap, every window remembers what each row of its body
+ * is showing (window->shown).  A frame only redraws the rows that are
+ * different, and if the body just moved up (as it does when output is
+ * coming in), the terminal is told to scroll and only the new rows at
+ * the bottom are drawn.  So a burst of a thousand lines costs one frame
+ * instead of a thousand scrolls.  The frame is flushed to the terminal
+ * all at once by cursor_to_input().
+ */
+static	const char	frame_timeref[] = "FRAMETIM";
+static	Timeval		last_frame = {0, 0};
+
+/*
+ * forget_window_rows: Throw away what we think the window's rows show.
+ * The next frame will redraw all of them.
+ */
+void	forget_window_rows (Window *window)
+{
+	int	i;
+
+	for (i = 0; i < window->shown_rows; i++)
+		new_free(&window->shown[i]);
+	new_free((char **)&window->shown);
+	window->shown_rows = 0;
+}
+
+/* Make sure the window has one remembered row for each row of its body */
+static void	size_window_rows (Window *window)
+{
+	int	i;
+
+	if (window->shown && window->shown_rows == window->display_lines)
+		return;
+
+	forget_window_rows(window);
+	if (window->display_lines <= 0)
+		return;
+
+	window->shown_rows = window->display_lines;
+	window->shown = (unsigned char **)new_malloc(sizeof(unsigned char *) * 
+						window->shown_rows);
+	for (i = 0; i < window->shown_rows; i++)
+		window->shown[i] = NULL;
+}
+
+/* rite() just drew 'str' on 'row' of the window's body */
+static void	remember_row (Window *window, int row, const unsigned char *str)
+{
+	if (!window->shown || row < 0 || row >= window->shown_rows)
+		return;
+	malloc_strcpy((char **)&window->shown[row], (const char *)str);
+}
+
+/* term_scroll() just moved the window's body up 'n' rows */
+static void	scroll_rows (Window *window, int n)
+{
+	int	i;
+
+	if (!window->shown)
+		return;
+
+	if (n >= window->shown_rows)
+		n = window->shown_rows;
+	for (i = 0; i < n; i++)
+		new_free(&window->shown[i]);
+	memmove(window->shown, window->shown + n, 
+			sizeof(unsigned char *) * (window->shown_rows - n));
+	for (i = window->shown_rows - n; i < window->shown_rows; i++)
+		window->shown[i] = NULL;
+}
+
+static int	same_row (const unsigned char *shown, const unsigned char *want)
+{
+	return (shown && !strcmp((const char *)shown, (const char *)want));
+}
+
+/*
+ * draw_window_frame: Bring the window's body up to date, redrawing
+ * as few rows as possible.
+ */
+static void	draw_window_frame (Window *window)
+{
+	const unsigned char **want;
+	Display *curr_line;
+	int	rows, used, row, n, i;
+
+	if (dumb_mode || !window->screen || !foreground)
+		return;
+	if ((rows = window->display_lines) <= 0)
+		return;
+
+	size_window_rows(window);
+	output_screen = window->screen;
+	global_beep_ok = 0;		/* Suppress beeps */
+
+	/* What should each row show? */
+	want = (const unsigned char **)alloca(sizeof(unsigned char *) * rows);
+	curr_line = window_display_top(window);
+	for (used = 0; used < rows && curr_line != window->display_ip; used++)
+	{
+		want[used] = curr_line->line;
+		curr_line = curr_line->next;
+	}
+	for (row = used; row < rows; row++)
+		want[row] = empty_string;
+
+	/*
+	 * If what's at the top of the window now was 'n' rows down in the
+	 * last frame, and everything below it still used up, then just
+	 * scroll the terminal up and let the loop below fill in the bottom.
+	 */
+	for (n = 1; n < rows; n++)
+	{
+		if (!same_row(window->shown[n], want[0]))
+			continue;
+		for (i = 1; i < rows - n; i++)
+			if (!same_row(window->shown[n + i], want[i]))
+				break;
+		if (i == rows - n)
+		{
+			term_scroll(window->top, window->top + rows - 1, n);
+			scroll_rows(window, n);
+			break;
+		}
+	}
+
+	for (row = 0; row < rows; row++)
+	{
+		if (same_row(window->shown[row], want[row]))
+			continue;
+		window->screen->cursor_window = window;
+		term_move_cursor(0, window->top + row);
+		output_with_count(want[row], 1, foreground);
+		remember_row(window, row, want[row]);
+	}
+
+	window->cursor = used;
+	global_beep_ok = 1;
+}
+
+/* Draw a frame as soon as the frame rate allows */
+static void	schedule_frame (void)
+{
+	double	wait;
+
+	if (timer_exists(frame_timeref))
+		return;
+
+	wait = 1.0 / get_int_var(FRAME_RATE_VAR) - 
+			time_diff(last_frame, get_time(NULL));
+	if (wait < 0)
+		wait = 0;
+	add_timer(0, frame_timeref, wait, 1, draw_frames, NULL, NULL, 
+			GENERAL_TIMER, -1, 0);
+}
+
+static int	draw_frames (void *unused)
+{
+	Window	*window = NULL;
+	int	drew = 0;
+
+	get_time(&last_frame);
+
+	/* Get resizes and forced redraws out of the way first */
+	update_all_windows();
+
+	while (traverse_all_windows(&window))
+	{
+		if (!window->frame_dirty)
+			continue;
+		window->frame_dirty = 0;
+		if (!window->screen)
+			continue;
+
+		draw_window_frame(window);
+		drew++;
+	}
+
+	/* The frame goes to the terminal now, not at the next newline */
+	if (drew)
+	{
+		cursor_to_input();
+		term_flush();
+	}
+	return 0;
+}
+
+/*
+ * set_frame_rate: called by /SET FRAME_RATE.  When frames are turned off,
+ * anything still waiting is drawn right now, and the windows forget 
+ * what their rows show, because nothing will be keeping that up to date.
+ */
+void	set_frame_rate (void *stuff)
+{
+	VARIABLE *v = (VARIABLE *)stuff;
+	Window	*window = NULL;
+
+	if (v->integer < 0)
+		v->integer = 0;
+	if (v->integer > 0)
+		return;
+
+	if (timer_exists(frame_timeref))
+		remove_timer(frame_timeref);
+	draw_frames(NULL);
+
+	while (traverse_all_windows(&window))
+		forget_window_rows(window);
+}
+
 /* * * * * * * * * * * * * * SCREEN MANAGEMENT * * * * * * * * * * * * */
 /*
  * create_new_screen creates a new screen structure. with the help of
@@ -2686,6 +2952,11 @@ void	create_new_screen (void)
 	new_s->last_press.tv_sec = new_s->last_press.tv_usec  = 0;
 	new_s->last_key = NULL;
 	new_s->quote_hit = 0;
+	new_s->pasting = 0;
+	new_s->paste_match = 0;
+	new_s->paste_buffer = NULL;
+	new_s->paste_len = 0;
+	new_s->paste_size = 0;
 	new_s->fdout = 1;
 	new_s->fpout = stdout;
 #ifdef WITH_THREADED_STDOUT
@@ -3001,6 +3272,13 @@ void 	kill_screen (Screen *screen)
 		say("You may not kill the main screen");
 		return;
 	}
+
+#ifdef WITH_THREADED_STDOUT
+	/* Let what's been written go out before its descriptor does */
+	tio_close(screen->tio_file);
+	screen->tio_file = NULL;
+#endif
+
 	if (screen->fdin)
 	{
 		if (use_input)
@@ -3016,10 +3294,6 @@ void 	kill_screen (Screen *screen)
 		add_to_invisible_list(window);
 	}
 
-#ifdef WITH_THREADED_STDOUT
-	tio_close(screen->tio_file);
-#endif
-
 	/* Take out some of the garbage left around */
 	screen->current_window = NULL;
 	screen->window_list = NULL;
@@ -3033,6 +3307,9 @@ void 	kill_screen (Screen *screen)
 	screen->fdin = -1;
 	screen->fdout = -1;
 	new_free(&screen->input_prompt);
+	new_free(&screen->paste_buffer);
+	screen->paste_len = screen->paste_size = 0;
+	screen->pasting = 0;
 
 	/* Dont fool around. */
 	if (last_input_screen == screen)
@@ -3159,12 +3436,53 @@ static void 	do_screens (int fd)
 			parse_statement(buffer, 1, NULL);
 		}
 
-		/* Ordinary full screen input is handled one byte at a time */
+		/* 
+		 * Ordinary full screen input is handled one byte at a time,
+		 * except for bracketed pastes, which are collected up and 
+		 * handled all at once.  A read can end in the middle of a
+		 * paste marker, so we hold on to what might be the start of
+		 * ESC[200~ until the next read says whether it is (the end
+		 * marker is looked for at the end of the paste buffer, so it
+		 * takes care of itself).
+		 */
 		else if ((n = dgets(screen->fdin, buffer, 
 					BIG_BUFFER_SIZE, -1)) > 0)
 		{
 			for (i = 0; i < n; i++)
-				translate_user_input(buffer[i]);
+			{
+				if (screen->pasting)
+					add_to_paste(screen, buffer[i]);
+				else if (buffer[i] == 
+					    paste_start[screen->paste_match])
+				{
+				    if (++screen->paste_match == 
+							PASTE_MARKER_LEN)
+				    {
+					screen->paste_match = 0;
+					screen->pasting = 1;
+					screen->paste_len = 0;
+				    }
+				}
+				else
+				{
+				    release_paste_match(screen);
+				    if (buffer[i] == paste_start[0])
+					screen->paste_match = 1;
+				    else
+					translate_user_input(buffer[i]);
+				}
+			}
+
+			/*
+			 * If nothing else shows up soon, it was just an
+			 * escape key (or the like) and not a paste.
+			 */
+			if (screen->paste_match && 
+					!timer_exists(paste_timeref))
+				add_timer(0, paste_timeref, 
+					get_int_var(KEY_INTERVAL_VAR) / 1000.0,
+					1, paste_match_timeout, NULL, NULL, 
+					GENERAL_TIMER, -1, 0);
 		}
 
 		/* An EOF/error error on a wserv screen kills that screen */
@@ -3182,6 +3500,156 @@ static void 	do_screens (int fd)
 	from_server = saved_from_server;
 } 
 
+/* * * * * * * * * * * * * BRACKETED PASTE * * * * * * * * * * * * */
+/*
+ * When the terminal supports it (see /SET BRACKETED_PASTE), anything the
+ * user pastes arrives wrapped in ESC[200~ ... ESC[201~.  We save up the
+ * stuff in between and put it into the input line in one go when the
+ * paste is over, instead of running each byte through the keybindings
+ * and redrawing the input line every time.  Each newline in the paste
+ * does a SEND_LINE, just like it would have if it had been typed.
+ */
+static void	add_to_paste (Screen *screen, char byte)
+{
+	if (byte == 0)
+		return;
+
+	if (screen->paste_len + 1 >= screen->paste_size)
+	{
+		screen->paste_size = screen->paste_size * 2 + 256;
+		RESIZE(screen->paste_buffer, char, screen->paste_size);
+	}
+	screen->paste_buffer[screen->paste_len++] = byte;
+
+	if (screen->paste_len >= PASTE_MARKER_LEN && 
+	    !memcmp(screen->paste_buffer + screen->paste_len - PASTE_MARKER_LEN,
+			paste_end, PASTE_MARKER_LEN))
+	{
+		screen->paste_len -= PASTE_MARKER_LEN;
+		screen->pasting = 0;
+		flush_paste(screen);
+	}
+
+	/* Don't let a paste that never ends eat all of our memory */
+	else if (screen->paste_len >= INPUT_BUFFER_SIZE * 4 &&
+		 !memchr(screen->paste_buffer + screen->paste_len - 
+				PASTE_MARKER_LEN, '\033', PASTE_MARKER_LEN))
+		flush_paste(screen);
+}
+
+/*
+ * What we held back as the possible start of a paste marker wasn't one,
+ * so it's ordinary input after all.
+ */
+static void	release_paste_match (Screen *screen)
+{
+	int	i, len;
+
+	len = screen->paste_match;
+	screen->paste_match = 0;
+	for (i = 0; i < len; i++)
+		translate_user_input(paste_start[i]);
+}
+
+static int	paste_match_timeout (void *ignored)
+{
+	Screen *	oldscreen = last_input_screen;
+	Screen *	screen;
+	int		server = from_server;
+
+	for (screen = screen_list; screen; screen = screen->next)
+	{
+		if (!screen->alive || !screen->paste_match)
+			continue;
+
+		last_input_screen = screen;
+		output_screen = screen;
+		make_window_current(screen->current_window);
+		from_server = current_window->server;
+		release_paste_match(screen);
+	}
+
+	from_server = server;
+	output_screen = last_input_screen = oldscreen;
+	return 0;
+}
+
+static void	flush_paste (Screen *screen)
+{
+	char *	paste;
+	char *	line;
+	char *	next;
+	size_t	i;
+	int	batch;
+	int	old_status, old_input;
+	Window *window = NULL;
+
+	if (!screen->paste_buffer)
+		return;
+
+	/* Take ownership of it, in case SEND_LINE does something funny */
+	paste = screen->paste_buffer;
+	paste[screen->paste_len] = 0;
+	screen->paste_buffer = NULL;
+	screen->paste_len = screen->paste_size = 0;
+
+	/*
+	 * If someone is waiting for a keypress, or the user hit the
+	 * quote character, do it the old fashioned way.
+	 */
+	if (screen->quote_hit || (screen->promptlist && 
+			screen->promptlist->type != WAIT_PROMPT_LINE))
+	{
+		for (i = 0; paste[i]; i++)
+			translate_user_input(paste[i]);
+		new_free(&paste);
+		return;
+	}
+
+	/*
+	 * A paste of several lines is sent as a batch: the lines (and
+	 * whatever they cause to be output) all go out first, and then 
+	 * the screen is brought up to date once, as a frame.
+	 */
+	if ((batch = (strpbrk(paste, "\r\n") != NULL)))
+	{
+		frames_held++;
+		old_status = permit_status_update(0);
+		old_input = permit_input_update(0);
+	}
+
+	for (line = paste; line; line = next)
+	{
+		if ((next = strpbrk(line, "\r\n")))
+		{
+			if (next[0] == '\r' && next[1] == '\n')
+				*next++ = 0;
+			*next++ = 0;
+		}
+
+		input_insert_text(line, get_int_var(INSERT_MODE_VAR));
+		if (next)
+			send_line(0, NULL);
+	}
+
+	if (batch)
+	{
+		frames_held--;
+		permit_input_update(old_input);
+		permit_status_update(old_status);
+		update_all_status();
+		draw_frames(NULL);
+		update_input(NULL, UPDATE_ALL);
+
+		/* Nothing keeps the rows up to date without frames */
+		if (get_int_var(FRAME_RATE_VAR) == 0)
+			while (traverse_all_windows(&window))
+				forget_window_rows(window);
+	}
+
+	new_free(&paste);
+}
+
 /*
  * This function accumulates bytes of user input encoded in 
  * /SET INPUT_TRANSLATION and converts them to (UCS32) code points and
@@ -57,6 +57,7 @@
 #include "newio.h"
 #include "translat.h"
 #include "reg.h"
+#include "bench.h"
 
 /************************ SERVERLIST STUFF ***************************/
 
@@ -583,6 +584,15 @@ static	int	serverinfo_to_newserv (ServerInfo *si)
 
 	s->stricmp_table = 1;		/* By default, use rfc1459 */
 	s->funny_match = NULL;
+	s->cap_offered = NULL;
+	s->cap_enabled = NULL;
+	s->cap_negotiating = 0;
+	s->sync_tokens = 0;
+	s->sync_last.tv_sec = 0;
+	s->sync_last.tv_usec = 0;
+	s->join_keyed = NULL;
+	s->join_keys = NULL;
+	s->join_plain = NULL;
 
 	s->ssl_enabled = FALSE;
 
@@ -699,6 +709,11 @@ static 	void 	remove_from_server_list (int i)
 	new_free(&s->sent_nick);
 	new_free(&s->sent_body);
 	new_free(&s->funny_match);
+	new_free(&s->cap_offered);
+	new_free(&s->cap_enabled);
+	new_free(&s->join_keyed);
+	new_free(&s->join_keys);
+	new_free(&s->join_plain);
 	destroy_notify_list(i);
 	destroy_005(i);
 	reset_server_altnames(i, NULL);
@@ -1374,16 +1389,20 @@ something_broke:
 #ifdef HAVE_SSL
 		    /*
 		     * For SSL server connections, we have to take a little
-		     * detour.  First we start up the ssl connection, which
-		     * always returns before it completes.  Then we tell newio
-		     * to call the ssl connector when the fd is ready, and
-		     * change our status to tell us what we're doing.
+		     * detour.  First we tell newio to call the ssl connector
+		     * whenever the fd is ready, and then we start up the ssl
+		     * connection, which always returns before it completes.
+		     * Then we change our status to tell us what we're doing.
 		     */
 		    if (!my_stricmp(get_server_type(i), "IRC-SSL"))
 		    {
+			int	ssl_err;
+
+			new_open(des, do_server, NEWIO_SSL_CONNECT, 0, i);
+
 			/* XXX 'des' might not be both the vfd and channel! */
 			/* (ie, on systems where vfd != channel) */
-			int	ssl_err = startup_ssl(des, des);
+			ssl_err = startup_ssl(des, des);
 
 			/* SSL connection failed */
 			if (ssl_err == -1)
@@ -1403,7 +1422,6 @@ something_broke:
 			 * dgets().
 			 */
 			s->status = SERVER_SSL_CONNECTING;
-			new_open(des, do_server, NEWIO_SSL_CONNECT, 0, i);
 			break;
 		    }
 
@@ -1445,10 +1463,7 @@ return_from_ssl_detour:
 			goto something_broke;
 		    }
 
-		    /* 
-		     * This throws the /ON SSL_SERVER_CERT_LIST and makes
-		     * the socket blocking again.
-		     */
+		    /* This throws the /ON SSL_SERVER_CERT_LIST */
 		    if (ssl_connected(des) < 0)
 		    {
 			syserr(i, "ssl_connected() failed", retval);
@@ -1499,7 +1514,9 @@ return_from_ssl_detour:
 			    if (translation)
 				translate_from_server(buffer);
 			    parsing_server_index = i;
+			    bench_enter(BENCH_PARSE);
 			    parse_server(buffer, sizeof buffer);
+			    bench_leave(BENCH_PARSE);
 			    parsing_server_index = NOSERV;
 			    /* pop_message_from(l2); */
 			    break;
@@ -1551,6 +1568,10 @@ static void 	vsend_to_aserver (int refnum, const char *format, va_list args)
 	if (!(s = get_server(refnum)))
 		return;
 
+	/* Saved up JOINs have to go out before anything after them */
+	if (s->join_keyed || s->join_plain)
+		send_server_joins(refnum);
+
 	if (refnum != NOSERV && (des = s->des) != -1 && format)
 	{
 		/* Keep the results short, and within reason. */
@@ -1880,6 +1901,32 @@ int 	connect_to_server (int new_server)
 	return 0;			/* New connection established */
 }
 
+/*
+ * attach_to_server: Use 'des', which is already connected to something 
+ * that talks IRC, as server 'refnum's connection and register with it.
+ * 'callback' is what newio calls when 'des' is readable; it must end up
+ * calling do_server().  This is for "epic5 -R" (see bench.c).
+ */
+int	attach_to_server (int refnum, int des, void (*callback) (int))
+{
+	Server *s;
+
+	if (!(s = get_server(refnum)) || s->des != -1)
+		return -1;
+
+	set_server_status(refnum, SERVER_CONNECTING);
+	s->closing = 0;
+	s->des = des;
+	s->operator = 0;
+	if (!s->d_nickname)
+		malloc_strcpy(&s->d_nickname, nickname);
+
+	set_server_ssl_enabled(refnum, FALSE);
+	new_open(des, callback, NEWIO_RECV, 0, refnum);
+	register_server(refnum, s->d_nickname);
+	return 0;
+}
+
 int 	close_all_servers (const char *message)
 {
 	int i;
@@ -1933,6 +1980,11 @@ void	close_server (int refnum, const char *message)
 	destroy_waiting_channels(refnum);
 	destroy_server_channels(refnum);
 
+	/* Saved up JOINs are for this connection only (and not the QUIT) */
+	new_free(&s->join_keyed);
+	new_free(&s->join_keys);
+	new_free(&s->join_plain);
+
 	s->operator = 0;
 	new_free(&s->nickname);
 	new_free(&s->s_nickname);
@@ -2141,7 +2193,7 @@ void	update_user_mode (int refnum, const char *modes)
 		if (*modes == 'O' || *modes == 'o')
 			set_server_operator(from_server, onoff);
 	}
-	update_all_status();
+	update_all_status_for(STATUS_DEP_MODE);
 }
 
 void	reinstate_user_modes (void)
@@ -2215,6 +2267,23 @@ void	register_server (int refnum, const char *nick)
 		get_server_name(refnum), get_server_port(refnum));
 	from_server = ofs;
 
+	/*
+	 * The server holds off on registering us until we say CAP END,
+	 * so we have time to ask for capabilities first.  Servers that
+	 * don't do CAP just say "unknown command" and carry on.
+	 */
+	new_free(&s->cap_offered);
+	new_free(&s->cap_enabled);
+	s->cap_negotiating = 0;
+	notify_monitor_reset(refnum);
+	s->sync_last.tv_sec = 0;
+	s->sync_last.tv_usec = 0;
+	if (!empty(get_string_var(IRCV3_CAPABILITIES_VAR)))
+	{
+		s->cap_negotiating = 1;
+		send_to_aserver(refnum, "CAP LS 302");
+	}
+
 	if (!empty(s->info->password))
 	{
 		char *dequoted = NULL;
@@ -2340,6 +2409,7 @@ void  server_is_registered (int refnum, const char *itsname, const char *ourname
 	s->next_addr = NULL;
 
 	set_server_status(refnum, SERVER_SYNCING);
+	s->cap_negotiating = 0;
 
 	accept_server_nickname(refnum, ourname);
 	set_server_itsname(refnum, itsname);
@@ -2395,6 +2465,9 @@ void	server_is_unregistered (int refnum)
 		return;
 
 	destroy_005(refnum);
+	new_free(&s->cap_offered);
+	new_free(&s->cap_enabled);
+	s->cap_negotiating = 0;
 	set_server_status(refnum, SERVER_EOF);
 }
 
@@ -2698,7 +2771,7 @@ void	accept_server_nickname (int refnum, const char *nick)
 	if (refnum == primary_server)
 		strlcpy(nickname, nick, sizeof nickname);
 
-	update_all_status();
+	update_all_status_for(STATUS_DEP_NICK);
 }
 
 void	nickname_change_rejected (int refnum, const char *mynick)
@@ -3238,6 +3311,331 @@ static char *	get_server_altnames (int refnum)
 
 /*****************************************************************************/
 
+/* IRCv3 CAPABILITIES */
+/*
+ * Returns 1 if 'cap' is one of the words in 'list'.  CAP names are case
+ * sensitive, and in the CAP LS reply they may have "=value" on them.
+ */
+static int	cap_in_list (const char *list, const char *cap)
+{
+	char *	copy;
+	char *	word;
+	char *	eq;
+
+	if (!list)
+		return 0;
+
+	copy = LOCAL_COPY(list);
+	while ((word = next_arg(copy, &copy)))
+	{
+		if ((eq = strchr(word, '=')))
+			*eq = 0;
+		if (!strcmp(word, cap))
+			return 1;
+	}
+	return 0;
+}
+
+/* Remove 'cap' (and any "=value" it has) from the word list '*list' */
+static void	cap_remove_from_list (char **list, const char *cap)
+{
+	char *	copy;
+	char *	word;
+	char *	result = NULL;
+	size_t	clue = 0;
+
+	if (!*list)
+		return;
+
+	copy = LOCAL_COPY(*list);
+	while ((word = next_arg(copy, &copy)))
+	{
+		char *	eq;
+		size_t	len = (eq = strchr(word, '=')) ? 
+				(size_t)(eq - word) : strlen(word);
+
+		if (len == strlen(cap) && !strncmp(word, cap, len))
+			continue;
+		malloc_strcat_wordlist_c(&result, space, word, &clue);
+	}
+	new_free(list);
+	*list = result;
+}
+
+/* 1 if the server has ACKed 'cap' */
+int	get_server_cap (int refnum, const char *cap)
+{
+	Server *s;
+
+	if (!(s = get_server(refnum)))
+		return 0;
+	return cap_in_list(s->cap_enabled, cap);
+}
+
+/* Ask for whatever the user wants from 'offered' that we don't have yet */
+static int	server_cap_request (int refnum, const char *offered)
+{
+	Server *	s;
+	const char *	wanted;
+	char *	copy;
+	char *	cap;
+	char *	request = NULL;
+	size_t	clue = 0;
+
+	if (!(s = get_server(refnum)))
+		return 0;
+	if (!(wanted = get_string_var(IRCV3_CAPABILITIES_VAR)))
+		return 0;
+
+	copy = LOCAL_COPY(wanted);
+	while ((cap = next_arg(copy, &copy)))
+	{
+		if (cap_in_list(offered, cap) && !cap_in_list(s->cap_enabled, cap))
+			malloc_strcat_wordlist_c(&request, space, cap, &clue);
+	}
+
+	if (!request)
+		return 0;
+	send_to_aserver(refnum, "CAP REQ :%s", request);
+	new_free(&request);
+	return 1;
+}
+
+static void	server_cap_done (int refnum)
+{
+	Server *s;
+
+	if (!(s = get_server(refnum)) || !s->cap_negotiating)
+		return;
+	s->cap_negotiating = 0;
+	send_to_aserver(refnum, "CAP END");
+}
+
+/*
+ * server_cap: Handle a CAP reply from the server.
+ *	subcmd	- LS, ACK, NAK, NEW, DEL, or LIST
+ *	caps	- The list of capabilities
+ *	more	- 1 if the server said there is another line of LS coming
+ */
+void	server_cap (int refnum, const char *subcmd, const char *caps, int more)
+{
+	Server *s;
+	char *	copy;
+	char *	cap;
+	size_t	clue;
+
+	if (!(s = get_server(refnum)))
+		return;
+
+	if (x_debug & DEBUG_SERVER_CONNECT)
+		yell("Server [%d] CAP %s %s", refnum, subcmd, caps);
+
+	if (!strcmp(subcmd, "LS") || !strcmp(subcmd, "NEW"))
+	{
+		clue = s->cap_offered ? strlen(s->cap_offered) : 0;
+		malloc_strcat_wordlist_c(&s->cap_offered, space, caps, &clue);
+		if (more)
+			return;
+
+		/* Only ask during registration or when something new shows up */
+		if (!strcmp(subcmd, "LS") && !s->cap_negotiating)
+			return;
+		if (!server_cap_request(refnum, s->cap_offered))
+			server_cap_done(refnum);
+	}
+	else if (!strcmp(subcmd, "ACK"))
+	{
+		copy = LOCAL_COPY(caps);
+		while ((cap = next_arg(copy, &copy)))
+		{
+			if (*cap == '-')
+				cap_remove_from_list(&s->cap_enabled, cap + 1);
+			else if (!cap_in_list(s->cap_enabled, cap))
+			{
+				clue = s->cap_enabled ? strlen(s->cap_enabled) : 0;
+				malloc_strcat_wordlist_c(&s->cap_enabled, space, 
+								cap, &clue);
+			}
+		}
+		server_cap_done(refnum);
+	}
+	else if (!strcmp(subcmd, "NAK"))
+		server_cap_done(refnum);
+	else if (!strcmp(subcmd, "DEL"))
+	{
+		copy = LOCAL_COPY(caps);
+		while ((cap = next_arg(copy, &copy)))
+		{
+			cap_remove_from_list(&s->cap_enabled, cap);
+			cap_remove_from_list(&s->cap_offered, cap);
+		}
+	}
+}
+
+/* CHANNEL JOINS AND SYNCS */
+/*
+ * When you rejoin a lot of channels at once (reconnecting, or an autojoin
+ * script), sending a JOIN and then a MODE and a WHO for each one is a good
+ * way to get killed for flooding.  So JOINs are saved up and sent together
+ * as "JOIN #a,#b,#c" at the end of the trip through io() (or before the 
+ * next thing sent to the server, so nothing goes out of order), and the
+ * syncs are metered out (see take_server_sync_token()).
+ */
+	int	need_deferred_joins = 0;
+
+#define JOIN_LINE_LEN	400
+
+/*
+ * get_server_targmax: How many targets the server's TARGMAX says 
+ * 'command' can have.  0 means there's no limit, and -1 means the server
+ * didn't say (so it's up to you).
+ */
+int	get_server_targmax (int refnum, const char *command)
+{
+	const char *	targmax;
+	char *	copy;
+	char *	item;
+	char *	colon;
+
+	if (!(targmax = get_server_005(refnum, "TARGMAX")))
+		return -1;
+
+	copy = LOCAL_COPY(targmax);
+	while (copy && *copy)
+	{
+		item = next_in_comma_list(copy, &copy);
+		if (!(colon = strchr(item, ':')))
+			continue;
+		*colon++ = 0;
+		if (!my_stricmp(item, command))
+			return *colon ? atol(colon) : 0;
+	}
+	return -1;
+}
+
+/*
+ * server_queue_join: Join 'channel' (with 'key', if it has one) along with
+ * whatever else gets joined before the end of this trip through io().
+ */
+void	server_queue_join (int refnum, const char *channel, const char *key)
+{
+	Server *s;
+	int	max, count;
+	size_t	len;
+	const char *p;
+
+	if (!(s = get_server(refnum)))
+		return;
+
+	/* Send what we have if this one won't fit */
+	len = strlen(channel) + (key ? strlen(key) : 0) + 2;
+	if (s->join_keyed)
+		len += strlen(s->join_keyed) + strlen(s->join_keys);
+	if (s->join_plain)
+		len += strlen(s->join_plain);
+
+	count = 1;
+	for (p = s->join_keyed; p && *p; p++)
+		if (*p == ',')
+			count++;
+	for (p = s->join_plain; p && *p; p++)
+		if (*p == ',')
+			count++;
+	if (s->join_keyed)
+		count++;
+	if (s->join_plain)
+		count++;
+
+	max = get_server_targmax(refnum, "JOIN");
+	if (len > JOIN_LINE_LEN || (max > 0 && count > max))
+		send_server_joins(refnum);
+
+	/* Channels with keys have to come first */
+	if (key && *key)
+	{
+		malloc_strcat_wordlist_c(&s->join_keyed, ",", channel, NULL);
+		malloc_strcat_wordlist_c(&s->join_keys, ",", key, NULL);
+	}
+	else
+		malloc_strcat_wordlist_c(&s->join_plain, ",", channel, NULL);
+
+	need_deferred_joins = 1;
+}
+
+void	send_server_joins (int refnum)
+{
+	Server *s;
+	char *	keyed, *keys, *plain;
+
+	if (!(s = get_server(refnum)))
+		return;
+
+	/* Take them off first, because sending them comes back here. */
+	keyed = s->join_keyed;
+	keys = s->join_keys;
+	plain = s->join_plain;
+	s->join_keyed = s->join_keys = s->join_plain = NULL;
+
+	if (keyed && plain)
+		send_to_aserver(refnum, "JOIN %s,%s %s", keyed, plain, keys);
+	else if (keyed)
+		send_to_aserver(refnum, "JOIN %s %s", keyed, keys);
+	else if (plain)
+		send_to_aserver(refnum, "JOIN %s", plain);
+
+	new_free(&keyed);
+	new_free(&keys);
+	new_free(&plain);
+}
+
+void	send_deferred_joins (void)
+{
+	int	i;
+
+	need_deferred_joins = 0;
+	for (i = 0; i < number_of_servers; i++)
+		send_server_joins(i);
+}
+
+/*
+ * take_server_sync_token: Each channel sync (a MODE and then a WHO) costs
+ * one token.  The server has up to /SET CHANNEL_SYNC_BURST of them, and
+ * gets one back every /SET CHANNEL_SYNC_INTERVAL milliseconds.  Returns 0
+ * if the caller got a token and can sync now, or else how many seconds 
+ * until it can.
+ */
+double	take_server_sync_token (int refnum)
+{
+	Server *s;
+	Timeval	right_now;
+	int	burst, interval;
+
+	if (!(s = get_server(refnum)))
+		return 0;
+
+	burst = get_int_var(CHANNEL_SYNC_BURST_VAR);
+	interval = get_int_var(CHANNEL_SYNC_INTERVAL_VAR);
+	if (burst <= 0 || interval <= 0)
+		return 0;		/* No limit */
+
+	get_time(&right_now);
+	if (s->sync_last.tv_sec == 0)
+		s->sync_tokens = burst;
+	else
+		s->sync_tokens += time_diff(s->sync_last, right_now) * 
+					1000 / interval;
+	if (s->sync_tokens > burst)
+		s->sync_tokens = burst;
+	s->sync_last = right_now;
+
+	if (s->sync_tokens >= 1)
+	{
+		s->sync_tokens -= 1;
+		return 0;
+	}
+	return (1 - s->sync_tokens) * interval / 1000.0;
+}
+
 /* 005 STUFF */
 
 void make_005 (int refnum)
@@ -3395,6 +3793,9 @@ sorry_wrong_number:
  *	COOKIE		Our TS/4 cookie
  *	QUIT_MESSAGE	The quit message we will use next.
  *	SSL		Whether this server is SSL-enabled or not.
+ *	SSL_HANDSHAKES	How many SSL handshakes have completed. Read-only.
+ *	SSL_RESUMED	How many of those resumed an old session. Read-only.
+ *	SSL_HANDSHAKE_TIME How long the last SSL handshake took. Read-only.
  *      005             Individual PROTOCTL elements.
  *      005s            The full list of PROTOCTL elements.
  *	ALTNAME		An alternate server designation
@@ -3404,6 +3805,8 @@ sorry_wrong_number:
  *			(This is the only way to delete a designation)
  *	DEFAULT_REALNAME Default realname, used at next connect.
  *	REALNAME	Realname. Read-only.
+ *	CAPS		The IRCv3 capabilities the server ACKed. Read-only.
+ *	CAPS_OFFERED	The capabilities the server offered. Read-only.
  */
 char 	*serverctl 	(char *input)
 {
@@ -3447,6 +3850,10 @@ char 	*serverctl 	(char *input)
 		if (!my_strnicmp(listc, "AWAY", len)) {
 			ret = get_server_away(refnum);
 			RETURN_STR(ret);
+		} else if (!my_strnicmp(listc, "CAPS", len)) {
+			RETURN_STR(get_server(refnum)->cap_enabled);
+		} else if (!my_strnicmp(listc, "CAPS_OFFERED", len)) {
+			RETURN_STR(get_server(refnum)->cap_offered);
 		} else if (!my_strnicmp(listc, "MAXCACHESIZE", len)) {
 			num = get_server_max_cached_chan_size(refnum);
 			RETURN_INT(num);
@@ -3493,6 +3900,27 @@ char 	*serverctl 	(char *input)
 		} else if (!my_strnicmp(listc, "SSL", len)) {
 			ret = get_server_type(refnum);
 			RETURN_STR(ret);
+		} else if (!my_strnicmp(listc, "SSL_HANDSHAKES", len)) {
+			int	resumed;
+			double	last;
+
+			get_ssl_session_stats(get_server_name(refnum),
+				get_server_port(refnum), &num, &resumed, &last);
+			RETURN_INT(num);
+		} else if (!my_strnicmp(listc, "SSL_RESUMED", len)) {
+			int	handshakes;
+			double	last;
+
+			get_ssl_session_stats(get_server_name(refnum),
+				get_server_port(refnum), &handshakes, &num, &last);
+			RETURN_INT(num);
+		} else if (!my_strnicmp(listc, "SSL_HANDSHAKE_TIME", len)) {
+			int	handshakes, resumed;
+			double	last;
+
+			get_ssl_session_stats(get_server_name(refnum),
+				get_server_port(refnum), &handshakes, &resumed, &last);
+			return malloc_sprintf(NULL, "%f", last);
 		} else if (!my_strnicmp(listc, "UMODE", len)) {
 			ret = get_umode(refnum);
 			RETURN_STR(ret);
@@ -52,9 +52,11 @@
 #include "hook.h"
 #include "ssl.h"
 #include "newio.h"
+#include "server.h"
 
 static	int	firsttime = 1;
 static void	ssl_setup_locking (void);
+static SSL_CTX	*client_ctx = NULL;
 
 /*
  * SSL_CTX_init -- Create and set up a new SSL ConTeXt object.
@@ -86,6 +88,82 @@ static SSL_CTX	*SSL_CTX_init (int server)
 	return ctx;
 }
 
+/* * * * * * */
+/*
+ * Each server (host and port) we have made an SSL connection to gets one of
+ * these.  It holds on to the last SSL session the server gave us, so the
+ * next time we connect we can resume it instead of doing a full handshake,
+ * and it keeps track of how that's working out for $serverctl().
+ * These are never thrown away.
+ */
+typedef struct	ssl_session_T {
+	struct ssl_session_T *next;
+	char *		name;			/* "host:port" */
+	SSL_SESSION *	session;		/* Last session, or NULL */
+	int		handshakes;		/* Completed handshakes */
+	int		resumed;		/* How many were resumptions */
+	double		last_handshake;		/* Seconds the last one took */
+} ssl_session;
+
+static ssl_session *ssl_sessions = NULL;
+
+static ssl_session *	find_ssl_session (const char *host, int port, int create)
+{
+	ssl_session *s;
+	char	name[BIG_BUFFER_SIZE];
+
+	snprintf(name, sizeof name, "%s:%d", host ? host : empty_string, port);
+	for (s = ssl_sessions; s; s = s->next)
+		if (!my_stricmp(s->name, name))
+			return s;
+
+	if (!create)
+		return NULL;
+
+	s = new_malloc(sizeof(*s));
+	s->name = malloc_strdup(name);
+	s->session = NULL;
+	s->handshakes = 0;
+	s->resumed = 0;
+	s->last_handshake = 0;
+	s->next = ssl_sessions;
+	ssl_sessions = s;
+	return s;
+}
+
+static void	forget_ssl_session (ssl_session *s)
+{
+	if (s && s->session)
+	{
+		SSL_SESSION_free(s->session);
+		s->session = NULL;
+	}
+}
+
+/*
+ * get_client_ctx -- Return the one SSL ConTeXt all of our client 
+ *		     connections use.  Since the sessions all come out of
+ *		     the same context, the server will let us resume them.
+ *		     We keep the sessions ourselves (see ssl_session above)
+ *		     rather than let OpenSSL's cache do it, since its cache 
+ *		     doesn't know which server a session belongs to.
+ */
+static int	new_session_callback (SSL *, SSL_SESSION *);
+
+static SSL_CTX	*get_client_ctx (void)
+{
+	if (!client_ctx)
+	{
+		client_ctx = SSL_CTX_init(0);
+		SSL_CTX_set_mode(client_ctx, SSL_MODE_ENABLE_PARTIAL_WRITE |
+				SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+		SSL_CTX_set_session_cache_mode(client_ctx, 
+			SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+		SSL_CTX_sess_set_new_cb(client_ctx, new_session_callback);
+	}
+	return client_ctx;
+}
+
 /*
  * SSL_FD_init -- Create an SSL session on a given OS file descriptor using
  *		  an SSL ConTeXt template.
@@ -111,17 +189,51 @@ static SSL *SSL_FD_init (SSL_CTX *ctx, int channel)
 }
 
 /* * * * * * */
-typedef struct	ssl_info_T {
-	struct ssl_info_T *next;
-	int	active;
+/*
+ * Each vfd doing SSL has one of these, which newio keeps for us in its
+ * vfd table (see get_vfd_ssl()).  Nothing here ever blocks: when SSL can't 
+ * go on until the socket is readable or writable, we ask newio to call us
+ * back when it is.  Anything write_ssl() couldn't send right away waits
+ * in 'wbuf' until then.
+ */
+#define SSL_WRITE_BUFFER_MAX	(1024 * 1024)
 
+typedef struct	ssl_info_T {
 	int	vfd;
 	int	channel;
 	SSL_CTX	*ctx;
 	SSL *	ssl_fd;
+	ssl_session *session;		/* Where to keep our session */
+	Timeval	started;		/* When the handshake started */
+
+	char *	wbuf;			/* Data waiting to be SSL_write()n */
+	size_t	wbuf_size;
+	size_t	wbuf_start;		/* Where the unwritten data starts */
+	size_t	wbuf_end;		/* Where the unwritten data ends */
+	int	write_blocked;		/* What SSL_write() is waiting for */
+	int	read_blocked;		/* What SSL_read() is waiting for */
+	int	connect_blocked;	/* What SSL_connect() is waiting for */
 } ssl_info;
 
-ssl_info *ssl_list = NULL;
+/*
+ * new_session_callback -- OpenSSL calls this whenever the server gives us
+ *			   a session we could resume later.  With TLSv1.3 
+ *			   this can happen after the handshake is over.
+ * RETURN VALUE:
+ *	1 if we kept the session (we have to free it later)
+ *	0 if we didn't want it.
+ */
+static int	new_session_callback (SSL *ssl, SSL_SESSION *session)
+{
+	ssl_info *x;
+
+	if (!(x = (ssl_info *)SSL_get_app_data(ssl)) || !x->session)
+		return 0;
+
+	forget_ssl_session(x->session);
+	x->session->session = session;
+	return 1;
+}
 
 
 /*
@@ -135,13 +247,7 @@ ssl_info *ssl_list = NULL;
  */
 static ssl_info *	find_ssl (int vfd)
 {
-	ssl_info *x;
-
-	for (x = ssl_list; x; x = x->next)
-		if (x->vfd == vfd)
-			return x;
-
-	return NULL;
+	return (ssl_info *)get_vfd_ssl(vfd);
 }
 
 /*
@@ -150,66 +256,94 @@ static ssl_info *	find_ssl (int vfd)
  * ARGS: 
  *	vfd -- A virtual file descriptor, previously returned by new_open().
  * RETURN VALUE:
- *	If the vfd has never been previously set up to use SSL, a pointer to
- *		metadata for the vfd.  The 'channel', 'ctx' and 'ssl_fd'
- *		fields will not be filled in yet!
- *	If the vfd has previously been set up to use SSL, a pointer to the
- *		metadata for that vfd.  Existing information about the SSL
- *		connection on that vfd will be discarded!
+ *	If the vfd has been new_open()ed, a pointer to fresh metadata for
+ *		the vfd.  The 'channel', 'ctx' and 'ssl_fd' fields will 
+ *		not be filled in yet!  If the vfd was already set up to use
+ *		SSL, that connection is shut down first.
+ *	If the vfd has not been new_open()ed, NULL.
  */
 static ssl_info *	new_ssl_info (int vfd)
 {
 	ssl_info *x;
 
-	if (!(x = find_ssl(vfd)))
-	{
-		x = new_malloc(sizeof(*x));
-		x->next = ssl_list;
-		ssl_list = x;
-	}
+	if (find_ssl(vfd))
+		shutdown_ssl(vfd);
 
-	x->active = 0;
+	x = new_malloc(sizeof(*x));
 	x->vfd = vfd;
 	x->channel = -1;
 	x->ctx = NULL;
 	x->ssl_fd = NULL;
+	x->session = NULL;
+	x->wbuf = NULL;
+	x->wbuf_size = x->wbuf_start = x->wbuf_end = 0;
+	x->write_blocked = x->read_blocked = x->connect_blocked = 0;
+
+	if (set_vfd_ssl(vfd, x))
+	{
+		new_free((char **)&x);
+		return NULL;
+	}
 	return x;
+}
+
+/*
+ * ssl_want_write -- Tell newio whether we need to hear about the vfd
+ *		     becoming writable.  We do if SSL_connect(), SSL_read() 
+ *		     or SSL_write() said so, or if there is data waiting to
+ *		     go out and SSL_write() isn't waiting for something else.
+ */
+static void	ssl_want_write (ssl_info *x)
+{
+	int	want = 0;
 
+	if (x->connect_blocked == SSL_ERROR_WANT_WRITE ||
+	    x->read_blocked == SSL_ERROR_WANT_WRITE)
+		want = 1;
+	else if (x->wbuf_end > x->wbuf_start && 
+		 x->write_blocked != SSL_ERROR_WANT_READ)
+		want = 1;
+
+	new_want_write(x->vfd, want);
 }
 
 /*
- * remove_ssl_info -- Unregister vfd as an ssl-using connection.
- *
- * ARGS:
- *	vfd -- A virtual file descriptor, previously returned by new_open().
+ * ssl_flush -- Send as much of the waiting data as the socket will take.
  * RETURN VALUE:
- *	If the vfd has been previously set up to use SSL, 0.
- *	If the vfd has never been previously set up to use SSL, -1.
+ *	-1	SSL_write() failed, the connection is no good any more.
+ *	 0	Everything went out, or the rest has to wait.
  */
-static ssl_info *	unlink_ssl_info (int vfd)
+static int	ssl_flush (ssl_info *x)
 {
-	ssl_info *x = NULL;
+	int	c, ssl_err;
 
-	if (ssl_list->vfd == vfd)
+	x->write_blocked = 0;
+	while (x->wbuf_end > x->wbuf_start)
 	{
-		x = ssl_list;
-		ssl_list = x->next;
-		return x;
-	}
-	else
-	{
-		for (x = ssl_list; x->next; x = x->next)
+		c = SSL_write(x->ssl_fd, x->wbuf + x->wbuf_start, 
+					 x->wbuf_end - x->wbuf_start);
+		if (c > 0)
+		{
+			x->wbuf_start += c;
+			continue;
+		}
+
+		ssl_err = SSL_get_error(x->ssl_fd, c);
+		if (ssl_err == SSL_ERROR_WANT_READ || 
+		    ssl_err == SSL_ERROR_WANT_WRITE)
 		{
-			if (x->next->vfd == vfd)
-			{
-				ssl_info *y = x->next;
-				x->next = x->next->next;
-				return y;
-			}
+			x->write_blocked = ssl_err;
+			break;
 		}
+
+		syserr(SRV(x->vfd), "SSL_write failed with [%d]/[%d]", 
+				c, ssl_err);
+		return -1;
 	}
 
-	return NULL;
+	if (x->wbuf_start == x->wbuf_end)
+		x->wbuf_start = x->wbuf_end = 0;
+	return 0;
 }
 
 
@@ -227,6 +361,7 @@ int	startup_ssl (int vfd, int channel)
 {
 	ssl_info *	x;
 
+	/* The vfd must already be new_open()ed, so we have a place to live */
 	if (!(x = new_ssl_info(vfd)))
 	{
 		syserr(SRV(vfd), "Could not make new ssl info (vfd [%d]/channel [%d])",
@@ -237,17 +372,28 @@ int	startup_ssl (int vfd, int channel)
 
 	say("SSL negotiation for channel [%d] in progress...", channel);
 	x->channel = channel;
-	x->ctx = SSL_CTX_init(0);
+	x->ctx = get_client_ctx();
 
 	if ((x->ssl_fd = SSL_FD_init(x->ctx, channel)) == NULL)
 	{
-		/* Get rid of the 'x' we just created */
-		shutdown_ssl(vfd);
 		syserr(SRV(vfd), "Could not make new SSL (vfd [%d]/channel [%d])",
 				vfd, channel);
+		/* Get rid of the 'x' we just created */
+		shutdown_ssl(vfd);
 		errno = EINVAL;
 		return -1;
 	}
+	SSL_set_app_data(x->ssl_fd, x);
+
+	/* If we've been here before, try to pick up where we left off */
+	if (SRV(vfd) != NOSERV)
+	{
+		x->session = find_ssl_session(get_server_name(SRV(vfd)), 
+					      get_server_port(SRV(vfd)), 1);
+		if (x->session->session)
+			SSL_set_session(x->ssl_fd, x->session->session);
+	}
+	get_time(&x->started);
 
 	set_non_blocking(channel);
 	ssl_connect(vfd, 0);
@@ -267,44 +413,50 @@ int	shutdown_ssl (int vfd)
 {
 	ssl_info *	x;
 
-	if (!(x = unlink_ssl_info(vfd)))
+	if (!(x = find_ssl(vfd)))
+	{
+		errno = EINVAL;
 		return -1;
+	}
 
-	x->active = 0;
+	new_want_write(vfd, 0);
+	set_vfd_ssl(vfd, NULL);
 	x->vfd = -1;
 	x->channel = -1;
 	if (x->ssl_fd)
 		SSL_shutdown(x->ssl_fd);
 
-	if (x->ctx)
-	{
-		SSL_CTX_free(x->ctx);
-		x->ctx = NULL;
-	}
+	/* The context is shared, so we don't free it. */
+	x->ctx = NULL;
 	if (x->ssl_fd)
 	{
 		SSL_free(x->ssl_fd);
 		x->ssl_fd = NULL;
 	}
+	x->session = NULL;
+	new_free(&x->wbuf);
+	new_free((char **)&x);
 	return 0;
 }
 
 /* * * * * * */
 /*
  * write_ssl -- Write some binary data over an ssl connection on vfd.
- *		The data is unbuffered with BIO_flush() before returning.
+ *		This never blocks.  Whatever SSL_write() can't send right
+ *		now is kept and sent when the vfd becomes writable.
  * ARGS:
  *	vfd -- A virtual file descriptor, previously passed to startup_ssl().
  *	data -- Any binary data you wish to send over 'vfd'.
  *	len -- The number of bytes in 'data' to send.
  * RETURN VALUE:
  *	-1 / EINVAL -- The vfd is not set up for ssl.
- *	Anything else -- The return value of SSL_write().
+ *	-1 / ENOBUFS -- The other side hasn't taken any data in a long time.
+ *	-1 -- SSL_write() failed.
+ *	Anything else -- 'len' (the data was sent or will be sent)
  */
 int	write_ssl (int vfd, const void *data, size_t len)
 {
 	ssl_info *x;
-	int	err;
 
 	if (!(x = find_ssl(vfd)))
 	{
@@ -319,25 +471,59 @@ int	write_ssl (int vfd, const void *data, size_t len)
 		return -1;
 	}
 
-	err = SSL_write(x->ssl_fd, data, len);
-	BIO_flush(SSL_get_wbio(x->ssl_fd));
-	return err;
+	if (x->wbuf_end - x->wbuf_start + len > SSL_WRITE_BUFFER_MAX)
+	{
+		syserr(SRV(vfd), "SSL write buffer for vfd [%d] is full", vfd);
+		errno = ENOBUFS;
+		return -1;
+	}
+
+	/* 
+	 * Everything goes on the end of the buffer, so it goes out in 
+	 * order.  SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER lets us slide it down.
+	 */
+	if (x->wbuf_start > 0)
+	{
+		memmove(x->wbuf, x->wbuf + x->wbuf_start, 
+				x->wbuf_end - x->wbuf_start);
+		x->wbuf_end -= x->wbuf_start;
+		x->wbuf_start = 0;
+	}
+	if (x->wbuf_end + len > x->wbuf_size)
+	{
+		x->wbuf_size = x->wbuf_end + len + IO_BUFFER_SIZE;
+		RESIZE(x->wbuf, char, x->wbuf_size);
+	}
+	memcpy(x->wbuf + x->wbuf_end, data, len);
+	x->wbuf_end += len;
+
+	if (ssl_flush(x) < 0)
+		return -1;
+
+	ssl_want_write(x);
+	return len;
 }
 
 /*
  * read_ssl -- Post whatever data is available on 'vfd' to the newio system.
- *		This operation may block if the SSL operations block.
+ *		This is also called when the vfd is writable and we said we
+ *		wanted to know about that, so it sends any waiting data first.
+ *		This never blocks.
  * ARGS:
  *	vfd -- A virtual file descriptor, previously passed to startup_ssl().
  *	quiet -- Should errors silently ignored (1) or displayed? (0)
  * RETURN VALUE:
  *	-1 / EINVAL -- The vfd is not set up for ssl.
- *	Anything else -- The final return value of SSL_read().
+ *	-1 -- Some SSL error happened.
+ *	 0 -- The other side closed the connection.
+ *	Anything else -- Everything is fine (possibly nothing was read).
  */
 int	ssl_read (int vfd, int quiet)
 {
 	ssl_info *x;
 	int	c;
+	int	ssl_err;
+	int	total = 0;
 	int	failsafe = 0;
 	char	buffer[8192];
 
@@ -347,12 +533,16 @@ int	ssl_read (int vfd, int quiet)
 		return -1;
 	}
 
+	if (ssl_flush(x) < 0)
+		return -1;
+
 	/*
 	 * So SSL_read() might read stuff from the socket (thus defeating
 	 * a further select/poll) and buffer it internally.  We need to make
 	 * sure we don't leave any data on the table and flush out any data
 	 * that could be left over if the above read didn't do the job.
 	 */
+	x->read_blocked = 0;
 	do
 	{
 		/* This is to prevent an impossible deadlock */
@@ -360,25 +550,42 @@ int	ssl_read (int vfd, int quiet)
 			panic(1, "Caught in SSL_pending() loop! (%d)", vfd);
 
 		c = SSL_read(x->ssl_fd, buffer, sizeof(buffer));
-		if (c < 0)
+		if (c > 0)
 		{
-		    int ssl_error = SSL_get_error(x->ssl_fd, c);
-		    if (ssl_error == SSL_ERROR_NONE)
-			if (!quiet)
-			   syserr(SRV(vfd), "SSL_read failed with [%d]/[%d]", 
-					c, ssl_error);
+			dgets_buffer(x->channel, buffer, c);
+			total += c;
+			continue;
 		}
 
-		if (c == 0)
-			errno = -1;
-		else if (c > 0)
-			dgets_buffer(x->channel, buffer, c);
+		ssl_err = SSL_get_error(x->ssl_fd, c);
+		if (ssl_err == SSL_ERROR_WANT_READ || 
+		    ssl_err == SSL_ERROR_WANT_WRITE)
+		{
+			x->read_blocked = ssl_err;
+			break;
+		}
+		else if (ssl_err == SSL_ERROR_ZERO_RETURN || c == 0)
+		{
+			if (!quiet)
+			   syserr(SRV(vfd), "ssl_read: EOF for vfd %d", vfd);
+			return 0;
+		}
 		else
-			return c;		/* Some error */
+		{
+			if (!quiet)
+			   syserr(SRV(vfd), "SSL_read failed with [%d]/[%d]", 
+					c, ssl_err);
+			return -1;
+		}
 	}
 	while (SSL_pending(x->ssl_fd) > 0);
 
-	return c;
+	/* Reading may have been what SSL_write() was waiting on */
+	if (x->write_blocked == SSL_ERROR_WANT_READ && ssl_flush(x) < 0)
+		return -1;
+
+	ssl_want_write(x);
+	return total > 0 ? total : 1;
 }
 
 /* * * * * * */
@@ -394,15 +601,29 @@ int	ssl_connect (int vfd, int quiet)
 		return -1;
 	}
 
+	/*
+	 * The handshake goes back and forth, and every time the socket 
+	 * does what SSL_connect() was waiting for, we get called again.
+	 */
+	x->connect_blocked = 0;
 	errcode = SSL_connect(x->ssl_fd);
 	if (errcode <= 0)
 	{
 		ssl_err = SSL_get_error(x->ssl_fd, errcode);
 		if (ssl_err == SSL_ERROR_WANT_READ || 
 		    ssl_err == SSL_ERROR_WANT_WRITE)
+		{
+			x->connect_blocked = ssl_err;
+			ssl_want_write(x);
 			return 1;
+		}
 		else
 		{
+			new_want_write(vfd, 0);
+
+			/* Don't try to resume a session that didn't work */
+			forget_ssl_session(x->session);
+
 			/* Post the error */
 			syserr(SRV(vfd), "ssl_connect: posting error %d", ssl_err);
 			dgets_buffer(x->channel, &ssl_err, sizeof(ssl_err));
@@ -411,6 +632,7 @@ int	ssl_connect (int vfd, int quiet)
 	}
 
 	/* Post the success */
+	new_want_write(vfd, 0);
 	ssl_err = 0;
 	syserr(SRV(vfd), "ssl_connect: connection successful!");
 	dgets_buffer(x->channel, &ssl_err, sizeof(ssl_err));
@@ -433,7 +655,10 @@ int	ssl_connected (int vfd)
 		return -1;
 	}
 
+#ifdef USE_PTHREAD
+	/* The pthread looper does its i/o synchronously */
 	set_blocking(x->channel);
+#endif
 
 	/* It completed!  Yay! */
 	if (x_debug & DEBUG_SSL)
@@ -443,8 +668,9 @@ int	ssl_connected (int vfd)
 	if (!(server_cert = SSL_get_peer_certificate(x->ssl_fd)))
 	{
 		syserr(SRV(vfd), "SSL negotiation failed -- reporting as error");
-		SSL_CTX_free(x->ctx);
+		forget_ssl_session(x->session);
 		x->ctx = NULL;
+		SSL_free(x->ssl_fd);
 		x->ssl_fd = NULL;
 		write(x->channel, empty_string, 1);    /* XXX Is this correct? */
 		return -1;
@@ -452,6 +678,22 @@ int	ssl_connected (int vfd)
 
 	say("SSL negotiation for channel [%d] complete", x->channel);
 
+	if (x->session)
+	{
+		Timeval	now;
+
+		get_time(&now);
+		x->session->handshakes++;
+		x->session->last_handshake = time_diff(x->started, now);
+		if (SSL_session_reused(x->ssl_fd))
+		{
+			x->session->resumed++;
+			if (x_debug & DEBUG_SSL)
+				say("SSL session for %s resumed", 
+						x->session->name);
+		}
+	}
+
 	cert_subject = X509_NAME_oneline(X509_get_subject_name(server_cert),
 							0, 0);
 	if (!(u_cert_subject = transform_string_dyn("+URL", cert_subject, 
@@ -507,6 +749,32 @@ int	client_ssl_enabled (void)
 	return 1;
 }
 
+/*
+ * get_ssl_session_stats -- How SSL handshakes with a server have gone.
+ * ARGS:
+ *	host, port -- The server (as in get_server_name()/get_server_port())
+ *	handshakes -- Set to how many handshakes have completed
+ *	resumed -- Set to how many of those resumed a previous session
+ *	last -- Set to how many seconds the last handshake took
+ * RETURN VALUE:
+ *	-1 if we've never made an SSL connection to that server
+ *	 0 otherwise.
+ */
+int	get_ssl_session_stats (const char *host, int port, int *handshakes, int *resumed, double *last)
+{
+	ssl_session *s;
+
+	*handshakes = *resumed = 0;
+	*last = 0;
+	if (!(s = find_ssl_session(host, port, 0)))
+		return -1;
+
+	*handshakes = s->handshakes;
+	*resumed = s->resumed;
+	*last = s->last_handshake;
+	return 0;
+}
+
 
 # ifdef USE_PTHREAD
 #include <pthread.h>
@@ -585,5 +853,12 @@ int	client_ssl_enabled (void)
 	return 0;
 }
 
+int	get_ssl_session_stats (const char *host, int port, int *handshakes, int *resumed, double *last)
+{
+	*handshakes = *resumed = 0;
+	*last = 0;
+	return -1;
+}
+
 #endif
 
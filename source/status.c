@@ -132,7 +132,8 @@ int     status_updates_permitted = 0;
 /*
  * This is the list of possible expandos.  Note that you should not use
  * the '{' character, as it would be confusing.  It is already used for 
- * specifying the map.
+ * specifying the map.  The last field says what the expando's value 
+ * depends on, so make_status() knows when it can skip calling it.
  */
 struct status_formats {
 	short	map;
@@ -140,96 +141,98 @@ struct status_formats {
 	Char	*(*callback_function)(Window *, short, char);
 	char	**format_var;
 	int	*format_set;
+	int	deps;
 };
+#define STATUS_DEP_CHANOP (STATUS_DEP_MODE | STATUS_DEP_NICK | STATUS_DEP_CHANNEL)
 struct status_formats status_expandos[] = {
-{ 0, 'A', status_away,          NULL, 			NULL },
-{ 0, 'B', status_hold_lines,    &hold_lines_format,	&STATUS_HOLD_LINES_VAR},
-{ 0, 'C', status_channel,       &channel_format,	&STATUS_CHANNEL_VAR },
-{ 0, 'D', status_dcc, 	        NULL, 			NULL },
-{ 0, 'E', status_activity,	NULL,			NULL },
-{ 0, 'F', status_notify_windows,&notify_format,		&STATUS_NOTIFY_VAR },
-{ 0, 'H', status_hold,		NULL,			NULL },
-{ 0, 'I', status_insert_mode,   NULL,			NULL },
-{ 0, 'K', status_scrollback,	NULL,			NULL },
-{ 0, 'L', status_cpu_saver_mode,&cpu_saver_format,	&STATUS_CPU_SAVER_VAR },
-{ 0, 'M', status_mail,		&mail_format,		&STATUS_MAIL_VAR },
-{ 0, 'N', status_nickname,	&nick_format,		&STATUS_NICKNAME_VAR },
-{ 0, 'O', status_overwrite_mode,NULL,			NULL },
-{ 0, 'P', status_position,      NULL,			NULL },
-{ 0, 'Q', status_query_nick,    &query_format,		&STATUS_QUERY_VAR },
-{ 0, 'R', status_refnum,        NULL, 			NULL },
-{ 0, 'S', status_server,        &server_format,     	&STATUS_SERVER_VAR },
-{ 0, 'T', status_clock,         &clock_format,      	&STATUS_CLOCK_VAR },
-{ 0, 'U', status_user,		NULL, 			NULL },
-{ 0, 'V', status_version,	NULL, 			NULL },
-{ 0, 'W', status_window,	NULL, 			NULL },
-{ 0, 'X', status_user,		NULL, 			NULL },
-{ 0, 'Y', status_user,		NULL, 			NULL },
-{ 0, 'Z', status_user,		NULL, 			NULL },
-{ 0, '#', status_umode,		&umode_format,	     	&STATUS_UMODE_VAR },
-{ 0, '%', status_percent,	NULL, 			NULL },
-{ 0, '*', status_oper,		NULL, 			NULL },
-{ 0, '+', status_mode,		&mode_format,       	&STATUS_MODE_VAR },
-{ 0, '.', status_windowspec,	NULL, 			NULL },
-{ 0, '=', status_voice,		NULL, 			NULL },
-{ 0, '>', status_right_justify,	NULL, 			NULL },
-{ 0, '@', status_chanop,	NULL, 			NULL },
-{ 0, '|', status_ssl,		NULL,			NULL },
-{ 0, '0', status_user,		NULL, 			NULL },
-{ 0, '1', status_user,		NULL, 			NULL },
-{ 0, '2', status_user,		NULL, 			NULL },
-{ 0, '3', status_user,		NULL, 			NULL },
-{ 0, '4', status_user,		NULL, 			NULL },
-{ 0, '5', status_user,		NULL, 			NULL },
-{ 0, '6', status_user,		NULL, 			NULL },
-{ 0, '7', status_user,		NULL, 			NULL },
-{ 0, '8', status_user,		NULL, 			NULL },
-{ 0, '9', status_user,		NULL, 			NULL },
-{ 1, '0', status_user,		NULL, 			NULL },
-{ 1, '1', status_user,		NULL, 			NULL },
-{ 1, '2', status_user,		NULL, 			NULL },
-{ 1, '3', status_user,		NULL, 			NULL },
-{ 1, '4', status_user,		NULL, 			NULL },
-{ 1, '5', status_user,		NULL, 			NULL },
-{ 1, '6', status_user,		NULL, 			NULL },
-{ 1, '7', status_user,		NULL, 			NULL },
-{ 1, '8', status_user,		NULL, 			NULL },
-{ 1, '9', status_user,		NULL, 			NULL },
-{ 1, 'D', status_dcc_all,	NULL, 			NULL },
-{ 1, 'F', status_notify_windows,&notify_format,		&STATUS_NOTIFY_VAR },
-{ 1, 'H', status_holdmode,	NULL,			NULL },
-{ 1, 'K', status_scroll_info,	NULL,			NULL },
-{ 1, 'R', status_refnum_real,   NULL, 			NULL },
-{ 1, 'S', status_server,        &server_format,     	&STATUS_SERVER_VAR },
-{ 1, 'T', status_test,		NULL,			NULL },
-{ 1, 'W', status_swappable,	NULL,			NULL },
-{ 1, '+', status_mode,		&mode_format,       	&STATUS_MODE_VAR },
-{ 2, '0', status_user,	 	NULL, 			NULL },
-{ 2, '1', status_user,	 	NULL, 			NULL },
-{ 2, '2', status_user,	 	NULL, 			NULL },
-{ 2, '3', status_user,	 	NULL, 			NULL },
-{ 2, '4', status_user,		NULL, 			NULL },
-{ 2, '5', status_user,	 	NULL, 			NULL },
-{ 2, '6', status_user,	 	NULL, 			NULL },
-{ 2, '7', status_user,	 	NULL,			NULL },
-{ 2, '8', status_user,	 	NULL, 			NULL },
-{ 2, '9', status_user,	 	NULL, 			NULL },
-{ 2, 'S', status_server,        &server_format,     	&STATUS_SERVER_VAR },
-{ 2, 'W', status_window,	NULL, 			NULL },
-{ 2, '+', status_mode,		&mode_format,       	&STATUS_MODE_VAR },
-{ 3, '0', status_user,	 	NULL, 			NULL },
-{ 3, '1', status_user,	 	NULL, 			NULL },
-{ 3, '2', status_user,	 	NULL, 			NULL },
-{ 3, '3', status_user,	 	NULL, 			NULL },
-{ 3, '4', status_user,	 	NULL, 			NULL },
-{ 3, '5', status_user,	 	NULL, 			NULL },
-{ 3, '6', status_user,	 	NULL, 			NULL },
-{ 3, '7', status_user,	 	NULL, 			NULL },
-{ 3, '8', status_user,	 	NULL, 			NULL },
-{ 3, '9', status_user,	 	NULL, 			NULL },
-{ 3, 'S', status_server,        &server_format,     	&STATUS_SERVER_VAR },
-{ 3, 'W', status_window,	NULL, 			NULL },
-{ 3, '+', status_mode,		&mode_format,       	&STATUS_MODE_VAR }
+{ 0, 'A', status_away,          NULL, 			NULL, STATUS_DEP_AWAY },
+{ 0, 'B', status_hold_lines,    &hold_lines_format,	&STATUS_HOLD_LINES_VAR, STATUS_DEP_HOLD },
+{ 0, 'C', status_channel,       &channel_format,	&STATUS_CHANNEL_VAR, STATUS_DEP_CHANNEL },
+{ 0, 'D', status_dcc, 	        NULL, 			NULL, STATUS_DEP_DCC },
+{ 0, 'E', status_activity,	NULL,			NULL, STATUS_DEP_ACTIVITY },
+{ 0, 'F', status_notify_windows,&notify_format,		&STATUS_NOTIFY_VAR, STATUS_DEP_ACTIVITY },
+{ 0, 'H', status_hold,		NULL,			NULL, STATUS_DEP_HOLD },
+{ 0, 'I', status_insert_mode,   NULL,			NULL, STATUS_DEP_OTHER },
+{ 0, 'K', status_scrollback,	NULL,			NULL, STATUS_DEP_HOLD },
+{ 0, 'L', status_cpu_saver_mode,&cpu_saver_format,	&STATUS_CPU_SAVER_VAR, STATUS_DEP_CPU_SAVER },
+{ 0, 'M', status_mail,		&mail_format,		&STATUS_MAIL_VAR, STATUS_DEP_MAIL },
+{ 0, 'N', status_nickname,	&nick_format,		&STATUS_NICKNAME_VAR, STATUS_DEP_NICK },
+{ 0, 'O', status_overwrite_mode,NULL,			NULL, STATUS_DEP_OTHER },
+{ 0, 'P', status_position,      NULL,			NULL, STATUS_DEP_HOLD },
+{ 0, 'Q', status_query_nick,    &query_format,		&STATUS_QUERY_VAR, STATUS_DEP_CHANNEL },
+{ 0, 'R', status_refnum,        NULL, 			NULL, STATUS_DEP_OTHER },
+{ 0, 'S', status_server,        &server_format,     	&STATUS_SERVER_VAR, STATUS_DEP_OTHER },
+{ 0, 'T', status_clock,         &clock_format,      	&STATUS_CLOCK_VAR, STATUS_DEP_CLOCK },
+{ 0, 'U', status_user,		NULL, 			NULL, STATUS_DEP_OTHER },
+{ 0, 'V', status_version,	NULL, 			NULL, STATUS_DEP_OTHER },
+{ 0, 'W', status_window,	NULL, 			NULL, STATUS_DEP_OTHER },
+{ 0, 'X', status_user,		NULL, 			NULL, STATUS_DEP_OTHER },
+{ 0, 'Y', status_user,		NULL, 			NULL, STATUS_DEP_OTHER },
+{ 0, 'Z', status_user,		NULL, 			NULL, STATUS_DEP_OTHER },
+{ 0, '#', status_umode,		&umode_format,	     	&STATUS_UMODE_VAR, STATUS_DEP_MODE },
+{ 0, '%', status_percent,	NULL, 			NULL, STATUS_DEP_OTHER },
+{ 0, '*', status_oper,		NULL, 			NULL, STATUS_DEP_MODE },
+{ 0, '+', status_mode,		&mode_format,       	&STATUS_MODE_VAR, STATUS_DEP_MODE },
+{ 0, '.', status_windowspec,	NULL, 			NULL, STATUS_DEP_OTHER },
+{ 0, '=', status_voice,		NULL, 			NULL, STATUS_DEP_CHANOP },
+{ 0, '>', status_right_justify,	NULL, 			NULL, STATUS_DEP_OTHER },
+{ 0, '@', status_chanop,	NULL, 			NULL, STATUS_DEP_CHANOP },
+{ 0, '|', status_ssl,		NULL,			NULL, STATUS_DEP_OTHER },
+{ 0, '0', status_user,		NULL, 			NULL, STATUS_DEP_OTHER },
+{ 0, '1', status_user,		NULL, 			NULL, STATUS_DEP_OTHER },
+{ 0, '2', status_user,		NULL, 			NULL, STATUS_DEP_OTHER },
+{ 0, '3', status_user,		NULL, 			NULL, STATUS_DEP_OTHER },
+{ 0, '4', status_user,		NULL, 			NULL, STATUS_DEP_OTHER },
+{ 0, '5', status_user,		NULL, 			NULL, STATUS_DEP_OTHER },
+{ 0, '6', status_user,		NULL, 			NULL, STATUS_DEP_OTHER },
+{ 0, '7', status_user,		NULL, 			NULL, STATUS_DEP_OTHER },
+{ 0, '8', status_user,		NULL, 			NULL, STATUS_DEP_OTHER },
+{ 0, '9', status_user,		NULL, 			NULL, STATUS_DEP_OTHER },
+{ 1, '0', status_user,		NULL, 			NULL, STATUS_DEP_OTHER },
+{ 1, '1', status_user,		NULL, 			NULL, STATUS_DEP_OTHER },
+{ 1, '2', status_user,		NULL, 			NULL, STATUS_DEP_OTHER },
+{ 1, '3', status_user,		NULL, 			NULL, STATUS_DEP_OTHER },
+{ 1, '4', status_user,		NULL, 			NULL, STATUS_DEP_OTHER },
+{ 1, '5', status_user,		NULL, 			NULL, STATUS_DEP_OTHER },
+{ 1, '6', status_user,		NULL, 			NULL, STATUS_DEP_OTHER },
+{ 1, '7', status_user,		NULL, 			NULL, STATUS_DEP_OTHER },
+{ 1, '8', status_user,		NULL, 			NULL, STATUS_DEP_OTHER },
+{ 1, '9', status_user,		NULL, 			NULL, STATUS_DEP_OTHER },
+{ 1, 'D', status_dcc_all,	NULL, 			NULL, STATUS_DEP_DCC },
+{ 1, 'F', status_notify_windows,&notify_format,		&STATUS_NOTIFY_VAR, STATUS_DEP_ACTIVITY },
+{ 1, 'H', status_holdmode,	NULL,			NULL, STATUS_DEP_HOLD },
+{ 1, 'K', status_scroll_info,	NULL,			NULL, STATUS_DEP_HOLD },
+{ 1, 'R', status_refnum_real,   NULL, 			NULL, STATUS_DEP_OTHER },
+{ 1, 'S', status_server,        &server_format,     	&STATUS_SERVER_VAR, STATUS_DEP_OTHER },
+{ 1, 'T', status_test,		NULL,			NULL, STATUS_DEP_OTHER },
+{ 1, 'W', status_swappable,	NULL,			NULL, STATUS_DEP_OTHER },
+{ 1, '+', status_mode,		&mode_format,       	&STATUS_MODE_VAR, STATUS_DEP_MODE },
+{ 2, '0', status_user,	 	NULL, 			NULL, STATUS_DEP_OTHER },
+{ 2, '1', status_user,	 	NULL, 			NULL, STATUS_DEP_OTHER },
+{ 2, '2', status_user,	 	NULL, 			NULL, STATUS_DEP_OTHER },
+{ 2, '3', status_user,	 	NULL, 			NULL, STATUS_DEP_OTHER },
+{ 2, '4', status_user,		NULL, 			NULL, STATUS_DEP_OTHER },
+{ 2, '5', status_user,	 	NULL, 			NULL, STATUS_DEP_OTHER },
+{ 2, '6', status_user,	 	NULL, 			NULL, STATUS_DEP_OTHER },
+{ 2, '7', status_user,	 	NULL,			NULL, STATUS_DEP_OTHER },
+{ 2, '8', status_user,	 	NULL, 			NULL, STATUS_DEP_OTHER },
+{ 2, '9', status_user,	 	NULL, 			NULL, STATUS_DEP_OTHER },
+{ 2, 'S', status_server,        &server_format,     	&STATUS_SERVER_VAR, STATUS_DEP_OTHER },
+{ 2, 'W', status_window,	NULL, 			NULL, STATUS_DEP_OTHER },
+{ 2, '+', status_mode,		&mode_format,       	&STATUS_MODE_VAR, STATUS_DEP_MODE },
+{ 3, '0', status_user,	 	NULL, 			NULL, STATUS_DEP_OTHER },
+{ 3, '1', status_user,	 	NULL, 			NULL, STATUS_DEP_OTHER },
+{ 3, '2', status_user,	 	NULL, 			NULL, STATUS_DEP_OTHER },
+{ 3, '3', status_user,	 	NULL, 			NULL, STATUS_DEP_OTHER },
+{ 3, '4', status_user,	 	NULL, 			NULL, STATUS_DEP_OTHER },
+{ 3, '5', status_user,	 	NULL, 			NULL, STATUS_DEP_OTHER },
+{ 3, '6', status_user,	 	NULL, 			NULL, STATUS_DEP_OTHER },
+{ 3, '7', status_user,	 	NULL, 			NULL, STATUS_DEP_OTHER },
+{ 3, '8', status_user,	 	NULL, 			NULL, STATUS_DEP_OTHER },
+{ 3, '9', status_user,	 	NULL, 			NULL, STATUS_DEP_OTHER },
+{ 3, 'S', status_server,        &server_format,     	&STATUS_SERVER_VAR, STATUS_DEP_OTHER },
+{ 3, 'W', status_window,	NULL, 			NULL, STATUS_DEP_OTHER },
+{ 3, '+', status_mode,		&mode_format,       	&STATUS_MODE_VAR, STATUS_DEP_MODE }
 };
 #define NUMBER_OF_EXPANDOS (sizeof(status_expandos) / sizeof(struct status_formats))
 
@@ -356,6 +359,7 @@ static void	build_status_format (Status *s, int k)
 				status_expandos[i].callback_function;
 			s->line[k].map[cp] = map;
 			s->line[k].key[cp] = key;
+			s->line[k].deps[cp] = status_expandos[i].deps;
 			cp++;
 			break;
 		}
@@ -369,6 +373,7 @@ static void	build_status_format (Status *s, int k)
 		s->line[k].func[cp] = status_null_function;
 		s->line[k].map[cp] = 0;
 		s->line[k].key[cp] = 0;
+		s->line[k].deps[cp] = 0;
 		cp++;
 	}
 }
@@ -393,6 +398,7 @@ void	rebuild_a_status (Window *w)
 	else
 		s = &main_status;
 
+	destroy_status_cache(s);
 	for (k = 0; k < 3; k++)
 	{
 		new_free((char **)&s->line[k].format);
@@ -417,6 +423,7 @@ void	rebuild_a_status (Window *w)
 			    s->line[k].func[i] = main_status.line[k].func[i];
 			    s->line[k].map[i] = main_status.line[k].map[i];
 			    s->line[k].key[i] = main_status.line[k].key[i];
+			    s->line[k].deps[i] = main_status.line[k].deps[i];
 			}
 			s->line[k].count = main_status.line[k].count;
 		}
@@ -477,16 +484,39 @@ static void	init_status	(void)
 		main_status.line[i].format = NULL;
 		main_status.line[i].count = 0;
 		main_status.line[i].result = NULL;
+		main_status.line[i].cached = 0;
+		main_status.line[i].width = 0;
 		for (k = 0; k < MAX_FUNCTIONS; k++)
 		{
 			main_status.line[i].func[k] = NULL;
 			main_status.line[i].map[k] = 0;
 			main_status.line[i].key[k] = 0;
+			main_status.line[i].deps[k] = 0;
+			main_status.line[i].value[k] = NULL;
 		}
 	}
+	main_status.changes = 0;
 	main_status_init = 1;
 }
 
+/*
+ * destroy_status_cache: Forget the saved expando values for all of the
+ * status bars in 's', so the next make_status() has to call everything.
+ * This must be done whenever the status formats are rebuilt, and before
+ * the Status is thrown away.
+ */
+void	destroy_status_cache (Status *s)
+{
+	int	i, k;
+
+	for (i = 0; i < 3; i++)
+	{
+		for (k = 0; k < MAX_FUNCTIONS; k++)
+			new_free(&s->line[i].value[k]);
+		s->line[i].cached = 0;
+	}
+}
+
 /*
  * permit_status_update: sets the status_update_flag to whatever flag is.
  */
@@ -498,10 +528,64 @@ int     permit_status_update (int flag)
 }
 
 
+/*
+ * output_status_line: Put 'new' on the screen where 'old' used to be.
+ * Usually only a small part of the status bar changes (the clock, the hold
+ * lines count, the activity), so we skip over the part that is the same
+ * and start drawing at the first column that isn't.  The attribute marker
+ * that was in effect at that point is sent first so the colors come out
+ * right.  If anything funny is in the unchanged part (anything that doesn't
+ * take up exactly one column) we just draw the whole thing.
+ */
+static void	output_status_line (Window *window, int status_line, const unsigned char *old, const unsigned char *new)
+{
+	const unsigned char *	o = old;
+	const unsigned char *	n = new;
+	const unsigned char *	attr = NULL;
+	unsigned char		buffer[BIG_BUFFER_SIZE + 1];
+	int			col = 0;
+
+	while (o && *o && *o == *n)
+	{
+		if (*n == '\006')
+		{
+			if (memcmp(o, n, 5))
+				break;
+			attr = n;
+			o += 5;
+			n += 5;
+			continue;
+		}
+		else if (*n < 0x20 || *n >= 0x7F)
+		{
+			n = new;
+			col = 0;
+			attr = NULL;
+			break;
+		}
+		o++, n++, col++;
+	}
+
+	if (attr)
+	{
+		memcpy(buffer, attr, 5);
+		strlcpy(buffer + 5, n, sizeof(buffer) - 5);
+		n = buffer;
+	}
+
+	output_screen = window->screen;
+	term_move_cursor(col, window->bottom + status_line);
+	output_with_count(n, 1, 1);
+}
+
 /*
  * This just sucked beyond words.  I was always planning on rewriting this,
  * but the crecendo of complaints with regards to this just got to be too 
  * irritating, so i fixed it early.
+ *
+ * The status callbacks are only called if something they depend on has
+ * changed since the last time (see the STATUS_DEP_* flags), and if none of
+ * their values changed, the status bar isn't pressed again at all.
  */
 int	make_status (Window *window, int must_redraw)
 {
@@ -512,11 +596,21 @@ int	make_status (Window *window, int must_redraw)
 	const char	*func_value [MAX_FUNCTIONS];
 	unsigned char	*ptr;
 	size_t		save_size;
+	int		changes;
+	int		rendered = 0;
 
 	/* We do NOT redraw status bars for hidden windows */
 	if (!window->screen || !status_updates_permitted)
 		return -1;
 
+	/*
+	 * If the status bar goes through the expander, we can't know what
+	 * it depends on, so everything has to be redone every time.
+	 */
+	changes = window->status.changes;
+	if (must_redraw || get_int_var(STATUS_DOES_EXPANDOS_VAR))
+		changes = STATUS_DEP_ALL;
+
 	for (status_line = 0; status_line < window->status.number; status_line++)
 	{
 	unsigned char	lhs_fillchar[6],
@@ -532,7 +626,9 @@ int	make_status (Window *window, int must_redraw)
 			pr_rhs = 0,
 			line = 0,	/* XXX gcc4 lameness */
 			*prc = &pr_lhs, 
+			line_changes = changes,
 			i;
+	Status_line *	sl;
 
 		fillchar[0] = fillchar[1] = 0;
 
@@ -557,22 +653,57 @@ int	make_status (Window *window, int must_redraw)
 		if (!window->status.line[line].format)
 			continue;
 
+		sl = &window->status.line[line];
+		rendered |= 1 << line;
+		if (!sl->cached || sl->width != window->screen->co)
+			line_changes = STATUS_DEP_ALL;
+
 		/*
 		 * Run each of the status-generating functions from the the
 		 * status list.  Note that the retval of the functions is no
 		 * longer malloc()ed.  This saves 40-some odd malloc/free sets
 		 * each time the status bar is updated, which is non-trivial.
+		 * Since the retvals are often static buffers shared with other
+		 * expandos, we keep our own copy of each one.
 		 */
 		for (i = 0; i < MAX_FUNCTIONS; i++)
 		{
+			const char *	val;
+
 			if (window->screen == NULL)
 				return -1;
 
-			if (window->status.line[line].func[i] == NULL)
+			if (sl->value[i] && !(sl->deps[i] & line_changes))
+			{
+				func_value[i] = sl->value[i];
+				continue;
+			}
+
+			if (sl->func[i] == NULL)
 				panic(1, "status callback null.  Window [%d], line [%d], function [%d]", window->refnum, line, i);
-			func_value[i] = window->status.line[line].func[i]
-				(window, window->status.line[line].map[i],
-				 window->status.line[line].key[i]);
+			if (!(val = sl->func[i](window, sl->map[i], sl->key[i])))
+				val = empty_string;
+
+			if (!sl->value[i] || strcmp(sl->value[i], val))
+			{
+				malloc_strcpy(&sl->value[i], val);
+				sl->cached = 0;
+			}
+			func_value[i] = sl->value[i];
+		}
+
+		/*
+		 * If nothing changed, the status bar will come out exactly
+		 * the same as it did last time, so don't bother.
+		 */
+		if (sl->cached && !must_redraw && 
+				window->status.line[status_line].result)
+		{
+			do_hook(STATUS_UPDATE_LIST, "%d %d %s", 
+				window->refnum, 
+				status_line, 
+				window->status.line[status_line].result);
+			continue;
 		}
 
 #if 0
@@ -753,6 +884,9 @@ int	make_status (Window *window, int must_redraw)
 		strlcat(buffer, all_off(), sizeof buffer);
 		new_free(&str);
 
+		sl->cached = 1;
+		sl->width = window->screen->co;
+
 		/*
 		 * Ends up that BitchX always throws this hook and
 		 * people seem to like having this thrown in standard
@@ -764,32 +898,43 @@ int	make_status (Window *window, int must_redraw)
 			buffer);
 
 		if (dumb_mode || !foreground)
+		{
+			malloc_strcpy(&window->status.line[status_line].result,
+					buffer);
 			continue;
+		}
 
 		/*
 		 * Update the status line on the screen.
 		 * First check to see if it has changed
 		 * Remember this is only done in full screen mode.
 		 */
-		if (must_redraw || !window->status.line[status_line].result ||
-			strcmp(buffer, window->status.line[status_line].result))
+		if (must_redraw || !window->status.line[status_line].result)
 		{
-			/*
-			 * Roll the new back onto the old
-			 */
 			malloc_strcpy(&window->status.line[status_line].result,
 					buffer);
-
-			/*
-			 * Output the status line to the screen
-			 */
-			output_screen = window->screen;
-			term_move_cursor(0, window->bottom + status_line);
-			output_with_count(buffer, 1, 1);
+			output_status_line(window, status_line, NULL, buffer);
+			cursor_in_display(window);
+		}
+		else if (strcmp(buffer, window->status.line[status_line].result))
+		{
+			output_status_line(window, status_line, 
+				window->status.line[status_line].result, buffer);
+			malloc_strcpy(&window->status.line[status_line].result,
+					buffer);
 			cursor_in_display(window);
 		}
 	}
 
+	/*
+	 * The values for any status bar we didn't draw will be stale by the
+	 * time it is drawn again.
+	 */
+	for (status_line = 0; status_line < 3; status_line++)
+		if (!(rendered & (1 << status_line)))
+			window->status.line[status_line].cached = 0;
+	window->status.changes = 0;
+
 	cursor_to_input();
 	return 0;
 }
@@ -39,6 +39,7 @@
 #include "functions.h"
 #include "output.h"
 #include "ifcmd.h"
+#include "hook.h"
 #include "extlang.h"
 #include <tcl.h>
 #ifdef TK
@@ -48,6 +49,9 @@
 Tcl_Interp *my_tcl;
 int	istclrunning = 0;
 
+	int	tcl_handle	(const char *);
+static	char *	tcl_hook	(int, const char *);
+
 /*
  * A new TCL command, [echo], which displays back on the epic window.
  */
@@ -71,6 +75,9 @@ static int	Tcl_echoCmd (ClientData clientData, Tcl_Interp *interp, int objc, con
  *	[epic expr ...]		Evals ... as an expression, returns result.
  *	[epic call ...]		Call ... where ... is "$func(args)"
  *				Returning the result.  $* is the empty string.
+ *	[epic on type nick proc ?serial?]
+ *				Call [proc $*] for /ON #TYPE serial "NICK"
+ *				Returning the hook's unique serial number.
  */
 static int	Tcl_epicCmd (ClientData clientData, Tcl_Interp *interp, int objc, const char **objv)
 {
@@ -101,8 +108,23 @@ static int	Tcl_epicCmd (ClientData clientData, Tcl_Interp *interp, int objc, con
 			new_free(&retval);
 			new_free(&arg);
 		}
+	} else if (!strcmp(objv[1], "on")) {
+		int	handle, userial = -1;
+
+		if (objc != 5 && objc != 6) {
+			Tcl_WrongNumArgs(interp, 0, NULL, "on type nick proc ?serial?");
+			return TCL_ERROR;
+		}
+		if ((handle = tcl_handle(objv[4])) != -1) {
+			arg = malloc_sprintf(NULL, "tcl proc %s", objv[4]);
+			userial = add_callback_hook(objv[2], 
+					objc == 6 ? atoi(objv[5]) : 0, 
+					objv[3], tcl_hook, handle, arg);
+			new_free(&arg);
+		}
+		Tcl_AppendElement(interp, ltoa(userial));
 	} else {
-		Tcl_WrongNumArgs(interp, 0, NULL, "{cmd|eval|expr|call} ?epic-expression? ...");
+		Tcl_WrongNumArgs(interp, 0, NULL, "{cmd|eval|expr|call|on} ?epic-expression? ...");
 		return TCL_ERROR;
 	}
 	return TCL_OK;
@@ -158,6 +180,76 @@ char *	tcleval (char* input)
 	RETURN_MSTR(retval);
 }
 
+/*
+ * $tcl() and /TCL parse their code every time.  A "handle" is a proc 
+ * that was looked up once; calling it goes straight to the proc, with
+ * each argument as its own word, so nothing gets parsed.
+ *	$tclhandle(name)		Look up proc 'name' and return a handle
+ *	$tclinvoke(handle args)		Call it with each word of 'args'
+ *	[epic on type nick name ?serial?]
+ *					Call proc 'name' for /ON TYPE "NICK"
+ */
+static	Tcl_Obj	**tcl_handles = NULL;
+static	int	tcl_handle_count = 0;
+
+int	tcl_handle (const char *name)
+{
+	Tcl_CmdInfo	info;
+	int		i;
+
+	if (!name || !*name)
+		return -1;
+
+	tclstartstop(1);
+	for (i = 0; i < tcl_handle_count; i++)
+		if (!strcmp(Tcl_GetString(tcl_handles[i]), name))
+			return i;
+
+	if (!Tcl_GetCommandInfo(my_tcl, name, &info))
+		return -1;
+
+	/* The command name object remembers which command it found */
+	RESIZE(tcl_handles, Tcl_Obj *, tcl_handle_count + 1);
+	tcl_handles[tcl_handle_count] = Tcl_NewStringObj(name, -1);
+	Tcl_IncrRefCount(tcl_handles[tcl_handle_count]);
+	return tcl_handle_count++;
+}
+
+char *	tcl_invoke (int handle, int argc, char **argv)
+{
+	Tcl_Obj	**objv;
+	char *	retval;
+	int	i;
+
+	if (handle < 0 || handle >= tcl_handle_count)
+		RETURN_EMPTY;
+
+	tclstartstop(1);
+	objv = (Tcl_Obj **)alloca(sizeof(Tcl_Obj *) * (argc + 1));
+	objv[0] = tcl_handles[handle];
+	for (i = 0; i < argc; i++)
+	{
+		objv[i + 1] = Tcl_NewStringObj(argv[i], -1);
+		Tcl_IncrRefCount(objv[i + 1]);
+	}
+
+	Tcl_EvalObjv(my_tcl, argc + 1, objv, TCL_EVAL_GLOBAL);
+	retval = malloc_strdup(Tcl_GetStringResult(my_tcl));
+
+	for (i = 0; i < argc; i++)
+		Tcl_DecrRefCount(objv[i + 1]);
+	return retval;
+}
+
+/* A hooked proc gets $* of the event as its only argument */
+static char *	tcl_hook (int handle, const char *args)
+{
+	char *	argv[1];
+
+	argv[0] = (char *)args;
+	return tcl_invoke(handle, 1, argv);
+}
+
 /*
  * The /TCL function: Evalulate the args as a TCL statement and ignore the 
  * return value of the statement.
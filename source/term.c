@@ -747,6 +747,9 @@ void	term_reset (void)
 {
 	tcsetattr(tty_des, TCSADRAIN, &oldb);
 
+	if (get_int_var(BRACKETED_PASTE_VAR))
+		term_bracketed_paste(0);
+
 	if (current_term->TI_csr)
 		tputs_x(tparm2(current_term->TI_csr, 0, main_screen->li - 1));
 	term_gotoxy(0, main_screen->li - 1);
@@ -778,6 +781,8 @@ SIGNAL_HANDLER(term_cont)
 		if (current_term->TI_rmam)
 			tputs_x(current_term->TI_rmam);
 #endif
+		if (get_int_var(BRACKETED_PASTE_VAR))
+			term_bracketed_paste(1);
 		need_redraw = 1;
 		tcsetattr(tty_des, TCSADRAIN, &newb);
 	}
@@ -1169,6 +1174,9 @@ int 	term_init (void)
 		tputs_x(current_term->TI_rmam);
 #endif
 
+	if (get_int_var(BRACKETED_PASTE_VAR))
+		term_bracketed_paste(1);
+
 	/*
 	 * Next we tell the kernel that it should support 8 bits both
 	 * coming in and going out, and it should not strip the high bit
@@ -1272,6 +1280,32 @@ void	term_beep (void)
 	}
 }
 
+/*
+ * set_bracketed_paste: the /SET BRACKETED_PASTE callback.  When it is on,
+ * the terminal is asked to put ESC[200~ before and ESC[201~ after anything
+ * the user pastes, so do_screens() can take the whole thing at once.
+ * Terminals that don't support this just ignore the request.
+ */
+void	set_bracketed_paste (void *stuff)
+{
+	VARIABLE *v;
+
+	v = (VARIABLE *)stuff;
+	if (dumb_mode || !foreground)
+		return;
+
+	term_bracketed_paste(v->integer);
+	term_flush();
+}
+
+void	term_bracketed_paste (int onoff)
+{
+	if (onoff)
+		tputs_x("\033[?2004h");
+	else
+		tputs_x("\033[?2004l");
+}
+
 void	set_meta_8bit (void *stuff)
 {
 	VARIABLE *v;
@@ -1739,120 +1773,270 @@ static	char		retval[128];
 #ifdef WITH_THREADED_STDOUT
 
 #include <pthread.h>
+#include <sys/uio.h>
 #include "tio.h"
 
-#define TIOBUFSZ	2048
+/*
+ * Threaded stdout:  The main thread never waits for the terminal.
+ *
+ * Each tio_file is a fixed size ring buffer with exactly one writer (the 
+ * main thread, through putchar_x()) and exactly one reader (tio_thread,
+ * which writev()s it to the file descriptor).  They never take a lock:
+ * the writer owns "head", the reader owns "tail", and each only reads 
+ * the other one's.  Nothing here ever calls malloc().
+ *
+ * The bytes you write aren't handed to the reader until tio_flush(), or
+ * until half of the ring is waiting.  If the ring fills up because the
+ * terminal can't keep up, the writer has to wait for room (backpressure)
+ * -- there is nowhere else for the output to go.
+ *
+ * When one side has nothing to do, it sleeps in read() on a pipe, and
+ * the other side writes a byte to that pipe to wake it up, but only if 
+ * it said it was going to sleep.
+ */
+#define TIO_RINGSZ	65536		/* Must be a power of two */
+#define TIO_FILES	16
+
+#define tio_load(x)		__atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define tio_store(x, v)		__atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+#define tio_xchg(x, v)		__atomic_exchange_n(&(x), (v), __ATOMIC_SEQ_CST)
+#define tio_fence()		__atomic_thread_fence(__ATOMIC_SEQ_CST)
 
-typedef struct tio_qentry_stru {
-	tio_file	*file;
-	int		 len, flush, close;
-struct	tio_qentry_stru	*next, *tail;
-	char 		 buf[TIOBUFSZ];
-} tio_qentry;
+enum tio_state { TIO_FREE = 0, TIO_OPEN, TIO_CLOSING };
 
 struct tio_file_stru {
-	FILE		*stdio_file;
-	tio_qentry	*buf;
+	int		 state;		/* enum tio_state */
+	int		 fd;		/* Where it all goes */
+	size_t		 head;		/* Written by main thread (published) */
+	size_t		 tail;		/* Written by tio_thread */
+	size_t		 unpublished;	/* Main thread's private head */
+	char		 ring[TIO_RINGSZ];
 };
 
-static void		tio_push(tio_file *);
-static tio_qentry	*new_tiobuf(tio_file *);
-
 tio_file	*tio_stdout;
 
-static	tio_qentry	tio_qhead;
-static	pthread_cond_t	tio_cond = PTHREAD_COND_INITIALIZER;
-static	pthread_mutex_t	tio_mtx = PTHREAD_MUTEX_INITIALIZER;
+static	tio_file	tio_files[TIO_FILES];
 static	pthread_t	tio_thread;
+static	int		tio_wake[2] = { -1, -1 };	/* main -> tio_thread */
+static	int		tio_room[2] = { -1, -1 };	/* tio_thread -> main */
+static	int		tio_sleeping;	/* tio_thread is asleep in read() */
+static	int		tio_waiting;	/* main thread is asleep in read() */
+
+static void	tio_poke (int fd)
+{
+	char	c = 0;
+
+	if (write(fd, &c, 1) < 0)
+		;	/* If the pipe is full, it's awake anyways */
+}
+
+static void	tio_nap (int fd)
+{
+	char	c[64];
 
-static tio_qentry	*new_tiobuf(tio_file *f)
+	while (read(fd, c, sizeof c) < 0 && errno == EINTR)
+		;
+}
+
+/* Hand everything written so far to tio_thread, and wake it up */
+static void	tio_publish (tio_file *f)
+{
+	if (f->unpublished == f->head)
+		return;
+
+	tio_store(f->head, f->unpublished);
+	tio_fence();
+	if (tio_xchg(tio_sleeping, 0))
+		tio_poke(tio_wake[1]);
+}
+
+/* The ring is full: wait for tio_thread to make some room */
+static void	tio_wait_for_room (tio_file *f)
 {
-	tio_qentry	*ret;
-	ret = calloc(1, sizeof(*ret));
-	ret->file = f;
-	return ret;
+	for (;;)
+	{
+		tio_publish(f);
+		tio_xchg(tio_waiting, 1);
+		tio_fence();
+		if (f->unpublished - tio_load(f->tail) < TIO_RINGSZ)
+			break;
+		tio_nap(tio_room[0]);
+	}
+	tio_xchg(tio_waiting, 0);
 }
 
-void	tio_fputc(int c, tio_file *f)
+void	tio_fputc (int c, tio_file *f)
 {
-	if (f->buf->len == TIOBUFSZ)
-		tio_push(f);
-	f->buf->buf[f->buf->len++] = c;
+	if (!f)
+		return;
+
+	if (f->unpublished - tio_load(f->tail) >= TIO_RINGSZ)
+		tio_wait_for_room(f);
+
+	f->ring[f->unpublished++ & (TIO_RINGSZ - 1)] = (char)c;
+
+	if (f->unpublished - f->head >= TIO_RINGSZ / 2)
+		tio_publish(f);
 }
 
-void	tio_fputs(const char *str, tio_file *stream)
+void	tio_fputs (const char *str, tio_file *stream)
 {
 	while (*str)
 		tio_fputc(*str++, stream);
 }
 
-tio_file	*tio_open(FILE *f)
+void	tio_flush (tio_file *stream)
+{
+	if (stream)
+		tio_publish(stream);
+}
+
+tio_file *tio_open (FILE *f)
 {
-	tio_file	*ret;
+	int	i;
 
 	if (f == NULL)
 		return NULL;
 
-	ret = calloc(1, sizeof(*ret));
-	ret->stdio_file = f;
-	ret->buf = new_tiobuf(ret);
-	return ret;
+	for (i = 0; i < TIO_FILES; i++)
+	{
+		if (tio_load(tio_files[i].state) != TIO_FREE)
+			continue;
+
+		fflush(f);
+		tio_files[i].fd = fileno(f);
+		tio_files[i].head = tio_files[i].tail = 0;
+		tio_files[i].unpublished = 0;
+		tio_store(tio_files[i].state, TIO_OPEN);
+		return &tio_files[i];
+	}
+	return NULL;
 }
 
-void	tio_flush(tio_file *stream)
+/*
+ * tio_close: Everything written to 'stream' is written out before this
+ * returns, and then 'stream' may not be used any more.  The FILE * that
+ * it was opened with is not closed -- that still belongs to the caller.
+ */
+void	tio_close (tio_file *stream)
 {
-	stream->buf->flush = 1;
-	tio_push(stream);
+	if (!stream)
+		return;
+
+	tio_publish(stream);
+	tio_store(stream->state, TIO_CLOSING);
+	for (;;)
+	{
+		tio_fence();
+		if (tio_xchg(tio_sleeping, 0))
+			tio_poke(tio_wake[1]);
+		tio_xchg(tio_waiting, 1);
+		tio_fence();
+		if (tio_load(stream->state) == TIO_FREE)
+			break;
+		tio_nap(tio_room[0]);
+	}
+	tio_xchg(tio_waiting, 0);
 }
 
-static void	tio_push(tio_file *stream)
+/* Write out what is waiting in 'f'.  Returns 1 if anything was waiting. */
+static int	tio_drain (tio_file *f)
 {
-	pthread_mutex_lock(&tio_mtx);
-	if (!tio_qhead.next) {
-		tio_qhead.next = tio_qhead.tail = stream->buf;
-	} else {
-		tio_qhead.tail->next = stream->buf;
-		tio_qhead.tail = stream->buf;
+	struct iovec	iov[2];
+	size_t		head, tail, from, len;
+	ssize_t		n;
+	int		iovcnt = 1;
+
+	head = tio_load(f->head);
+	tail = f->tail;
+	if (head == tail)
+		return 0;
+
+	from = tail & (TIO_RINGSZ - 1);
+	len = head - tail;
+	iov[0].iov_base = f->ring + from;
+	if (from + len > TIO_RINGSZ)
+	{
+		iov[0].iov_len = TIO_RINGSZ - from;
+		iov[1].iov_base = f->ring;
+		iov[1].iov_len = len - iov[0].iov_len;
+		iovcnt = 2;
 	}
+	else
+		iov[0].iov_len = len;
+
+	while ((n = writev(f->fd, iov, iovcnt)) < 0 && errno == EINTR)
+		;
 
-	pthread_cond_signal(&tio_cond);
-	pthread_mutex_unlock(&tio_mtx);
+	/* If the terminal went away, there's no point in waiting for it */
+	if (n < 0)
+		n = len;
 
-	stream->buf = new_tiobuf(stream);
+	tio_store(f->tail, tail + n);
+	return 1;
 }
 
-static void	*tio_thread_run(void *unused)
+static void	*tio_thread_run (void *unused)
 {
-	for (;;) {
-		tio_qentry	*tq, *next;
-
-		pthread_mutex_lock(&tio_mtx);
-		if (tio_qhead.next == NULL)
-			pthread_cond_wait(&tio_cond, &tio_mtx);
-		tq = tio_qhead.next;
-		tio_qhead.next = tio_qhead.tail = NULL;
-		pthread_mutex_unlock(&tio_mtx);
-
-		for (next = tq ? tq->next : NULL; tq;
-		     tq = next, next = tq ? tq->next : NULL) {
-			if (tq->len)
-				fwrite(tq->buf, 1, tq->len, tq->file->stdio_file);
-			if (tq->flush)
-				fflush(tq->file->stdio_file);
-			free(tq);
+	int	i, busy;
+
+	for (;;)
+	{
+		busy = 0;
+		for (i = 0; i < TIO_FILES; i++)
+		{
+			tio_file *f = &tio_files[i];
+			int	state = tio_load(f->state);
+
+			if (state == TIO_FREE)
+				continue;
+			if (tio_drain(f))
+				busy = 1;
+			else if (state == TIO_CLOSING)
+			{
+				tio_store(f->state, TIO_FREE);
+				busy = 1;
+			}
+		}
+
+		if (busy)
+		{
+			tio_fence();
+			if (tio_xchg(tio_waiting, 0))
+				tio_poke(tio_room[1]);
+			continue;
+		}
+
+		/* Say we're going to sleep, and then look one more time */
+		tio_xchg(tio_sleeping, 1);
+		tio_fence();
+		for (i = 0; i < TIO_FILES; i++)
+		{
+			int	state = tio_load(tio_files[i].state);
+
+			if (state == TIO_CLOSING || (state == TIO_OPEN &&
+			    tio_load(tio_files[i].head) != tio_files[i].tail))
+				break;
 		}
+		if (i == TIO_FILES)
+			tio_nap(tio_wake[0]);
+		tio_xchg(tio_sleeping, 0);
 	}
+	return NULL;
 }
 
-void	tio_init(void)
+void	tio_init (void)
 {
+	if (pipe(tio_wake) || pipe(tio_room))
+	{
+		fprintf(stderr, "Can't make the pipes for threaded stdout\n");
+		exit(1);
+	}
+	set_non_blocking(tio_wake[1]);
+	set_non_blocking(tio_room[1]);
+
 	tio_stdout = tio_open(stdout);
 	pthread_create(&tio_thread, NULL, tio_thread_run, NULL);
 }
 
-void	tio_close (tio_file *stream)
-{
-	yell("Need to implement tio_close!");
-}
-
 #endif
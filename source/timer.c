@@ -50,6 +50,7 @@
 #include "server.h"
 #include "screen.h"
 #include "functions.h"
+#include "profile.h"
 
 	int 	timer_exists (const char *ref);
 	int 	remove_timer (const char *ref);
@@ -762,6 +763,7 @@ void 	ExecuteTimers (void)
 	while (PendingTimers && time_diff(right_now, PendingTimers->time) < 0)
 	{
 		int	old_refnum;
+		int	prof;
 
 		old_refnum = current_window->refnum;
 		current = PendingTimers;
@@ -829,11 +831,13 @@ void 	ExecuteTimers (void)
 		 */
 		get_time(&right_now);
 		now = right_now;
+		prof = profile_enter(PROFILE_TIMER, current->ref, 0);
 		if (current->callback)
 			(*current->callback)(current->callback_data);
 		else
 			call_lambda_command("TIMER", current->command,
 							current->subargs);
+		profile_leave(prof);
 
 		from_server = old_from_server;
 		make_window_current_by_refnum(old_refnum);
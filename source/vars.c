@@ -276,7 +276,10 @@ void 	init_variables_stage1 (void)
 	VAR(BANNER, 			STR,  NULL)
 	VAR(BANNER_EXPAND, 		BOOL, NULL)
 	VAR(BEEP, 			BOOL, NULL)
+	VAR(BRACKETED_PASTE,		BOOL, set_bracketed_paste)
 	VAR(CHANNEL_NAME_WIDTH, 	INT,  update_all_status_wrapper)
+	VAR(CHANNEL_SYNC_BURST,		INT,  NULL)
+	VAR(CHANNEL_SYNC_INTERVAL,	INT,  NULL)
 #define DEFAULT_CLIENT_INFORMATION IRCII_COMMENT
 	VAR(CLIENT_INFORMATION, 	STR,  NULL)
 	VAR(CLOCK, 			BOOL, my_set_clock);
@@ -314,6 +317,7 @@ void 	init_variables_stage1 (void)
 	VAR(FLOOD_RATE_PER,		INT,  NULL);
 	VAR(FLOOD_USERS,		INT,  NULL);
 	VAR(FLOOD_WARNING,		BOOL, NULL);
+	VAR(FRAME_RATE,			INT,  set_frame_rate);
 	VAR(HIDE_PRIVATE_CHANNELS,	BOOL, update_all_status_wrapper);
 	VAR(HIGH_BIT_ESCAPE,		INT,  set_meta_8bit);
 	VAR(HOLD_SLIDER,		INT,  NULL);
@@ -322,16 +326,21 @@ void 	init_variables_stage1 (void)
         VAR(INPUT_INDICATOR_RIGHT,	STR, NULL);
         VAR(INPUT_PROMPT,		STR,  set_input_prompt);
 	VAR(INSERT_MODE,		BOOL, update_all_status_wrapper);
+	VAR(IRCV3_CAPABILITIES,		STR,  NULL);
 	VAR(KEY_INTERVAL,		INT,  set_key_interval);
 	VAR(LASTLOG, 			INT,  set_lastlog_size);
+	VAR(LASTLOG_INDEX,		BOOL, set_lastlog_index);
 	VAR(LASTLOG_LEVEL,		STR,  set_lastlog_mask);
 	VAR(LASTLOG_REWRITE,		STR, NULL);
 #define DEFAULT_LOAD_PATH NULL
 	VAR(LOAD_PATH,			STR,  NULL);
 	VAR(LOG,			BOOL, logger);
 	VAR(LOGFILE,			STR,  NULL);
+	VAR(LOG_BUFFER_SIZE,		INT,  NULL);
+	VAR(LOG_FLUSH_INTERVAL,		INT,  set_log_flush_interval);
 #define DEFAULT_LOG_REWRITE NULL
 	VAR(LOG_REWRITE,		STR,  NULL);
+	VAR(LOG_WRITER_THREAD,		BOOL, set_log_writer_thread);
 	VAR(MAIL,			INT,  set_mail);
 	VAR(MAIL_INTERVAL,		INT,  set_mail_interval);
 	VAR(MAIL_TYPE,			STR, set_mail_type);
@@ -629,6 +638,7 @@ int 	set_variable (const char *name, IrcVariable *var, const char *orig_value, i
 
 	if (changed)
 	{
+	    variable_generation++;
 	    if ((var->func || var->script) && !(var->flags & VIF_PENDING))
 	    {
 		var->flags |= VIF_PENDING;
@@ -59,6 +59,7 @@ static	char	who_timeref[] = "WHOTIM";
 
 
 static int	who_queue_debug (void *unused);
+static void	who_send_deferred (int refnum);
 
 static void	WHO_DEBUG (const char *format, ...)
 {
@@ -310,6 +311,8 @@ static WhoEntry *get_new_who_entry (void)
 	new_w->undernet_extended_args = NULL;
 	new_w->dalnet_extended = 0;
 	new_w->dalnet_extended_args = NULL;
+	new_w->whox_token = 0;
+	new_w->deferred = 0;
 	new_w->request_time.tv_sec = 0;
 	new_w->request_time.tv_usec = 0;
 	new_w->dirty_time.tv_sec = 0;
@@ -384,6 +387,9 @@ void 	whobase (int refnum, char *args, void (*line) (int, const char *, const ch
 		return;
 	}
 
+	/* Anything still waiting to go out has to go out first */
+	who_send_deferred(refnum);
+
 	new_w = get_new_who_entry();
 	new_w->line = line;
 	new_w->end = end;
@@ -639,7 +645,7 @@ void 	whobase (int refnum, char *args, void (*line) (int, const char *, const ch
 	 * Check to see if we can piggyback
 	 */
 	old = who_previous_query(refnum, new_w);
-	if (old && !old->dirty && old->who_target && channel && 
+	if (old && !old->dirty && !old->whox_token && old->who_target && channel && 
 		!strcmp(old->who_target, channel))
 	{
 		old->piggyback = 1;
@@ -700,6 +706,134 @@ void 	whobase (int refnum, char *args, void (*line) (int, const char *, const ch
 	}
 }
 
+/*
+ * WHOX: Servers with WHOX in their 005 let us ask for only the fields we 
+ * want, and tag every 354 reply with a token that says which request it
+ * is for, so we don't have to guess from the top of the queue.  This is
+ * what the client uses to sync channels when it can.
+ *
+ * When the server's TARGMAX says WHO can take more than one target, the 
+ * channels that want syncing at the same time are sent as one request
+ * ("WHO #a,#b,#c") at the end of the current trip through io().
+ */
+#define WHOX_FIELDS		"%tcuhnaf"
+#define WHOX_TARGETS_LEN	400
+
+	int	need_deferred_whos = 0;
+
+/* How many WHO targets can we send at once?  0 means "as many as fit" */
+static int	whox_max_targets (int refnum)
+{
+	int	max;
+
+	if ((max = get_server_targmax(refnum, "WHO")) < 0)
+		return 1;
+	return max;
+}
+
+static void	whox_send (int refnum, WhoEntry *item)
+{
+	item->deferred = 0;
+	WHO_DEBUG("WHOX QUERY: [%d] WHO %s %s,%d", refnum, 
+			item->who_target, WHOX_FIELDS, item->whox_token);
+	send_to_aserver(refnum, "WHO %s %s,%d", 
+			item->who_target, WHOX_FIELDS, item->whox_token);
+}
+
+static void	who_send_deferred (int refnum)
+{
+	WhoEntry *item;
+
+	for (item = who_queue_top(refnum); item; item = item->next)
+		if (item->deferred)
+			whox_send(refnum, item);
+}
+
+void	send_deferred_whos (void)
+{
+	int	refnum;
+
+	need_deferred_whos = 0;
+	for (refnum = 0; refnum < number_of_servers; refnum++)
+		if (is_server_registered(refnum))
+			who_send_deferred(refnum);
+}
+
+/*
+ * whoxbase: Ask the server about 'channel' with WHOX.  The 'line' callback
+ * gets the 354 reply as-is, ie, token, channel, user, host, nick, flags, 
+ * and account.  The 'end' callback gets the 315, as for whobase().
+ * The caller must check that the server does WHOX.
+ */
+void	whoxbase (int refnum, const char *channel, void (*line) (int, const char *, const char *, const char **), void (*end) (int, const char *, const char *, const char **))
+{
+	WhoEntry *	new_w;
+	WhoEntry *	last;
+	int		max;
+	int		targets;
+	const char *	p;
+
+	if (!is_server_registered(refnum))
+	{
+		WHO_DEBUG("WHOXBASE: server [%d] is not connected", refnum);
+		return;
+	}
+
+	max = whox_max_targets(refnum);
+
+	/* Can we tack this channel onto a request that hasn't gone out? */
+	for (last = who_queue_top(refnum); last && last->next; last = last->next)
+		;
+	if (last && last->deferred && last->line == line && last->end == end)
+	{
+		for (targets = 1, p = last->who_target; *p; p++)
+			if (*p == ',')
+				targets++;
+
+		if ((max == 0 || targets < max) && strlen(last->who_target) + 
+				strlen(channel) + 1 < WHOX_TARGETS_LEN)
+		{
+			malloc_strcat_wordlist_c(&last->who_target, ",", 
+							channel, NULL);
+			WHO_DEBUG("WHOXBASE: Adding [%s] to refnum [%d] -> [%s]",
+				channel, last->refnum, last->who_target);
+			return;
+		}
+	}
+
+	new_w = get_new_who_entry();
+	new_w->line = line;
+	new_w->end = end;
+	new_w->undernet_extended = 1;
+	new_w->whox_token = new_w->refnum % 999 + 1;
+	new_w->who_target = malloc_strdup(channel);
+	who_queue_add(refnum, new_w);
+
+	if (max == 1)
+		whox_send(refnum, new_w);
+	else
+	{
+		new_w->deferred = 1;
+		need_deferred_whos = 1;
+	}
+}
+
+/* Which request does this WHOX token belong to? */
+static WhoEntry *	who_find_token (int refnum, const char *token)
+{
+	WhoEntry *item;
+	int	t;
+
+	if (!token || !is_number(token) || !(t = atol(token)))
+		return NULL;
+
+	for (item = who_queue_top(refnum); item; item = item->next)
+		if (item->whox_token == t && !item->deferred)
+			return item;
+
+	return NULL;
+}
+
 static int who_whine = 0;
 
 void	whoreply (int refnum, const char *from, const char *comm, const char **ArgList)
@@ -878,11 +1012,22 @@ while (new_w->piggyback && (new_w = new_w->next));
 void	xwhoreply (int refnum, const char *from, const char *comm, const char **ArgList)
 {
 	WhoEntry *new_w = who_queue_top(refnum);
+	WhoEntry *token_w;
 	int	l;
 
 	if (!ArgList[0])
 		{ rfc1459_odd(from, comm, ArgList); return; }
 
+	/* A WHOX reply tells us which request it is for */
+	if ((token_w = who_find_token(refnum, ArgList[0])) && token_w->line)
+	{
+		WHO_DEBUG("XWHOREPLY: Server [%d], token [%s] is refnum [%d]",
+				refnum, ArgList[0], token_w->refnum);
+		token_w->dirty = 1;
+		token_w->line(refnum, from, comm, ArgList);
+		return;
+	}
+
 	if (!new_w)
 	{
 		new_w = get_new_who_entry();
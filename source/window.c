@@ -147,8 +147,8 @@ static void	window_scrollback_backward 	(Window *window);
 static void	window_scrollback_forward 	(Window *window);
 static void	window_scrollback_backwards_lines (Window *window, int);
 static void	window_scrollback_forwards_lines (Window *window, int);
-static 	void 	window_scrollback_to_string 	(Window *window, regex_t *str);
-static 	void 	window_scrollforward_to_string 	(Window *window, regex_t *str);
+static 	void 	window_scrollback_to_string 	(Window *window, regex_t *str, const char *);
+static 	void 	window_scrollforward_to_string 	(Window *window, regex_t *str, const char *);
 static	int	change_line 			(Window *, const unsigned char *);
 static	int	add_to_display 			(Window *, const unsigned char *, intmax_t);
 static	Display *new_display_line 		(Display *prev, Window *w);
@@ -176,7 +176,7 @@ Window	*new_window (Screen *screen)
 	Window	*	new_w;
 	Window	*	tmp = NULL;
 	unsigned	new_refnum = 1;
-	int		i;
+	int		i, l;
 
 	if (dumb_mode && current_window)
 		return NULL;
@@ -223,6 +223,9 @@ Window	*new_window (Screen *screen)
 	new_w->cursor = -1;		/* Force a clear-screen */
 	new_w->change_line = -1;
 	new_w->update = 0;
+	new_w->frame_dirty = 0;
+	new_w->shown_rows = 0;
+	new_w->shown = NULL;
 
 	/* User-settable flags */
 	new_w->notify_when_hidden = 0;
@@ -244,9 +247,14 @@ Window	*new_window (Screen *screen)
 		new_w->status.line[i].format = NULL;
 		new_w->status.line[i].count = 0;
 		new_w->status.line[i].result = NULL;
+		new_w->status.line[i].cached = 0;
+		new_w->status.line[i].width = 0;
+		for (l = 0; l < MAX_FUNCTIONS; l++)
+			new_w->status.line[i].value[l] = NULL;
 	}
 	new_w->status.number = 1;
 	new_w->status.special = NULL;
+	new_w->status.changes = STATUS_DEP_ALL;
 	rebuild_a_status(new_w);
 
 	/* Scrollback stuff */
@@ -526,6 +534,7 @@ delete_window_contents:
 	 * Clean up after the window's internal data.
 	 */
 	/* Status bars... */
+	destroy_status_cache(&window->status);
 	for (i = 0; i < 3; i++)
 	{
 		new_free(&window->status.line[i].raw);
@@ -536,6 +545,7 @@ delete_window_contents:
 	}
 
 	/* Various things... */
+	forget_window_rows(window);
 	new_free(&window->logfile);
 	new_free(&window->name);
 
@@ -1334,6 +1344,7 @@ void	window_scrollback_needs_rebuild (int winref)
 void	window_statusbar_needs_update (Window *w)
 {
 	w->update |= UPDATE_STATUS;
+	w->status.changes |= STATUS_DEP_ALL;
 }
 
 /*
@@ -1342,6 +1353,7 @@ void	window_statusbar_needs_update (Window *w)
 void	window_statusbar_needs_redraw (Window *w)
 {
 	w->update |= REDRAW_STATUS;
+	w->status.changes |= STATUS_DEP_ALL;
 }
 
 /*
@@ -1375,12 +1387,25 @@ void 	redraw_all_windows (void)
  * every window for the current screen.
  */
 void 	update_all_status (void)
+{
+	update_all_status_for(STATUS_DEP_ALL);
+}
+
+/*
+ * update_all_status_for: This is update_all_status for when you know what
+ * changed (one of the STATUS_DEP_* flags), so only the status expandos 
+ * that depend on it have to be redone.
+ */
+void	update_all_status_for (int changes)
 {
 	Window	*window;
 
 	window = NULL;
 	while (traverse_all_windows(&window))
-		window_statusbar_needs_update(window);
+	{
+		window->update |= UPDATE_STATUS;
+		window->status.changes |= changes;
+	}
 }
 
 /*
@@ -1424,8 +1449,10 @@ static	int	restart;
 		if (!tmp->screen)
 			continue;
 
+		/* Output waiting for a frame is drawn by draw_frames() */
 		if (tmp->cursor == -1 ||
-		   (tmp->cursor < tmp->scrolling_distance_from_display_ip  &&
+		   (!tmp->frame_dirty &&
+		    tmp->cursor < tmp->scrolling_distance_from_display_ip  &&
 			 tmp->cursor < tmp->display_lines))
 			repaint_window_body(tmp);
 
@@ -3179,8 +3206,6 @@ static Window *window_channel (Window *window, char **args)
 	char 		*chan, *pass;
 	const char 	*c;
 	char 		*cl;
-	char 		*chans_to_join, *passes_to_use;
-	int		l;
 
 	/* Fix by Jason Brand, Nov 6, 2000 */
 	if (window->server == NOSERV)
@@ -3221,7 +3246,6 @@ static Window *window_channel (Window *window, char **args)
 		chans = LOCAL_COPY(c);		/* Whatever */
 	}
 
-	chans_to_join = passes_to_use = NULL;
 	while (*chans && (chan = next_in_comma_list(chans, &chans)))
 	{
 	    pass = NULL;
@@ -3259,26 +3283,13 @@ static Window *window_channel (Window *window, char **args)
 	    else
 	    {
 		add_waiting_channel(window, chan);
-		malloc_strcat_word(&chans_to_join, comma, chan, DWORD_NO);
-		if (pass)
-			malloc_strcat_word(&passes_to_use, comma, pass, DWORD_NO);
+		server_queue_join(window->server, chan, pass);
 	    }
 
 	    new_free(&chan);
 	    new_free(&pass);
 	}
 
-	l = message_from(chans_to_join, LEVEL_OTHER);
-	if (chans_to_join && passes_to_use)
-		send_to_aserver(window->server,"JOIN %s %s", chans_to_join, 
-								passes_to_use);
-	else if (chans_to_join)
-		send_to_aserver(window->server,"JOIN %s", chans_to_join);
-
-	new_free(&chans_to_join);
-	new_free(&passes_to_use);
-	pop_message_from(l);
-
 	return window;
 }
 
@@ -4479,7 +4490,7 @@ Window *window_rejoin (Window *window, char **args)
 	char *	channels;
 	const char *	chan;
 	char *	keys = NULL;
-	char *	newchan = NULL;
+	const char *	key;
 
 	/* First off, we have to be connected to join */
 	if (from_server == NOSERV || !is_server_registered(from_server))
@@ -4500,6 +4511,11 @@ Window *window_rejoin (Window *window, char **args)
 	/* Iterate over each channel name in the list. */
 	while (*channels && (chan = next_in_comma_list(channels, &channels)))
 	{
+		/* The keys go with the channels in the same order */
+		key = NULL;
+		if (keys && *keys)
+			key = next_in_comma_list(keys, &keys);
+
 		/* Handle /join -i, which joins last invited channel */
 		if (!my_strnicmp(chan, "-invite", 2))
                 {
@@ -4583,17 +4599,9 @@ Window *window_rejoin (Window *window, char **args)
 				      "and there should be.");
 
 			add_waiting_channel(owner, chan);
-			malloc_strcat_wordlist(&newchan, ",", chan);
+			server_queue_join(from_server, chan, key);
 		}
 	}
-	if (newchan)
-	{
-		if (keys)
-			send_to_server("JOIN %s %s", newchan, keys);
-		else
-			send_to_server("JOIN %s", newchan);
-		new_free(&newchan);
-	}
 
 	return window;
 }
@@ -4811,11 +4819,13 @@ static	Window *window_scroll_start (Window *window, char **args)
 }
 
 regex_t *last_regex = NULL;
+static char *last_regex_string = NULL;
 
 static int	new_search_term (const char *arg)
 {
 	int	errcode;
 
+	malloc_strcpy(&last_regex_string, arg);
 	if (last_regex)
 		regfree(last_regex);
 	else
@@ -4831,6 +4841,7 @@ static int	new_search_term (const char *arg)
 		say("The regex [%s] isn't acceptable because [%s]", 
 				arg, errstr);
 		new_free((char **)&last_regex);
+		new_free(&last_regex_string);
 		return -1;
 	}
 	return 0;
@@ -4847,7 +4858,8 @@ static Window *window_search_back (Window *window, char **args)
 	}
 
 	if (last_regex)
-		window_scrollback_to_string(window, last_regex);
+		window_scrollback_to_string(window, last_regex, 
+						last_regex_string);
 	else
 		say("Need to know what to search for");
 
@@ -4865,7 +4877,8 @@ static Window *window_search_forward (Window *window, char **args)
 	}
 
 	if (last_regex)
-		window_scrollforward_to_string(window, last_regex);
+		window_scrollforward_to_string(window, last_regex,
+						last_regex_string);
 	else
 		say("Need to know what to search for");
 
@@ -5981,29 +5994,55 @@ static void 	window_scrollback_forwards_lines (Window *window, int my_lines)
  * A scrollback tester that looks for a line that matches a regex.
  * Returns -1 when the line is found, and 0 if this line does not match.
  */
+struct scroll_regex {
+	regex_t *	preg;
+	LastlogFilter *	filter;
+};
+
 static	int	window_scroll_regex_tester (Window *window, Display *line, void *meta)
 {
+	struct scroll_regex *search = (struct scroll_regex *)meta;
+
+	/* Lines the lastlog index has ruled out can't match */
+	if (!lastlog_filter_maybe(search->filter, line->linked_refnum))
+		return 0;	/* Just keep going. */
+
 	/* If it matches, stop here */
-	if (regexec((regex_t *)meta, line->line, 0, NULL, 0) == 0)
+	if (regexec(search->preg, line->line, 0, NULL, 0) == 0)
 		return -1;	/* Stop right here. */
 	else
 		return 0;	/* Just keep going. */
 }
 
-static void 	window_scrollback_to_string (Window *window, regex_t *preg)
+static void 	window_scrollback_to_string (Window *window, regex_t *preg, const char *str)
 {
+	struct scroll_regex	search;
+
+	/* The lastlog index can rule out most lines without a regexec() */
+	search.preg = preg;
+	search.filter = new_lastlog_filter(window->refnum, str, 
+						LASTLOG_FILTER_REGEX);
+
 	/* Skip one line, Don't move if not found, don't leave blank space */
 	window_scrollback_backwards(window, 1, 1,
 			window_scroll_regex_tester, 
-			(void *)preg);
+			(void *)&search);
+	free_lastlog_filter(&search.filter);
 }
 
-static void 	window_scrollforward_to_string (Window *window, regex_t *preg)
+static void 	window_scrollforward_to_string (Window *window, regex_t *preg, const char *str)
 {
+	struct scroll_regex	search;
+
+	search.preg = preg;
+	search.filter = new_lastlog_filter(window->refnum, str, 
+						LASTLOG_FILTER_REGEX);
+
 	/* Skip one line, Don't move if not found, blank space is ok */
 	window_scrollback_forwards(window, 1, 1,
 			window_scroll_regex_tester, 
-			(void *)preg);
+			(void *)&search);
+	free_lastlog_filter(&search.filter);
 }
 
 /* * * */